@@ -1,7 +1,12 @@
 
 
+#define MSC_CLASS "Broadcaster"
+
 #include "Broadcaster.hpp"
+#include "CertificatePool.hpp"
+#include "MediaSoupClientErrors.hpp"
 #include "MediaStreamTrackFactory.hpp"
+#include "Tracing.hpp"
 #include "mediasoupclient.hpp"
 #include "json.hpp"
 #include <chrono>
@@ -16,7 +21,20 @@ using json = nlohmann::json;
 
 Broadcaster::~Broadcaster()
 {
+	// Waits for an ICE restart in progress, which uses the transports.
+	this->reconnection.reset();
+
 	this->Stop();
+
+	if (this->ownsTransports)
+	{
+		this->producers.clear();
+		this->consumers.clear();
+		delete this->dataConsumer;
+		delete this->dataProducer;
+		delete this->sendTransport;
+		delete this->recvTransport;
+	}
 }
 
 void Broadcaster::OnTransportClose(mediasoupclient::Producer* /*producer*/)
@@ -29,6 +47,11 @@ void Broadcaster::OnTransportClose(mediasoupclient::DataProducer* /*dataProducer
 	Debug::Log("[INFO] Broadcaster::OnTransportClose()");
 }
 
+void Broadcaster::OnTransportClose(mediasoupclient::Consumer* /*consumer*/)
+{
+	Debug::Log("[INFO] Broadcaster::OnTransportClose()");
+}
+
 /* Transport::Listener::OnConnect
  *
  * Fired for the first Transport::Consume() or Transport::Produce().
@@ -39,27 +62,32 @@ std::future<void> Broadcaster::OnConnect(mediasoupclient::Transport* transport,
 	Debug::Log("[INFO] Broadcaster::OnConnect()");
 	Debug::Log("[INFO] dtlsParameters: " + dtlsParameters.dump(4));
 
-	if (transport->GetId() == this->sendTransport->GetId())
-	{
-		return this->OnConnectSendTransport(dtlsParameters);
-	}
-	else if (transport->GetId() == this->recvTransport->GetId())
+	// Transports given through SaveSendTransport/SaveRecvTransport are signaled by the caller.
+	if (!this->signaling)
 	{
-		return this->OnConnectRecvTransport(dtlsParameters);
+		std::promise<void> promise;
+
+		promise.set_value();
+
+		return promise.get_future();
 	}
-	else
+
+	auto context = this->transportRegistry.Find(transport);
+	if (!context)
 	{
 		std::promise<void> promise;
 
-		promise.set_exception(std::make_exception_ptr("Unknown transport requested to connect"));
+		promise.set_exception(std::make_exception_ptr(MediaSoupClientError("Unknown transport requested to connect")));
 
 		return promise.get_future();
 	}
+
+	return this->OnConnectTransport(*context, dtlsParameters);
 }
 
-std::future<void> Broadcaster::OnConnectSendTransport(const json& dtlsParameters)
+std::future<void> Broadcaster::OnConnectTransport(TransportRegistry::Context& context, const json& dtlsParameters)
 {
-	std::promise<void> promise;
+	++context.connects;
 
 	/* clang-format off */
 	json body =
@@ -68,47 +96,53 @@ std::future<void> Broadcaster::OnConnectSendTransport(const json& dtlsParameters
 	};
 	/* clang-format on */
 
-	//⼭ connect dtls Param ѱ.
-	promise.set_value();
-	//н exception 
-	promise.set_exception(std::make_exception_ptr("error"));
-	return promise.get_future();
+	// Until libmediasoupclient has the answer.
+	const uint64_t traceId = newTraceId();
+	traceAsyncBegin("signaling", "OnConnect", traceId);
+
+	auto response = this->Post(context.path + "/connect", body);
+
+	return std::async(std::launch::deferred, [response, traceId]() {
+		TraceAsyncEnd traceEnd("signaling", "OnConnect", traceId);
+
+		response.get();
+	});
 }
 
-std::future<void> Broadcaster::OnConnectRecvTransport(const json& dtlsParameters)
+/* Restarts ICE on the server side of the transport and returns the new remote
+ * ICE parameters. Called by the ReconnectionManager.
+ */
+json Broadcaster::RestartIce(mediasoupclient::Transport* transport)
 {
-	std::promise<void> promise;
-
-	/* clang-format off */
-	json body =
-	{
-		{ "dtlsParameters", dtlsParameters }
-	};
-	/* clang-format on */
+	// A copy, the future holding the result is a temporary.
+	const json response = this->Post(this->transportRegistry.Get(transport)->path + "/restart-ice", json::object()).get();
 
-	/*auto r = cpr::PostAsync(
-		cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports/" +
-				  this->recvTransport->GetId() + "/connect" },
-		cpr::Body{ body.dump() },
-		cpr::Header{ { "Content-Type", "application/json" } },
-		cpr::VerifySsl{ verifySsl })
-		.get();*/
+	// mediasoup-demo answers with the parameters themselves.
+	auto it = response.find("iceParameters");
 
-	//⼭ connect dtls Param ѱ.
-	promise.set_value();
-	////н exception 
-	//promise.set_exception(std::make_exception_ptr("error"));
-	return promise.get_future();
+	return it != response.end() ? *it : response;
 }
 
 /*
  * Transport::Listener::OnConnectionStateChange.
  */
 void Broadcaster::OnConnectionStateChange(
-	mediasoupclient::Transport* /*transport*/, const std::string& connectionState)
+	mediasoupclient::Transport* transport, const std::string& connectionState)
 {
 	std::string log("[INFO] Broadcaster::OnConnectionStateChange() [connectionState:" + connectionState + "]");
 	Debug::Log(log);
+	traceInstant("network", "ConnectionStateChange", "connectionState", connectionState);
+
+	if (auto context = this->transportRegistry.Find(transport))
+		++context->connectionStateChanges;
+
+	// Stops once ICE restarts are exhausted.
+	if (this->reconnection)
+	{
+		this->reconnection->OnConnectionStateChange(transport, connectionState);
+
+		return;
+	}
 
 	if (connectionState == "failed")
 	{
@@ -123,7 +157,7 @@ void Broadcaster::OnConnectionStateChange(
  * Retrieve the remote producer ID and feed the caller with it.
  */
 std::future<std::string> Broadcaster::OnProduce(
-	mediasoupclient::SendTransport* /*transport*/,
+	mediasoupclient::SendTransport* transport,
 	const std::string& kind,
 	json rtpParameters,
 	const json& /*appData*/)
@@ -131,8 +165,6 @@ std::future<std::string> Broadcaster::OnProduce(
 	Debug::Log("[INFO] Broadcaster::OnProduce()");
 	Debug::Log("[INFO] rtpParameters: " + rtpParameters.dump(4));
 
-	std::promise<std::string> promise;
-
 	/* clang-format off */
 	json body =
 	{
@@ -141,30 +173,25 @@ std::future<std::string> Broadcaster::OnProduce(
 	};
 	/* clang-format on */
 
-	//auto r = cpr::PostAsync(
-	//	cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports/" +
-	//			  this->sendTransport->GetId() + "/producers" },
-	//	cpr::Body{ body.dump() },
-	//	cpr::Header{ { "Content-Type", "application/json" } },
-	//	cpr::VerifySsl{ verifySsl })
-	//	.get();
+	auto context = this->transportRegistry.Get(transport);
+	++context->produces;
 
-	// 
-	auto response = json::parse("response");
+	const uint64_t traceId = newTraceId();
+	traceAsyncBegin("signaling", "OnProduce", traceId);
 
-	auto it = response.find("id");
-	if (it == response.end() || !it->is_string())
-	{
-		promise.set_exception(std::make_exception_ptr("'id' missing in response"));
-	}
+	auto response = this->Post(context->path + "/producers", body);
+
+	return std::async(std::launch::deferred, [response, traceId]() {
+		TraceAsyncEnd traceEnd("signaling", "OnProduce", traceId);
 
-	promise.set_value((*it).get<std::string>());
-	//н
-	Debug::Log("[ERROR] unable to create producer");
+		const json& result = response.get();
 
-	promise.set_exception(std::make_exception_ptr("error"));
+		auto it = result.find("id");
+		if (it == result.end() || !it->is_string())
+			MSC_THROW_ERROR("'id' missing in response");
 
-	return promise.get_future();
+		return it->get<std::string>();
+	});
 }
 
 /* Producer::Listener::OnProduceData
@@ -173,7 +200,7 @@ std::future<std::string> Broadcaster::OnProduce(
  * Retrieve the remote producer ID and feed the caller with it.
  */
 std::future<std::string> Broadcaster::OnProduceData(
-	mediasoupclient::SendTransport* /*transport*/,
+	mediasoupclient::SendTransport* transport,
 	const json& sctpStreamParameters,
 	const std::string& label,
 	const std::string& protocol,
@@ -182,8 +209,6 @@ std::future<std::string> Broadcaster::OnProduceData(
 	Debug::Log( "[INFO] Broadcaster::OnProduceData()");
 	// Debug::Log( "[INFO] rtpParameters: " << rtpParameters.dump(4));
 
-	std::promise<std::string> promise;
-
 	/* clang-format off */
 	json body =
 	{
@@ -194,47 +219,262 @@ std::future<std::string> Broadcaster::OnProduceData(
 	};
 	/* clang-format on */
 
-	//auto r = cpr::PostAsync(
-	//	cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports/" +
-	//			  this->sendTransport->GetId() + "/produce/data" },
-	//	cpr::Body{ body.dump() },
-	//	cpr::Header{ { "Content-Type", "application/json" } },
-	//	cpr::VerifySsl{ verifySsl })
-	//	.get();
+	auto context = this->transportRegistry.Get(transport);
+	++context->produces;
 
-	// 
-	auto response = json::parse("response");
+	const uint64_t traceId = newTraceId();
+	traceAsyncBegin("signaling", "OnProduceData", traceId);
 
-	auto it = response.find("id");
-	if (it == response.end() || !it->is_string())
-	{
-		promise.set_exception(std::make_exception_ptr("'id' missing in response"));
-	}
+	auto response = this->Post(context->path + "/produce/data", body);
 
-	promise.set_value((*it).get<std::string>());
-	//н
-	Debug::Log("[ERROR] unable to create producer");
+	return std::async(std::launch::deferred, [response, traceId]() {
+		TraceAsyncEnd traceEnd("signaling", "OnProduceData", traceId);
 
-	promise.set_exception(std::make_exception_ptr("error"));
+		const json& result = response.get();
 
-	return promise.get_future();
+		auto it = result.find("id");
+		if (it == result.end() || !it->is_string())
+			MSC_THROW_ERROR("'id' missing in response");
+
+		return it->get<std::string>();
+	});
 }
 
 void Broadcaster::Start(
 	const std::string& baseUrl,
 	bool enableAudio,
 	bool useSimulcast,
-	const json& routerRtpCapabilities,
-	bool verifySsl)
+	const json& routerRtpCapabilities)
 {
 	Debug::Log("[INFO] Broadcaster::Start()");
 
 	this->baseUrl = baseUrl;
-	this->verifySsl = verifySsl;
 
-	// Load the device.
-	this->device.Load(routerRtpCapabilities);
+	SharedResources resources;
+	resources.signaling = std::make_shared<SignalingClient>(baseUrl);
+	resources.shard = static_cast<int>(assignFactoryShard());
+
+	StartOptions options;
+	options.enableAudio = enableAudio;
+	options.useSimulcast = useSimulcast;
 
+	this->Run(resources, options, &routerRtpCapabilities);
+}
+
+void Broadcaster::Start(const SharedResources& resources, const StartOptions& options)
+{
+	Debug::Log("[INFO] Broadcaster::Start() [shared]");
+
+	if (resources.device == nullptr || !resources.device->IsLoaded() || !resources.signaling)
+		MSC_THROW_TYPE_ERROR("shared resources need a loaded device and a signaling client");
+
+	this->Run(resources, options, nullptr);
+}
+
+void Broadcaster::Run(const SharedResources& resources, const StartOptions& options, const json* routerRtpCapabilities)
+{
+	this->resources = resources;
+	this->startOptions = options;
+	this->loadedDevice = resources.device ? resources.device : &this->device;
+	this->signaling = resources.signaling;
+	this->ownsTransports = true;
+	this->reconnection = std::make_unique<ReconnectionManager>(
+		[this](mediasoupclient::Transport* transport) { return this->RestartIce(transport); },
+		[this]() { this->Stop(); },
+		options.reconnection);
+
+	/* Steps only wait for what they need, so the send and recv sides are set
+	 * up concurrently. Producers share the send transport, whose negotiation
+	 * cannot run twice at once, hence the resource.
+	 */
+	StartupPipeline pipeline;
+	std::vector<std::string> broadcasterDependencies;
+	std::vector<std::string> transportDependencies = { "createBroadcaster" };
+	this->cachedRtpCapabilities = nullptr;
+	if (routerRtpCapabilities)
+	{
+		// When the capabilities the device computes are cached, the server
+		// gets them while the device loads.
+		auto cache = getCapabilityCache();
+		CapabilityCache::Entry cached;
+		if (cache && cache->FindByHash(hashRtpCapabilities(*routerRtpCapabilities), cached))
+			this->cachedRtpCapabilities = cached.rtpCapabilities;
+		else
+			broadcasterDependencies.push_back("loadDevice");
+
+		pipeline.AddStep("loadDevice", {}, [this, routerRtpCapabilities, cache]() {
+			{
+				TraceScope trace("startup", "Device::Load");
+				this->device.Load(*routerRtpCapabilities);
+			}
+
+			if (cache && this->cachedRtpCapabilities != this->device.GetRtpCapabilities())
+				this->StoreCapabilities(*cache, *routerRtpCapabilities);
+		});
+		transportDependencies.push_back("loadDevice");
+	}
+	pipeline.AddStep("createBroadcaster", broadcasterDependencies, [this]() { this->CreateBroadcaster(); });
+	if (!this->cachedRtpCapabilities.is_null())
+	{
+		pipeline.AddStep(
+			"confirmCapabilities", { "createBroadcaster", "loadDevice" }, [this]() { this->ConfirmCachedCapabilities(); });
+		transportDependencies = { "confirmCapabilities" };
+	}
+	// Sessions which only consume have no send transport.
+	if (options.enableAudio || options.enableVideo || options.enableData)
+		pipeline.AddStep("createSendTransport", transportDependencies, [this]() { this->CreateSendTransport(); });
+	if (options.enableAudio)
+		pipeline.AddStep("produceAudio", { "createSendTransport" }, [this]() { this->ProduceAudio(); }, "sendTransport");
+	if (options.enableVideo)
+		pipeline.AddStep("produceVideo", { "createSendTransport" }, [this]() { this->ProduceVideo(); }, "sendTransport");
+	if (options.enableData || !options.consumeProducerIds.empty())
+		pipeline.AddStep("createRecvTransport", transportDependencies, [this]() { this->CreateRecvTransport(); });
+	if (options.enableData)
+	{
+		pipeline.AddStep("produceData", { "createSendTransport" }, [this]() { this->ProduceData(); }, "sendTransport");
+		pipeline.AddStep(
+			"createDataConsumer", { "createRecvTransport", "produceData" }, [this]() { this->CreateDataConsumer(); }, "recvTransport");
+	}
+	if (!options.consumeProducerIds.empty())
+		pipeline.AddStep("consume", { "createRecvTransport" }, [this]() { this->ConsumeProducers(); }, "recvTransport");
+
+	pipeline.Run();
+
+	std::lock_guard<std::mutex> lock(this->timelineMutex);
+	this->startupTimeline = pipeline.GetTimeline();
+}
+
+uint64_t Broadcaster::GetBytesSent() const
+{
+	if (!this->ownsTransports || !this->sendTransport || this->sendTransport->IsClosed())
+		return 0;
+
+	uint64_t bytesSent = 0;
+	for (const auto& report : this->sendTransport->GetStats())
+	{
+		if (report.value("type", "") == "outbound-rtp" || report.value("type", "") == "data-channel")
+			bytesSent += report.value("bytesSent", uint64_t(0));
+	}
+
+	return bytesSent;
+}
+
+uint64_t Broadcaster::GetBytesReceived() const
+{
+	if (!this->ownsTransports || !this->recvTransport || this->recvTransport->IsClosed())
+		return 0;
+
+	uint64_t bytesReceived = 0;
+	for (const auto& report : this->recvTransport->GetStats())
+	{
+		if (report.value("type", "") == "inbound-rtp")
+			bytesReceived += report.value("bytesReceived", uint64_t(0));
+	}
+
+	return bytesReceived;
+}
+
+std::vector<std::string> Broadcaster::GetProducerIds() const
+{
+	std::vector<std::string> ids;
+	for (const auto& producer : this->producers)
+		ids.push_back(producer->GetId());
+
+	return ids;
+}
+
+bool Broadcaster::IsStarted() const
+{
+	std::lock_guard<std::mutex> lock(this->timelineMutex);
+
+	if (this->startupTimeline.empty())
+		return false;
+
+	for (const auto& entry : this->startupTimeline)
+	{
+		if (!entry.succeeded)
+			return false;
+	}
+
+	return true;
+}
+
+std::vector<StartupPipeline::TimelineEntry> Broadcaster::GetStartupTimeline() const
+{
+	std::lock_guard<std::mutex> lock(this->timelineMutex);
+
+	return this->startupTimeline;
+}
+
+std::vector<SignalingClient::RequestStats> Broadcaster::GetSignalingRequestStats() const
+{
+	if (!this->signaling)
+		return {};
+
+	return this->signaling->GetRequestStats();
+}
+
+ReconnectionManager::Stats Broadcaster::GetReconnectionStats() const
+{
+	if (!this->reconnection)
+		return {};
+
+	return this->reconnection->GetStats();
+}
+
+std::vector<TransportRegistry::Stats> Broadcaster::GetTransportStats() const
+{
+	return this->transportRegistry.GetStats();
+}
+
+std::shared_future<json> Broadcaster::Post(const std::string& path, const json& body)
+{
+	return this->Request("POST", path, body);
+}
+
+/* Sends the request right away; independent requests are pipelined on the
+ * signaling connection. The future throws unless the server answers 200.
+ */
+std::shared_future<json> Broadcaster::Request(const std::string& method, const std::string& path, const json& body)
+{
+	if (!this->signaling)
+		MSC_THROW_INVALID_STATE_ERROR("Broadcaster not started");
+
+	std::shared_future<SignalingClient::Response> response = this->signaling->Request(method, path, body).share();
+
+	return std::async(std::launch::deferred, [method, path, response]() {
+		const SignalingClient::Response& result = response.get();
+
+		if (result.status != 200)
+		{
+			Debug::Log(
+				"[ERROR] " + method + " " + path + " failed [status code:" + std::to_string(result.status) +
+					", body:\"" + result.body.dump() + "\"]",
+				Color::Red);
+
+			MSC_THROW_ERROR("%s %s failed with status %d", method.c_str(), path.c_str(), result.status);
+		}
+
+		return result.body;
+	}).share();
+}
+
+// Checks the server transport parameters the device needs.
+static void checkTransportResponse(const json& response)
+{
+	for (const char* key : { "id", "iceParameters", "iceCandidates", "dtlsParameters", "sctpParameters" })
+	{
+		if (response.find(key) == response.end())
+		{
+			Debug::Log(std::string("[ERROR] '") + key + "' missing in response", Color::Red);
+
+			MSC_THROW_ERROR("'%s' missing in response", key);
+		}
+	}
+}
+
+void Broadcaster::CreateBroadcaster()
+{
 	Debug::Log("[INFO] creating Broadcaster...");
 
 	/* clang-format off */
@@ -248,293 +488,300 @@ void Broadcaster::Start(
 				{ "version", mediasoupclient::Version() }
 			}
 		},
-		{ "rtpCapabilities", this->device.GetRtpCapabilities() }
+		{ "rtpCapabilities", this->cachedRtpCapabilities.is_null()
+		                       ? this->loadedDevice->GetRtpCapabilities()
+		                       : this->cachedRtpCapabilities }
 	};
 	/* clang-format on */
 
-	//auto r = cpr::PostAsync(
-	//	cpr::Url{ this->baseUrl + "/broadcasters" },
-	//	cpr::Body{ body.dump() },
-	//	cpr::Header{ { "Content-Type", "application/json" } },
-	//	cpr::VerifySsl{ verifySsl })
-	//	.get();
+	this->Post("/broadcasters", body).get();
+}
 
-	//if (r.status_code != 200)
-	//{
-	//	Debug::Log("[ERROR] unable to create Broadcaster"
-	//		<< " [status code:" << r.status_code << ", body:\"" << r.text << "\"]");
+/* The server got the cached device capabilities before the device loaded. If
+ * the device computed others, e.g. with other hardware codecs, the
+ * broadcaster is created again with those before it has any transport.
+ */
+void Broadcaster::ConfirmCachedCapabilities()
+{
+	if (this->cachedRtpCapabilities == this->loadedDevice->GetRtpCapabilities())
+		return;
 
-	//	return;
-	//}
+	Debug::Log("[WARN] device capabilities differ from the cached ones, creating the broadcaster again");
 
-	this->CreateSendTransport(enableAudio, useSimulcast);
-	this->CreateRecvTransport();
+	this->Request("DELETE", "/broadcasters/" + this->id, json()).get();
+	this->cachedRtpCapabilities = nullptr;
+	this->CreateBroadcaster();
+}
+
+// A cache that cannot be written does not fail the start.
+void Broadcaster::StoreCapabilities(CapabilityCache& cache, const json& routerRtpCapabilities)
+{
+	try
+	{
+		cache.Store(this->baseUrl, routerRtpCapabilities, this->device);
+	}
+	catch (std::exception& e)
+	{
+		Debug::Log("[ERROR]cannot cache device capabilities: " + std::string(e.what()), Color::Red);
+	}
 }
 
 void Broadcaster::CreateDataConsumer()
 {
 	Debug::Log("[CreateDataConsumer]");
-	//const std::string& dataProducerId = this->dataProducer->GetId();
-
-	///* clang-format off */
-	//json body =
-	//{
-	//	{ "dataProducerId", dataProducerId }
-	//};
-	///* clang-format on */
-	////create server data consumer
-	////auto r = cpr::PostAsync(
-	////	cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports/" +
-	////			  this->recvTransport->GetId() + "/consume/data" },
-	////	cpr::Body{ body.dump() },
-	////	cpr::Header{ { "Content-Type", "application/json" } },
-	////	cpr::VerifySsl{ verifySsl })
-	////	.get();
-	//if (r.status_code != 200)
-	//{
-	//	Debug::Log("[ERROR] server unable to consume mediasoup recv WebRtcTransport [status code:" << r.status_code << ", body:\"" << r.text << "\"]");
-	//	return;
-	//}
-
-	//auto response = json::parse(r.text);
-	//if (response.find("id") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'id' missing in response");
-	//	return;
-	//}
-	//auto dataConsumerId = response["id"].get<std::string>();
-
-	//if (response.find("streamId") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'streamId' missing in response");
-	//	return;
-	//}
-	//auto streamId = response["streamId"].get<uint16_t>();
-
-	//// Create client consumer.
-	//this->dataConsumer = this->recvTransport->ConsumeData(
-	//	this, dataConsumerId, dataProducerId, streamId, "chat", "", nlohmann::json());
-}
-
-void Broadcaster::CreateSendTransport(bool enableAudio, bool useSimulcast)
-{
-	Debug::Log("[INFO] creating mediasoup send WebRtcTransport...");
+	const std::string& dataProducerId = this->dataProducer->GetId();
 
-	//json sctpCapabilities = this->device.GetSctpCapabilities();
-	///* clang-format off */
-	//json body =
-	//{
-	//	{ "type",    "webrtc" },
-	//	{ "rtcpMux", true     },
-	//	{ "sctpCapabilities", sctpCapabilities }
-	//};
-	///* clang-format on */
-
-	////auto r = cpr::PostAsync(
-	////	cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports" },
-	////	cpr::Body{ body.dump() },
-	////	cpr::Header{ { "Content-Type", "application/json" } },
-	////	cpr::VerifySsl{ verifySsl })
-	////	.get();
-
-	////if (r.status_code != 200)
-	////{
-	////	Debug::Log("[ERROR] unable to create send mediasoup WebRtcTransport"
-	////		<< " [status code:" << r.status_code << ", body:\"" << r.text << "\"]");
-
-	////	return;
-	////}
-
-	////auto response = json::parse(r.text);
-
-	//if (response.find("id") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'id' missing in response");
-
-	//	return;
-	//}
-	//else if (response.find("iceParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'iceParametersd' missing in response");
-
-	//	return;
-	//}
-	//else if (response.find("iceCandidates") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'iceCandidates' missing in response");
-
-	//	return;
-	//}
-	//else if (response.find("dtlsParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'dtlsParameters' missing in response");
-
-	//	return;
-	//}
-	//else if (response.find("sctpParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'sctpParameters' missing in response");
-
-	//	return;
-	//}
-
-	//Debug::Log( "[INFO] creating SendTransport...");
-
-	//auto sendTransportId = response["id"].get<std::string>();
-
-	//this->sendTransport = this->device.CreateSendTransport(
-	//	this,
-	//	sendTransportId,
-	//	response["iceParameters"],
-	//	response["iceCandidates"],
-	//	response["dtlsParameters"],
-	//	response["sctpParameters"]);
+	/* clang-format off */
+	json body =
+	{
+		{ "dataProducerId", dataProducerId }
+	};
+	/* clang-format on */
 
-	/////////////////////////// Create Audio Producer //////////////////////////
+	// Create server data consumer.
+	auto response = this->Post(
+		this->transportRegistry.Get(this->recvTransport)->path + "/consume/data", body)
+		.get();
 
-	//if (enableAudio && this->device.CanProduce("audio"))
-	//{
-	//	auto audioTrack = createAudioTrack(std::to_string(rtc::CreateRandomId()));
+	if (response.find("id") == response.end())
+	{
+		Debug::Log("[ERROR] 'id' missing in response", Color::Red);
+
+		MSC_THROW_ERROR("'id' missing in response");
+	}
+	auto dataConsumerId = response["id"].get<std::string>();
 
-	//	/* clang-format off */
-	//	json codecOptions = {
-	//		{ "opusStereo", true },
-	//		{ "opusDtx",		true }
-	//	};
-	//	/* clang-format on */
+	if (response.find("streamId") == response.end())
+	{
+		Debug::Log("[ERROR] 'streamId' missing in response", Color::Red);
 
-	//	this->sendTransport->Produce(this, audioTrack, nullptr, &codecOptions, nullptr);
-	//}
-	//else
-	//{
-	//	Debug::Log("[WARN] cannot produce audio" << std::endl;
-	//}
+		MSC_THROW_ERROR("'streamId' missing in response");
+	}
+	auto streamId = response["streamId"].get<uint16_t>();
 
-	/////////////////////////// Create Video Producer //////////////////////////
+	// Create client consumer.
+	this->dataConsumer = this->recvTransport->ConsumeData(
+		this, dataConsumerId, dataProducerId, streamId, "chat", "", nlohmann::json());
+}
+
+/* Consumes the producers of the start options one after the other, since
+ * each consumer renegotiates the recv transport.
+ */
+void Broadcaster::ConsumeProducers()
+{
+	const std::string path = this->transportRegistry.Get(this->recvTransport)->path + "/consume?producerId=";
 
-	//if (this->device.CanProduce("video"))
-	//{
-	//	auto videoTrack = createSquaresVideoTrack(std::to_string(rtc::CreateRandomId()));
-
-	//	if (useSimulcast)
-	//	{
-	//		std::vector<webrtc::RtpEncodingParameters> encodings;
-	//		encodings.emplace_back(webrtc::RtpEncodingParameters());
-	//		encodings.emplace_back(webrtc::RtpEncodingParameters());
-	//		encodings.emplace_back(webrtc::RtpEncodingParameters());
-
-	//		this->sendTransport->Produce(this, videoTrack, &encodings, nullptr, nullptr);
-	//	}
-	//	else
-	//	{
-	//		this->sendTransport->Produce(this, videoTrack, nullptr, nullptr, nullptr);
-	//	}
-	//}
-	//else
-	//{
-	//	Debug::Log("[WARN] cannot produce video");
-
-	//	return;
-	//}
+	for (const auto& producerId : this->startOptions.consumeProducerIds)
+	{
+		// Create server consumer.
+		json response = this->Post(path + producerId, json::object()).get();
 
-	/////////////////////////// Create Data Producer //////////////////////////
+		for (const char* key : { "id", "kind", "rtpParameters" })
+		{
+			if (response.find(key) == response.end())
+			{
+				Debug::Log(std::string("[ERROR] '") + key + "' missing in response", Color::Red);
 
-	//this->dataProducer = sendTransport->ProduceData(this);
-
-	//uint32_t intervalSeconds = 10;
-	//std::thread([this, intervalSeconds]() {
-	//	bool run = true;
-	//	while (run)
-	//	{
-	//		std::chrono::system_clock::time_point p = std::chrono::system_clock::now();
-	//		std::time_t t = std::chrono::system_clock::to_time_t(p);
-	//		std::string s = std::ctime(&t);
-	//		auto dataBuffer = webrtc::DataBuffer(s);
-	//		Debug::Log( "[INFO] sending chat data: " + s);
-	//		this->dataProducer->Send(dataBuffer);
-	//		run = timerKiller.WaitFor(std::chrono::seconds(intervalSeconds));
-	//	}
-	//	})
-	//	.detach();
+				MSC_THROW_ERROR("'%s' missing in response", key);
+			}
+		}
+
+		// Create client consumer.
+		mediasoupclient::Consumer* consumer = this->recvTransport->Consume(
+			this,
+			response["id"].get<std::string>(),
+			producerId,
+			response["kind"].get<std::string>(),
+			&response["rtpParameters"]);
+		this->consumers.emplace_back(consumer);
+		watchFirstDecodedFrame(consumer->GetTrack());
+	}
 }
 
-void Broadcaster::CreateRecvTransport()
+void Broadcaster::CreateSendTransport()
 {
-	Debug::Log( "[INFO] creating mediasoup recv WebRtcTransport...");
+	Debug::Log("[INFO] creating mediasoup send WebRtcTransport...");
 
-	//json sctpCapabilities = this->device.GetSctpCapabilities();
-	///* clang-format off */
-	//json body =
-	//{
-	//	{ "type",    "webrtc" },
-	//	{ "rtcpMux", true     },
-	//	{ "sctpCapabilities", sctpCapabilities }
-	//};
-	///* clang-format on */
+	json sctpCapabilities = this->loadedDevice->GetSctpCapabilities();
+	/* clang-format off */
+	json body =
+	{
+		{ "type",    "webrtc" },
+		{ "rtcpMux", true     },
+		{ "sctpCapabilities", sctpCapabilities }
+	};
+	/* clang-format on */
 
-	//// create server transport
-	////auto r = cpr::PostAsync(
-	////	cpr::Url{ this->baseUrl + "/broadcasters/" + this->id + "/transports" },
-	////	cpr::Body{ body.dump() },
-	////	cpr::Header{ { "Content-Type", "application/json" } },
-	////	cpr::VerifySsl{ verifySsl })
-	////	.get();
+	// Create server transport.
+	auto response = this->Post("/broadcasters/" + this->id + "/transports", body).get();
 
-	//if (r.status_code != 200)
-	//{
-	//	Debug::Log("[ERROR] unable to create mediasoup recv WebRtcTransport [status code:" + r.status_code + ", body:\"" + r.text + "\"]", Color::Red);
+	checkTransportResponse(response);
 
-	//	return;
-	//}
+	Debug::Log("[INFO] creating SendTransport...");
 
-	//auto response = json::parse(r.text);
+	// Shard factory rather than one created for the transport.
+	mediasoupclient::PeerConnection::Options options;
+	options.factory = getFactory(this->resources.shard).get();
+	if (auto certificate = getCachedCertificate())
+		options.config.certificates.push_back(certificate);
 
-	//if (response.find("id") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'id' missing in response", Color::Red);
+	{
+		TraceScope trace("startup", "Device::CreateSendTransport");
+		this->sendTransport = this->loadedDevice->CreateSendTransport(
+			this,
+			response["id"].get<std::string>(),
+			response["iceParameters"],
+			response["iceCandidates"],
+			response["dtlsParameters"],
+			response["sctpParameters"],
+			&options);
+	}
 
-	//	return;
-	//}
-	//else if (response.find("iceParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'iceParameters' missing in response", Color::Red);
+	this->transportRegistry.Add(
+		this->sendTransport,
+		TransportRegistry::Role::Send,
+		"/broadcasters/" + this->id + "/transports/" + this->sendTransport->GetId());
+	this->reconnection->AddTransport(this->sendTransport);
+}
 
-	//	return;
-	//}
-	//else if (response.find("iceCandidates") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'iceCandidates' missing in response", Color::Red);
+void Broadcaster::ProduceAudio()
+{
+	/////////////////////////// Create Audio Producer //////////////////////////
 
-	//	return;
-	//}
-	//else if (response.find("dtlsParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'dtlsParameters' missing in response", Color::Red);
+	if (this->loadedDevice->CanProduce("audio"))
+	{
+		auto audioTrack = this->resources.audioTrack
+			? this->resources.audioTrack
+			: createAudioTrack(std::to_string(rtc::CreateRandomId()), this->resources.shard);
+
+		/* clang-format off */
+		json codecOptions = {
+			{ "opusStereo", true },
+			{ "opusDtx",    true }
+		};
+		/* clang-format on */
+
+		this->producers.emplace_back(this->sendTransport->Produce(this, audioTrack, nullptr, &codecOptions, nullptr));
+	}
+	else
+	{
+		Debug::Log("[WARN] cannot produce audio");
+	}
+}
 
-	//	return;
-	//}
-	//else if (response.find("sctpParameters") == response.end())
-	//{
-	//	Debug::Log("[ERROR] 'sctpParameters' missing in response", Color::Red);
+void Broadcaster::ProduceVideo()
+{
+	/////////////////////////// Create Video Producer //////////////////////////
 
-	//	return;
-	//}
+	if (this->loadedDevice->CanProduce("video"))
+	{
+		auto videoTrack = this->resources.videoTrack
+			? this->resources.videoTrack
+			: createSquaresVideoTrack(std::to_string(rtc::CreateRandomId()), this->resources.shard);
+
+		// Router codec to send with, the first one otherwise.
+		json codec;
+		if (!this->startOptions.videoCodec.empty())
+		{
+			const std::string mimeType = "video/" + this->startOptions.videoCodec;
+			for (const auto& candidate : this->loadedDevice->GetRtpCapabilities()["codecs"])
+			{
+				if (candidate.value("mimeType", "") == mimeType)
+				{
+					codec = candidate;
+					break;
+				}
+			}
+			if (codec.is_null())
+				MSC_THROW_ERROR("router cannot receive %s", mimeType.c_str());
+		}
+		const json* codecPointer = codec.is_null() ? nullptr : &codec;
+
+		if (this->startOptions.useSimulcast)
+		{
+			std::vector<webrtc::RtpEncodingParameters> encodings;
+			encodings.emplace_back(webrtc::RtpEncodingParameters());
+			encodings.emplace_back(webrtc::RtpEncodingParameters());
+			encodings.emplace_back(webrtc::RtpEncodingParameters());
+
+			this->producers.emplace_back(this->sendTransport->Produce(this, videoTrack, &encodings, nullptr, codecPointer));
+		}
+		else
+		{
+			this->producers.emplace_back(this->sendTransport->Produce(this, videoTrack, nullptr, nullptr, codecPointer));
+		}
+	}
+	else
+	{
+		Debug::Log("[WARN] cannot produce video");
+	}
+}
 
-	//auto recvTransportId = response["id"].get<std::string>();
+void Broadcaster::ProduceData()
+{
+	/////////////////////////// Create Data Producer //////////////////////////
 
-	//Debug::Log("[INFO] creating RecvTransport...");
+	this->dataProducer = sendTransport->ProduceData(this);
+
+	// Sent from the shared timer wheel rather than a thread per Broadcaster.
+	const size_t messageSize = this->startOptions.dataMessageSize;
+	this->sendDataTimer = getTimerWheel().SchedulePeriodic(
+		std::chrono::milliseconds(0), std::chrono::milliseconds(this->startOptions.dataIntervalMs), [this, messageSize]() {
+			std::chrono::system_clock::time_point p = std::chrono::system_clock::now();
+			std::time_t t = std::chrono::system_clock::to_time_t(p);
+			std::string s = std::ctime(&t);
+			if (messageSize > 0)
+				s.resize(messageSize, ' ');
+			auto dataBuffer = webrtc::DataBuffer(s);
+			Debug::Log("[INFO] sending chat data: " + s);
+			this->dataProducer->Send(dataBuffer);
+		});
+}
 
-	//auto sctpParameters = response["sctpParameters"];
+void Broadcaster::CreateRecvTransport()
+{
+	Debug::Log("[INFO] creating mediasoup recv WebRtcTransport...");
 
-	//this->recvTransport = this->device.CreateRecvTransport(
-	//	this,
-	//	recvTransportId,
-	//	response["iceParameters"],
-	//	response["iceCandidates"],
-	//	response["dtlsParameters"],
-	//	sctpParameters);
+	json sctpCapabilities = this->loadedDevice->GetSctpCapabilities();
+	/* clang-format off */
+	json body =
+	{
+		{ "type",    "webrtc" },
+		{ "rtcpMux", true     },
+		{ "sctpCapabilities", sctpCapabilities }
+	};
+	/* clang-format on */
+
+	// Create server transport.
+	auto response = this->Post("/broadcasters/" + this->id + "/transports", body).get();
+
+	checkTransportResponse(response);
+
+	Debug::Log("[INFO] creating RecvTransport...");
+
+	// Shard factory rather than one created for the transport.
+	mediasoupclient::PeerConnection::Options options;
+	options.factory = getFactory(this->resources.shard).get();
+	if (auto certificate = getCachedCertificate())
+		options.config.certificates.push_back(certificate);
 
-	//this->CreateDataConsumer();
+	{
+		TraceScope trace("startup", "Device::CreateRecvTransport");
+		this->recvTransport = this->loadedDevice->CreateRecvTransport(
+			this,
+			response["id"].get<std::string>(),
+			response["iceParameters"],
+			response["iceCandidates"],
+			response["dtlsParameters"],
+			response["sctpParameters"],
+			&options);
+	}
+
+	this->transportRegistry.Add(
+		this->recvTransport,
+		TransportRegistry::Role::Recv,
+		"/broadcasters/" + this->id + "/transports/" + this->recvTransport->GetId());
+	this->reconnection->AddTransport(this->recvTransport);
 }
 
 void Broadcaster::OnMessage(mediasoupclient::DataConsumer* dataConsumer, const webrtc::DataBuffer& buffer)
@@ -551,7 +798,16 @@ void Broadcaster::Stop()
 {
 	Debug::Log("[INFO] Broadcaster::Stop()");
 
-	this->timerKiller.Kill();
+	// Waits for a send in progress, so the data producer can be closed.
+	getTimerWheel().Cancel(this->sendDataTimer);
+	this->sendDataTimer = 0;
+
+	// Closed transports are not to be restarted.
+	if (this->reconnection)
+	{
+		this->reconnection->RemoveTransport(this->sendTransport);
+		this->reconnection->RemoveTransport(this->recvTransport);
+	}
 
 	if (this->recvTransport)
 	{
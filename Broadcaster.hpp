@@ -1,48 +1,36 @@
 #ifndef BROADCASTER_H
 #define BROADCASTER_H
+#ifdef _WIN32
 #define WEBRTC_WIN
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
+#endif
 
 #include <chrono>
 #include <condition_variable>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "mediasoupclient.hpp"
 #include "json.hpp"
 #include "DebugCpp.h"
+#include "CapabilityCache.hpp"
+#include "ReconnectionManager.hpp"
+#include "SignalingClient.hpp"
+#include "StartupPipeline.hpp"
+#include "TimerWheel.hpp"
+#include "TransportRegistry.hpp"
 
 class Broadcaster : public
 	mediasoupclient::SendTransport::Listener,
 	mediasoupclient::RecvTransport::Listener,
 	mediasoupclient::Producer::Listener,
+	mediasoupclient::Consumer::Listener,
 	mediasoupclient::DataProducer::Listener,
 	mediasoupclient::DataConsumer::Listener
 {
-public:
-	struct TimerKiller
-	{
-		// returns false if killed:
-		template<class R, class P>
-		bool WaitFor(std::chrono::duration<R, P> const& time) const
-		{
-			std::unique_lock<std::mutex> lock(m);
-			return !cv.wait_for(lock, time, [&] { return terminate; });
-		}
-		void Kill()
-		{
-			std::unique_lock<std::mutex> lock(m);
-			terminate = true; // Should be modified inside mutex lock.
-			cv.notify_all();  // It is safe, and *sometimes* optimal, to do this outside the lock.
-		}
-
-	private:
-		mutable std::condition_variable cv;
-		mutable std::mutex m;
-		bool terminate = false;
-	};
-
 	/* Virtual methods inherited from SendTransport::Listener. */
 public:
 	std::future<void> OnConnect(
@@ -66,6 +54,10 @@ public:
 public:
 	void OnTransportClose(mediasoupclient::Producer* producer) override;									// just log
 
+	/* Virtual methods inherited from Consumer::Listener. */
+public:
+	void OnTransportClose(mediasoupclient::Consumer* consumer) override;									// just log
+
 	/* Virtual methods inherited from DataConsumer::Listener */
 public:
 	void OnMessage(mediasoupclient::DataConsumer* dataConsumer, const webrtc::DataBuffer& buffer) override; // just log On Message
@@ -98,14 +90,71 @@ public:
 	void OnTransportClose(mediasoupclient::DataProducer* dataProducer) override;						// just log
 
 public:
+	/* Resources a Broadcaster can share with others, see BroadcasterHost. */
+	struct SharedResources
+	{
+		// Device already loaded with the router capabilities.
+		mediasoupclient::Device* device = nullptr;
+		std::shared_ptr<SignalingClient> signaling;
+		// Factory shard of the transports and of the tracks created here.
+		int shard = 0;
+		// Sent instead of a track of its own when set. Must come from the shard.
+		rtc::scoped_refptr<webrtc::AudioTrackInterface> audioTrack;
+		rtc::scoped_refptr<webrtc::VideoTrackInterface> videoTrack;
+	};
+
+	struct StartOptions
+	{
+		bool enableAudio = true;
+		bool enableVideo = true;
+		bool useSimulcast = false;
+		// e.g. "VP8" or "H264"; the first video codec of the router if empty.
+		std::string videoCodec;
+		// Chat data producer, and the data consumer needing a recv transport.
+		bool enableData = true;
+		int64_t dataIntervalMs = 10000;
+		// Chat messages are padded to this size, 0 to send just the time.
+		size_t dataMessageSize = 0;
+		// ICE restarts when a transport Start() created loses connectivity.
+		ReconnectionManager::Options reconnection;
+		// Producers of other sessions to consume on the recv transport.
+		std::vector<std::string> consumeProducerIds;
+	};
+
 	void Start(
 		const std::string& baseUrl,
 		bool enableAudio,
 		bool useSimulcast,
-		const nlohmann::json& routerRtpCapabilities,
-		bool verifySsl = true);
+		const nlohmann::json& routerRtpCapabilities);
+	void Start(const SharedResources& resources, const StartOptions& options);
 	void Stop();
 
+	// Whether every step of the last Start() succeeded.
+	bool IsStarted() const;
+
+	// RTP and data channel bytes sent on the send transport Start() created.
+	// Blocks on the peer connection stats.
+	uint64_t GetBytesSent() const;
+
+	// RTP bytes received by the consumers Start() created. Blocks on the peer
+	// connection stats.
+	uint64_t GetBytesReceived() const;
+
+	// Ids of the producers Start() created.
+	std::vector<std::string> GetProducerIds() const;
+
+	// When each step of the last Start() began and ended.
+	std::vector<StartupPipeline::TimelineEntry> GetStartupTimeline() const;
+
+	// Round trips of the signaling requests made since Start().
+	std::vector<SignalingClient::RequestStats> GetSignalingRequestStats() const;
+
+	// Connectivity losses of the transports Start() created and their recovery.
+	ReconnectionManager::Stats GetReconnectionStats() const;
+
+	// Listener callbacks counted per transport Start() created.
+	std::vector<TransportRegistry::Stats> GetTransportStats() const;
+
 	~Broadcaster();
 
 
@@ -115,19 +164,51 @@ public:
 	mediasoupclient::DataProducer* dataProducer{ nullptr };
 	mediasoupclient::DataConsumer* dataConsumer{ nullptr };
 private:
+	void Run(const SharedResources& resources, const StartOptions& options, const nlohmann::json* routerRtpCapabilities);
+
+	SharedResources resources;
+	StartOptions startOptions;
+	// this->device unless a shared one was given.
+	mediasoupclient::Device* loadedDevice = &this->device;
+	// Set when Start() created the transports, which are then deleted with
+	// the Broadcaster; those given through SaveSendTransport/SaveRecvTransport
+	// belong to the caller.
+	bool ownsTransports = false;
+	std::vector<std::unique_ptr<mediasoupclient::Producer>> producers;
+	std::vector<std::unique_ptr<mediasoupclient::Consumer>> consumers;
+
 	std::string id = std::to_string(rtc::CreateRandomId());
 	std::string baseUrl;
-	std::thread sendDataThread;
-
-	struct TimerKiller timerKiller;
-	bool verifySsl = true;
-
-	std::future<void> OnConnectSendTransport(const nlohmann::json& dtlsParameters);
-	std::future<void> OnConnectRecvTransport(const nlohmann::json& dtlsParameters);
-
-	void CreateSendTransport(bool enableAudio, bool useSimulcast);
+	// Device capabilities from the CapabilityCache, null if not cached.
+	nlohmann::json cachedRtpCapabilities;
+	// Periodic chat message on the shared timer wheel, 0 if none.
+	TimerWheel::TimerId sendDataTimer = 0;
+	std::shared_ptr<SignalingClient> signaling;
+	// Set by Start(), before the transports exist.
+	std::unique_ptr<ReconnectionManager> reconnection;
+	// The transports Start() created, for the listener callbacks.
+	TransportRegistry transportRegistry;
+
+	std::shared_future<nlohmann::json> Post(const std::string& path, const nlohmann::json& body);
+	std::shared_future<nlohmann::json> Request(
+		const std::string& method, const std::string& path, const nlohmann::json& body);
+
+	std::future<void> OnConnectTransport(TransportRegistry::Context& context, const nlohmann::json& dtlsParameters);
+	nlohmann::json RestartIce(mediasoupclient::Transport* transport);
+
+	void CreateBroadcaster();
+	void ConfirmCachedCapabilities();
+	void StoreCapabilities(CapabilityCache& cache, const nlohmann::json& routerRtpCapabilities);
+	void CreateSendTransport();
 	void CreateRecvTransport();
+	void ProduceAudio();
+	void ProduceVideo();
+	void ProduceData();
 	void CreateDataConsumer();
+	void ConsumeProducers();
+
+	mutable std::mutex timelineMutex;
+	std::vector<StartupPipeline::TimelineEntry> startupTimeline;
 };
 
 #endif // STOKER_HPP
@@ -0,0 +1,308 @@
+#define MSC_CLASS "BroadcasterHost"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#else
+#include <fstream>
+#include <string>
+#endif
+#include "BroadcasterHost.hpp"
+#include "CapabilityCache.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "MediaStreamTrackFactory.hpp"
+#include "Tracing.hpp"
+#include "DebugCpp.h"
+
+BroadcasterHost::BroadcasterHost(const Options& options)
+	: options(options)
+{
+	this->baselineMemoryBytes = getProcessMemoryBytes();
+	this->baselineThreads = getProcessThreadCount();
+
+	{
+		TraceScope trace("startup", "Device::Load");
+		this->device.Load(options.routerRtpCapabilities);
+	}
+	if (auto cache = getCapabilityCache())
+	{
+		try
+		{
+			cache->Store(options.baseUrl, options.routerRtpCapabilities, this->device);
+		}
+		catch (std::exception& e)
+		{
+			Debug::Log("[ERROR]cannot cache device capabilities: " + std::string(e.what()), Color::Red);
+		}
+	}
+
+	for (size_t i = 0; i < std::max<size_t>(options.signalingConnections, 1); ++i)
+		this->signalingClients.push_back(std::make_shared<SignalingClient>(options.baseUrl));
+
+	// assignFactoryShard() creates the default shard if none was initialized.
+	assignFactoryShard();
+	for (size_t shard = 0; shard < getFactoryShardCount(); ++shard)
+	{
+		const int index = static_cast<int>(shard);
+		const std::string label = "host-" + std::to_string(shard);
+
+		this->audioTracks.push_back(options.session.enableAudio ? createAudioTrack(label, index) : nullptr);
+		this->videoTracks.push_back(options.session.enableVideo ? createSquaresVideoTrack(label, index) : nullptr);
+	}
+}
+
+BroadcasterHost::~BroadcasterHost()
+{
+	this->RemoveSessions(SIZE_MAX);
+}
+
+/* count producers for the given session, spread round-robin over producerIds. */
+static std::vector<std::string> pickProducers(const std::vector<std::string>& producerIds, size_t count, size_t session)
+{
+	std::vector<std::string> picked;
+	for (size_t i = 0; i < std::min(count, producerIds.size()); ++i)
+		picked.push_back(producerIds[(session * count + i) % producerIds.size()]);
+
+	return picked;
+}
+
+size_t BroadcasterHost::AddSessions(size_t count)
+{
+	std::vector<std::unique_ptr<Broadcaster>> started(count);
+	std::vector<double> startedMs(count);
+	std::atomic<size_t> next{ 0 };
+
+	auto startSessions = [&]() {
+		size_t i;
+		while ((i = next++) < count)
+		{
+			Broadcaster::SharedResources resources;
+			size_t session;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				session = this->nextSession++;
+			}
+			resources.device = &this->device;
+			resources.signaling = this->signalingClients[session % this->signalingClients.size()];
+			resources.shard = static_cast<int>(assignFactoryShard());
+			resources.audioTrack = this->audioTracks[resources.shard];
+			resources.videoTrack = this->videoTracks[resources.shard];
+
+			Broadcaster::StartOptions sessionOptions = this->options.session;
+			if (this->options.consumeFrom)
+			{
+				sessionOptions.consumeProducerIds =
+					pickProducers(this->options.consumeFrom->GetProducerIds(), this->options.consumeCount, session);
+				if (sessionOptions.consumeProducerIds.empty())
+				{
+					Debug::Log("[ERROR]session failed to start: no producer to consume", Color::Red);
+					continue;
+				}
+			}
+
+			std::unique_ptr<Broadcaster> broadcaster(new Broadcaster());
+			const auto startedAt = std::chrono::steady_clock::now();
+			try
+			{
+				broadcaster->Start(resources, sessionOptions);
+			}
+			catch (std::exception& e)
+			{
+				Debug::Log("[ERROR]session failed to start: " + std::string(e.what()), Color::Red);
+			}
+
+			if (broadcaster->IsStarted())
+			{
+				startedMs[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startedAt).count();
+				started[i] = std::move(broadcaster);
+			}
+		}
+	};
+
+	std::vector<std::thread> starters;
+	for (size_t i = 1; i < std::min(std::max<size_t>(this->options.startConcurrency, 1), count); ++i)
+		starters.emplace_back(startSessions);
+	startSessions();
+	for (auto& starter : starters)
+		starter.join();
+
+	size_t startedCount = 0;
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (started[i])
+		{
+			this->sessions.push_back(std::move(started[i]));
+			this->startupMs.push_back(startedMs[i]);
+			++startedCount;
+		}
+	}
+	this->failed += count - startedCount;
+
+	return startedCount;
+}
+
+void BroadcasterHost::RemoveSessions(size_t count)
+{
+	std::vector<std::unique_ptr<Broadcaster>> removed;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		count = std::min(count, this->sessions.size());
+		removed.assign(
+			std::make_move_iterator(this->sessions.end() - count), std::make_move_iterator(this->sessions.end()));
+		this->sessions.resize(this->sessions.size() - count);
+	}
+
+	// Deleted unlocked: stopping closes transports, which can take a while.
+	removed.clear();
+}
+
+BroadcasterHost::Stats BroadcasterHost::GetStats() const
+{
+	Stats stats;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		stats.sessions = this->sessions.size();
+		stats.failed = this->failed;
+	}
+	stats.memoryBytes = getProcessMemoryBytes();
+	stats.threads = getProcessThreadCount();
+
+	const double sessions = static_cast<double>(std::max<size_t>(stats.sessions, 1));
+	stats.memoryPerSessionBytes =
+		(static_cast<double>(stats.memoryBytes) - static_cast<double>(this->baselineMemoryBytes)) / sessions;
+	stats.threadsPerSession = static_cast<double>(stats.threads - this->baselineThreads) / sessions;
+
+	return stats;
+}
+
+std::vector<double> BroadcasterHost::GetStartupMs() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->startupMs;
+}
+
+uint64_t BroadcasterHost::GetBytesSent() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	uint64_t bytesSent = 0;
+	for (const auto& session : this->sessions)
+		bytesSent += session->GetBytesSent();
+
+	return bytesSent;
+}
+
+uint64_t BroadcasterHost::GetBytesReceived() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	uint64_t bytesReceived = 0;
+	for (const auto& session : this->sessions)
+		bytesReceived += session->GetBytesReceived();
+
+	return bytesReceived;
+}
+
+std::vector<std::string> BroadcasterHost::GetProducerIds() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	std::vector<std::string> producerIds;
+	for (const auto& session : this->sessions)
+	{
+		for (auto& producerId : session->GetProducerIds())
+			producerIds.push_back(std::move(producerId));
+	}
+
+	return producerIds;
+}
+
+ReconnectionManager::Stats BroadcasterHost::GetReconnectionStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	ReconnectionManager::Stats total = {};
+	double totalRecoveryMs = 0;
+	for (const auto& session : this->sessions)
+	{
+		const ReconnectionManager::Stats stats = session->GetReconnectionStats();
+
+		total.disconnections += stats.disconnections;
+		total.selfRecoveries += stats.selfRecoveries;
+		total.iceRestarts += stats.iceRestarts;
+		total.recoveries += stats.recoveries;
+		total.failures += stats.failures;
+		total.lastRecoveryMs = std::max(total.lastRecoveryMs, stats.lastRecoveryMs);
+		total.maxRecoveryMs = std::max(total.maxRecoveryMs, stats.maxRecoveryMs);
+		totalRecoveryMs += stats.meanRecoveryMs * stats.recoveries;
+	}
+	if (total.recoveries > 0)
+		total.meanRecoveryMs = totalRecoveryMs / total.recoveries;
+
+	return total;
+}
+
+#ifdef _WIN32
+uint64_t getProcessMemoryBytes()
+{
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.WorkingSetSize;
+}
+
+int64_t getProcessThreadCount()
+{
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot == INVALID_HANDLE_VALUE)
+		return 0;
+
+	const DWORD processId = GetCurrentProcessId();
+	int64_t count = 0;
+	THREADENTRY32 entry = {};
+	entry.dwSize = sizeof(entry);
+	for (BOOL found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry))
+	{
+		if (entry.th32OwnerProcessID == processId)
+			++count;
+	}
+	CloseHandle(snapshot);
+
+	return count;
+}
+#else
+// Reads a "Name:   value" line of /proc/self/status.
+static int64_t readProcStatus(const std::string& name)
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, name.size() + 1, name + ":") == 0)
+			return std::stoll(line.substr(name.size() + 1));
+	}
+
+	return 0;
+}
+
+uint64_t getProcessMemoryBytes()
+{
+	return static_cast<uint64_t>(readProcStatus("VmRSS")) * 1024;
+}
+
+int64_t getProcessThreadCount()
+{
+	return readProcStatus("Threads");
+}
+#endif
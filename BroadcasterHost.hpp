@@ -0,0 +1,107 @@
+#ifndef MSC_TEST_BROADCASTER_HOST_HPP
+#define MSC_TEST_BROADCASTER_HOST_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Broadcaster.hpp"
+#include "json.hpp"
+
+/* Runs many Broadcaster sessions in one process for load tests. Sessions
+ * share what does not need to be per publisher: one loaded Device, the
+ * factory shards, one synthetic audio and video track per shard feeding
+ * every producer of the shard, a few pipelined signaling connections and the
+ * timer wheel. What is left per session is mostly its peer connection.
+ * Sessions can also consume the producers of another host's sessions.
+ */
+class BroadcasterHost
+{
+public:
+	struct Options
+	{
+		// e.g. "http://127.0.0.1:4443/rooms/load"
+		std::string baseUrl;
+		nlohmann::json routerRtpCapabilities;
+		Broadcaster::StartOptions session;
+		// Signaling connections shared round-robin by the sessions.
+		size_t signalingConnections = 4;
+		// Sessions starting at the same time in AddSessions().
+		size_t startConcurrency = 16;
+		// Each session consumes consumeCount producers of the sessions of
+		// consumeFrom running when it starts, spread round-robin. consumeFrom
+		// must outlive this host.
+		const BroadcasterHost* consumeFrom = nullptr;
+		size_t consumeCount = 0;
+	};
+
+	struct Stats
+	{
+		// Running sessions; failed ones are not kept.
+		size_t sessions;
+		uint64_t failed;
+		// Process figures, and their growth since the host was created
+		// divided by the sessions.
+		uint64_t memoryBytes;
+		int64_t threads;
+		double memoryPerSessionBytes;
+		double threadsPerSession;
+	};
+
+	// Throws if the router capabilities cannot be loaded.
+	explicit BroadcasterHost(const Options& options);
+	// Stops every session.
+	~BroadcasterHost();
+
+	// Starts count sessions and returns how many started. Failed sessions
+	// are dropped.
+	size_t AddSessions(size_t count);
+	// Stops the most recent sessions.
+	void RemoveSessions(size_t count);
+
+	Stats GetStats() const;
+
+	// Start() durations of the sessions that started, in start order.
+	std::vector<double> GetStartupMs() const;
+
+	// Bytes sent by all sessions. Costly: queries every peer connection.
+	uint64_t GetBytesSent() const;
+
+	// RTP bytes received by all sessions. Costly as GetBytesSent().
+	uint64_t GetBytesReceived() const;
+
+	// Producers of the running sessions.
+	std::vector<std::string> GetProducerIds() const;
+
+	// Connectivity losses and recoveries of the running sessions, summed;
+	// recovery times over all their recoveries.
+	ReconnectionManager::Stats GetReconnectionStats() const;
+
+private:
+	const Options options;
+	mediasoupclient::Device device;
+	std::vector<std::shared_ptr<SignalingClient>> signalingClients;
+	// Per shard.
+	std::vector<rtc::scoped_refptr<webrtc::AudioTrackInterface>> audioTracks;
+	std::vector<rtc::scoped_refptr<webrtc::VideoTrackInterface>> videoTracks;
+	uint64_t baselineMemoryBytes;
+	int64_t baselineThreads;
+
+	mutable std::mutex mutex;
+	std::vector<std::unique_ptr<Broadcaster>> sessions;
+	size_t nextSession = 0;
+	uint64_t failed = 0;
+	std::vector<double> startupMs;
+};
+
+// Resident memory of the process.
+uint64_t getProcessMemoryBytes();
+int64_t getProcessThreadCount();
+
+#endif
\ No newline at end of file
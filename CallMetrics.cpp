@@ -0,0 +1,275 @@
+#define MSC_CLASS "CallMetrics"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "CallMetrics.hpp"
+
+namespace callmetrics
+{
+	std::atomic<bool> enabled{ false };
+
+	// Values below 2 * kSubBuckets ns have a bucket each; above, every octave
+	// has kSubBuckets buckets. Up to 2^41 ns (36 minutes), longer calls count
+	// as that.
+	constexpr int kSubBucketBits = 5;
+	constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+	constexpr int kMaxBit = 40;
+	constexpr uint64_t kMaxNs = (uint64_t(1) << (kMaxBit + 1)) - 1;
+	constexpr size_t kBuckets = (kMaxBit - kSubBucketBits + 2) * kSubBuckets;
+
+	// Written by the thread of its shard only, so plain stores do.
+	struct Site
+	{
+		explicit Site(const char* name)
+			: name(name)
+		{
+			this->Clear();
+		}
+
+		void Clear()
+		{
+			this->calls = 0;
+			this->errors = 0;
+			this->totalNs = 0;
+			this->maxNs = 0;
+			for (auto& bucket : this->buckets)
+				bucket = 0;
+		}
+
+		const char* name;
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> errors;
+		std::atomic<uint64_t> totalNs;
+		std::atomic<uint64_t> maxNs;
+		std::atomic<uint64_t> buckets[kBuckets];
+	};
+
+	struct Shard
+	{
+		// Taken by the owner thread to add a site, and by readers.
+		std::mutex mutex;
+		std::unordered_map<const char*, std::unique_ptr<Site>> sites;
+		// Reset generation the sites were last cleared for.
+		std::atomic<uint64_t> generation{ 0 };
+	};
+
+	// Shards outlive their threads, which keeps the calls they made.
+	std::mutex shardsMutex;
+	std::vector<std::unique_ptr<Shard>> shards;
+	std::atomic<uint64_t> generation{ 0 };
+
+	thread_local Shard* currentShard = nullptr;
+	thread_local CallScope* currentScope = nullptr;
+
+	int highestBit(uint64_t value)
+	{
+		int bit = 0;
+		for (int step = 32; step > 0; step /= 2)
+		{
+			if (value >> (bit + step))
+				bit += step;
+		}
+
+		return bit;
+	}
+
+	size_t bucketOf(uint64_t ns)
+	{
+		if (ns < 2 * kSubBuckets)
+			return static_cast<size_t>(ns);
+
+		const int shift = highestBit(ns) - kSubBucketBits;
+
+		return static_cast<size_t>((shift + 1) * kSubBuckets + (ns >> shift) - kSubBuckets);
+	}
+
+	// Middle of the values of bucket.
+	double valueOf(size_t bucket)
+	{
+		if (bucket < 2 * kSubBuckets)
+			return static_cast<double>(bucket);
+
+		const int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+		const uint64_t low = (bucket % kSubBuckets + kSubBuckets) << shift;
+
+		return low + ((uint64_t(1) << shift) - 1) / 2.0;
+	}
+
+	void add(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	Shard* getShard()
+	{
+		if (!currentShard)
+		{
+			std::unique_ptr<Shard> shard(new Shard());
+			shard->generation = generation.load();
+			currentShard = shard.get();
+
+			std::lock_guard<std::mutex> lock(shardsMutex);
+			shards.push_back(std::move(shard));
+		}
+
+		// Cleared by its own thread, so that readers never see half a reset.
+		const uint64_t current = generation.load(std::memory_order_acquire);
+		if (currentShard->generation.load(std::memory_order_relaxed) != current)
+		{
+			for (auto& site : currentShard->sites)
+				site.second->Clear();
+			currentShard->generation.store(current, std::memory_order_release);
+		}
+
+		return currentShard;
+	}
+
+	Site* getSite(const char* name)
+	{
+		Shard* shard = getShard();
+
+		auto it = shard->sites.find(name);
+		if (it != shard->sites.end())
+			return it->second.get();
+
+		std::lock_guard<std::mutex> lock(shard->mutex);
+
+		return shard->sites.emplace(name, std::unique_ptr<Site>(new Site(name))).first->second.get();
+	}
+
+	double percentile(const std::vector<uint64_t>& buckets, uint64_t count, double fraction)
+	{
+		const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(fraction * count + 0.5), 1);
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket < buckets.size(); ++bucket)
+		{
+			seen += buckets[bucket];
+			if (seen >= rank)
+				return valueOf(bucket);
+		}
+
+		return 0;
+	}
+}
+
+void CallScope::Start(const char* name)
+{
+	this->site = callmetrics::getSite(name);
+	this->outer = callmetrics::currentScope;
+	callmetrics::currentScope = this;
+	this->start = std::chrono::steady_clock::now();
+}
+
+void CallScope::Stop()
+{
+	using namespace callmetrics;
+
+	const auto elapsed = std::chrono::steady_clock::now() - this->start;
+	const uint64_t ns = std::min<uint64_t>(
+		static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), kMaxNs);
+
+	currentScope = this->outer;
+
+	Site* site = this->site;
+	add(site->calls, 1);
+	if (this->failed)
+		add(site->errors, 1);
+	add(site->totalNs, ns);
+	if (ns > site->maxNs.load(std::memory_order_relaxed))
+		site->maxNs.store(ns, std::memory_order_relaxed);
+	add(site->buckets[bucketOf(ns)], 1);
+}
+
+void enableCallMetrics(bool enable)
+{
+	callmetrics::enabled = enable;
+}
+
+bool isCallMetricsEnabled()
+{
+	return callmetrics::enabled;
+}
+
+void markCallFailed()
+{
+	if (callmetrics::currentScope)
+		callmetrics::currentScope->failed = true;
+}
+
+std::vector<CallMetrics> getCallMetrics()
+{
+	using namespace callmetrics;
+
+	struct Merged
+	{
+		uint64_t calls = 0;
+		uint64_t errors = 0;
+		uint64_t totalNs = 0;
+		uint64_t maxNs = 0;
+		std::vector<uint64_t> buckets = std::vector<uint64_t>(kBuckets);
+	};
+
+	const uint64_t current = generation.load(std::memory_order_acquire);
+	std::map<std::string, Merged> merged;
+
+	{
+		std::lock_guard<std::mutex> shardsLock(shardsMutex);
+
+		for (auto& shard : shards)
+		{
+			std::lock_guard<std::mutex> lock(shard->mutex);
+
+			// Not cleared since the last reset: nothing called since.
+			if (shard->generation.load(std::memory_order_acquire) != current)
+				continue;
+
+			for (auto& entry : shard->sites)
+			{
+				const Site& site = *entry.second;
+				Merged& total = merged[site.name];
+
+				total.calls += site.calls.load(std::memory_order_relaxed);
+				total.errors += site.errors.load(std::memory_order_relaxed);
+				total.totalNs += site.totalNs.load(std::memory_order_relaxed);
+				total.maxNs = std::max(total.maxNs, site.maxNs.load(std::memory_order_relaxed));
+				for (size_t bucket = 0; bucket < kBuckets; ++bucket)
+					total.buckets[bucket] += site.buckets[bucket].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	std::vector<CallMetrics> metrics;
+	for (const auto& entry : merged)
+	{
+		const Merged& total = entry.second;
+		if (total.calls == 0)
+			continue;
+
+		// The buckets may count a call the counters missed, or the reverse.
+		uint64_t count = 0;
+		for (uint64_t bucket : total.buckets)
+			count += bucket;
+
+		CallMetrics call;
+		call.name = entry.first;
+		call.calls = total.calls;
+		call.errors = total.errors;
+		call.totalMs = total.totalNs / 1e6;
+		call.meanUs = total.totalNs / 1e3 / total.calls;
+		call.p50Us = std::min(percentile(total.buckets, count, 0.5), static_cast<double>(total.maxNs)) / 1e3;
+		call.p99Us = std::min(percentile(total.buckets, count, 0.99), static_cast<double>(total.maxNs)) / 1e3;
+		call.p999Us = std::min(percentile(total.buckets, count, 0.999), static_cast<double>(total.maxNs)) / 1e3;
+		call.maxUs = total.maxNs / 1e3;
+		metrics.push_back(call);
+	}
+
+	return metrics;
+}
+
+void resetCallMetrics()
+{
+	++callmetrics::generation;
+}
\ No newline at end of file
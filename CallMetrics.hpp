@@ -0,0 +1,90 @@
+#ifndef MSC_TEST_CALL_METRICS_HPP
+#define MSC_TEST_CALL_METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Call counts, error counts and latency histograms of the DLL exports, to see
+ * where the time of a join or of a frame goes on the Unity side. Disabled by
+ * default; each call then costs one load and one predictable branch on entry.
+ *
+ * Every thread records into a shard of its own without locks, and shards are
+ * only merged by getCallMetrics(). Latencies go into log-linear buckets of
+ * 1/32 of an octave (3% precision, as in HdrHistogram) of steady clock time,
+ * also on simulated time.
+ */
+
+struct CallMetrics
+{
+	std::string name;
+	uint64_t calls;
+	// Calls which logged an error (see markCallFailed()).
+	uint64_t errors;
+	double totalMs;
+	double meanUs;
+	double p50Us;
+	double p99Us;
+	double p999Us;
+	double maxUs;
+};
+
+namespace callmetrics
+{
+	// Read on every call, hence not behind a function.
+	extern std::atomic<bool> enabled;
+
+	struct Site;
+}
+
+// Times the enclosing scope as the call of name, which must be a string
+// literal or __func__. Calls nested on the same thread are timed too.
+class CallScope
+{
+public:
+	explicit CallScope(const char* name)
+	{
+		if (callmetrics::enabled.load(std::memory_order_relaxed))
+			this->Start(name);
+	}
+
+	~CallScope()
+	{
+		if (this->site)
+			this->Stop();
+	}
+
+	CallScope(const CallScope&) = delete;
+	CallScope& operator=(const CallScope&) = delete;
+
+private:
+	void Start(const char* name);
+	void Stop();
+
+	friend void markCallFailed();
+
+	callmetrics::Site* site = nullptr;
+	CallScope* outer = nullptr;
+	std::chrono::steady_clock::time_point start;
+	bool failed = false;
+};
+
+// First statement of every DLL export.
+#define MSC_CALL_METRICS() CallScope callScope(__func__)
+
+void enableCallMetrics(bool enable);
+
+bool isCallMetricsEnabled();
+
+// Counts the innermost call timed on this thread as failed, if any.
+void markCallFailed();
+
+// Since the last reset, by name.
+std::vector<CallMetrics> getCallMetrics();
+
+// Calls in progress are not counted.
+void resetCallMetrics();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+#define MSC_CLASS "CapabilityCache"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "CapabilityCache.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "DebugCpp.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// File layout: magic, format version, payload size, then the CBOR payload
+	// { "buildId": ..., "entries": { routerKey: entry, ... } }.
+	const char kMagic[4] = { 'M', 'S', 'C', 'C' };
+	const uint32_t kFormatVersion = 1;
+	const size_t kHeaderSize = sizeof(kMagic) + sizeof(uint32_t) + sizeof(uint64_t);
+
+	int64_t nowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+		         std::chrono::system_clock::now().time_since_epoch())
+		  .count();
+	}
+
+	// Read-only view of a whole file, empty if it cannot be mapped.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& path)
+		{
+#ifdef _WIN32
+			this->file = CreateFileA(
+				path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (this->file == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(this->file, &size) || size.QuadPart == 0)
+				return;
+
+			this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (this->mapping == nullptr)
+				return;
+
+			this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+			if (this->data)
+				this->size = static_cast<size_t>(size.QuadPart);
+#else
+			this->file = open(path.c_str(), O_RDONLY);
+			if (this->file < 0)
+				return;
+
+			struct stat status;
+			if (fstat(this->file, &status) != 0 || status.st_size == 0)
+				return;
+
+			void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, this->file, 0);
+			if (view == MAP_FAILED)
+				return;
+
+			this->data = static_cast<const uint8_t*>(view);
+			this->size = static_cast<size_t>(status.st_size);
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (this->data)
+				UnmapViewOfFile(this->data);
+			if (this->mapping)
+				CloseHandle(this->mapping);
+			if (this->file != INVALID_HANDLE_VALUE)
+				CloseHandle(this->file);
+#else
+			if (this->data)
+				munmap(const_cast<uint8_t*>(this->data), this->size);
+			if (this->file >= 0)
+				close(this->file);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+	private:
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
+	};
+
+	std::string currentMachineId()
+	{
+		char name[256] = {};
+#ifdef _WIN32
+		DWORD size = sizeof(name);
+		if (!GetComputerNameA(name, &size))
+			return "";
+#else
+		if (gethostname(name, sizeof(name) - 1) != 0)
+			return "";
+#endif
+
+		return name;
+	}
+
+	bool replaceFile(const std::string& from, const std::string& to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+} // namespace
+
+CapabilityCache::CapabilityCache(const std::string& path, std::chrono::milliseconds maxAge, const std::string& buildId)
+	: path(path), maxAge(maxAge), buildId(buildId), machineId(currentMachineId())
+{
+	this->Load();
+}
+
+bool CapabilityCache::Find(const std::string& routerKey, Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto it = this->entries.find(routerKey);
+	if (it == this->entries.end() || nowMs() - it->second.storedAtMs > this->maxAge.count())
+	{
+		++this->stats.misses;
+
+		return false;
+	}
+
+	++this->stats.hits;
+	entry = it->second;
+
+	return true;
+}
+
+bool CapabilityCache::FindByHash(const std::string& routerHash, Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (const auto& candidate : this->entries)
+	{
+		if (candidate.second.routerHash == routerHash)
+		{
+			++this->stats.hits;
+			entry = candidate.second;
+
+			return true;
+		}
+	}
+
+	++this->stats.misses;
+
+	return false;
+}
+
+void CapabilityCache::Store(
+	const std::string& routerKey, const nlohmann::json& routerRtpCapabilities, const mediasoupclient::Device& device)
+{
+	if (!device.IsLoaded())
+		MSC_THROW_INVALID_STATE_ERROR("device not loaded");
+
+	Entry entry;
+	entry.routerHash = hashRtpCapabilities(routerRtpCapabilities);
+	entry.routerRtpCapabilities = routerRtpCapabilities;
+	entry.rtpCapabilities = device.GetRtpCapabilities();
+	entry.sctpCapabilities = device.GetSctpCapabilities();
+	entry.storedAtMs = nowMs();
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->entries[routerKey] = std::move(entry);
+	++this->stats.stores;
+	this->Save();
+}
+
+void CapabilityCache::Invalidate(const std::string& routerKey)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->entries.erase(routerKey) > 0)
+		this->Save();
+}
+
+CapabilityCache::Stats CapabilityCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Stats stats = this->stats;
+	stats.entries = this->entries.size();
+
+	return stats;
+}
+
+void CapabilityCache::Load()
+{
+	MappedFile file(this->path);
+	if (file.size < kHeaderSize)
+		return;
+
+	uint32_t formatVersion;
+	uint64_t payloadSize;
+	std::memcpy(&formatVersion, file.data + sizeof(kMagic), sizeof(formatVersion));
+	std::memcpy(&payloadSize, file.data + sizeof(kMagic) + sizeof(formatVersion), sizeof(payloadSize));
+
+	if (
+	  std::memcmp(file.data, kMagic, sizeof(kMagic)) != 0 || formatVersion != kFormatVersion ||
+	  payloadSize > file.size - kHeaderSize)
+	{
+		Debug::Log("[WARN] ignoring capability cache " + this->path + ": not a cache file of this version");
+
+		return;
+	}
+
+	try
+	{
+		const uint8_t* payload = file.data + kHeaderSize;
+		auto json = nlohmann::json::from_cbor(payload, payload + payloadSize);
+
+		if (json.value("buildId", "") != this->buildId)
+		{
+			Debug::Log("[INFO] capability cache " + this->path + " is from another build, ignoring it");
+
+			return;
+		}
+
+		if (json.value("machineId", "") != this->machineId)
+		{
+			Debug::Log("[INFO] capability cache " + this->path + " is from another machine, ignoring it");
+
+			return;
+		}
+
+		for (const auto& item : json.at("entries").items())
+		{
+			const auto& value = item.value();
+
+			Entry entry;
+			entry.routerHash = value.at("routerHash").get<std::string>();
+			entry.routerRtpCapabilities = value.at("routerRtpCapabilities");
+			entry.rtpCapabilities = value.at("rtpCapabilities");
+			entry.sctpCapabilities = value.at("sctpCapabilities");
+			entry.storedAtMs = value.at("storedAtMs").get<int64_t>();
+
+			this->entries[item.key()] = std::move(entry);
+		}
+	}
+	catch (std::exception& e)
+	{
+		this->entries.clear();
+
+		Debug::Log("[ERROR]ignoring corrupt capability cache " + this->path + ": " + e.what(), Color::Red);
+	}
+}
+
+// Must be called with mutex held.
+void CapabilityCache::Save()
+{
+	nlohmann::json entries = nlohmann::json::object();
+	for (const auto& item : this->entries)
+	{
+		const Entry& entry = item.second;
+
+		/* clang-format off */
+		entries[item.first] =
+		{
+			{ "routerHash",            entry.routerHash            },
+			{ "routerRtpCapabilities", entry.routerRtpCapabilities },
+			{ "rtpCapabilities",       entry.rtpCapabilities       },
+			{ "sctpCapabilities",      entry.sctpCapabilities      },
+			{ "storedAtMs",            entry.storedAtMs            }
+		};
+		/* clang-format on */
+	}
+
+	/* clang-format off */
+	nlohmann::json json =
+	{
+		{ "buildId",   this->buildId   },
+		{ "machineId", this->machineId },
+		{ "entries",   entries         }
+	};
+	/* clang-format on */
+
+	const std::vector<uint8_t> payload = nlohmann::json::to_cbor(json);
+	const uint64_t payloadSize = payload.size();
+
+	// Written aside then renamed over, so that a process mapping the file
+	// concurrently never sees a partial one.
+	const std::string temporaryPath = this->path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(kMagic, sizeof(kMagic));
+		file.write(reinterpret_cast<const char*>(&kFormatVersion), sizeof(kFormatVersion));
+		file.write(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+		file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+		if (!file)
+			MSC_THROW_ERROR("cannot write capability cache %s", temporaryPath.c_str());
+	}
+
+	if (!replaceFile(temporaryPath, this->path))
+		MSC_THROW_ERROR("cannot replace capability cache %s", this->path.c_str());
+}
+
+std::string hashRtpCapabilities(const nlohmann::json& rtpCapabilities)
+{
+	// FNV-1a over the serialization, whose object keys are sorted.
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : rtpCapabilities.dump())
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+
+	char text[17];
+	std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+
+	return text;
+}
+
+static std::mutex capabilityCacheMutex;
+static std::shared_ptr<CapabilityCache> capabilityCache;
+
+void setCapabilityCachePath(const std::string& path)
+{
+	auto cache = path.empty() ? nullptr : std::make_shared<CapabilityCache>(path);
+
+	std::lock_guard<std::mutex> lock(capabilityCacheMutex);
+
+	capabilityCache = cache;
+}
+
+std::shared_ptr<CapabilityCache> getCapabilityCache()
+{
+	std::lock_guard<std::mutex> lock(capabilityCacheMutex);
+
+	return capabilityCache;
+}
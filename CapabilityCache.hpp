@@ -0,0 +1,102 @@
+#ifndef MSC_TEST_CAPABILITY_CACHE_HPP
+#define MSC_TEST_CAPABILITY_CACHE_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "mediasoupclient.hpp"
+#include "json.hpp"
+
+// Identifies the client build whose Device computed the cached capabilities.
+// Pass -DMSC_BUILD_ID=\"...\" from the build system to share a cache between
+// builds of identical sources.
+#ifndef MSC_BUILD_ID
+#define MSC_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+/* Router RTP capabilities and the capabilities a Device computed from them,
+ * persisted across process starts. A warm start can skip downloading the
+ * capabilities of a known router, and does not have to wait for
+ * Device::Load() before sending its own capabilities to the server.
+ *
+ * The file is memory-mapped and parsed once when the cache is opened; stores
+ * rewrite it and atomically replace the previous one. Entries of another
+ * client build or of another machine, whose codecs may differ, are dropped,
+ * and an entry is replaced when the router capabilities hash differs. A
+ * missing or corrupt file is an empty cache.
+ */
+class CapabilityCache
+{
+public:
+	struct Entry
+	{
+		// hashRtpCapabilities() of routerRtpCapabilities.
+		std::string routerHash;
+		nlohmann::json routerRtpCapabilities;
+		// Device::GetRtpCapabilities() and GetSctpCapabilities() once loaded.
+		nlohmann::json rtpCapabilities;
+		nlohmann::json sctpCapabilities;
+		int64_t storedAtMs;
+	};
+
+	struct Stats
+	{
+		size_t entries;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t stores;
+	};
+
+	// Entries older than maxAge are not returned by Find(); FindByHash() is
+	// not affected, the capabilities being known to match.
+	explicit CapabilityCache(
+		const std::string& path,
+		std::chrono::milliseconds maxAge = std::chrono::hours(24),
+		const std::string& buildId = MSC_BUILD_ID);
+
+	// Latest entry for the router, e.g. its room URL.
+	bool Find(const std::string& routerKey, Entry& entry);
+	// Entry of these router capabilities, whatever the router.
+	bool FindByHash(const std::string& routerHash, Entry& entry);
+
+	// Saves the capabilities of a loaded device. Throws if the file cannot be
+	// written.
+	void Store(const std::string& routerKey, const nlohmann::json& routerRtpCapabilities, const mediasoupclient::Device& device);
+	void Invalidate(const std::string& routerKey);
+
+	Stats GetStats() const;
+
+private:
+	void Load();
+	void Save();
+
+	const std::string path;
+	const std::chrono::milliseconds maxAge;
+	const std::string buildId;
+	// Host name, a cache file may be shared between machines.
+	const std::string machineId;
+
+	mutable std::mutex mutex;
+	std::map<std::string, Entry> entries;
+	Stats stats = {};
+};
+
+// Hash of the canonical serialization of router RTP capabilities.
+std::string hashRtpCapabilities(const nlohmann::json& rtpCapabilities);
+
+// Opens the process-wide cache, replacing the previous one. An empty path
+// disables it.
+void setCapabilityCachePath(const std::string& path);
+
+// The process-wide cache, nullptr if disabled, which it is by default.
+std::shared_ptr<CapabilityCache> getCapabilityCache();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#define MSC_CLASS "CertificatePool"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include "CertificatePool.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "PeerConnection.hpp"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/time_utils.h"
+#include "DebugCpp.h"
+
+static std::mutex poolMutex;
+static std::deque<rtc::scoped_refptr<rtc::RTCCertificate>> pool;
+
+static std::mutex cacheMutex;
+static int64_t certificateLifetimeMs = kDefaultCertificateLifetimeMs;
+static rtc::scoped_refptr<rtc::RTCCertificate> cachedCertificate;
+static int64_t cachedAtMs;
+
+/* Same key type the peer connection generates by default, valid for
+ * lifetimeMs and the margin.
+ */
+static rtc::scoped_refptr<rtc::RTCCertificate> generateCertificate(int64_t lifetimeMs)
+{
+	return rtc::RTCCertificateGenerator::GenerateCertificate(
+		rtc::KeyParams::ECDSA(), lifetimeMs + kCertificateValidityMarginMs);
+}
+
+void generateCertificates(size_t count)
+{
+	const int64_t startMs = rtc::TimeMillis();
+	/* Long enough to be cached, or to be taken by a transport of its own. */
+	const int64_t lifetimeMs = std::max(getCertificateLifetime(), kDefaultCertificateLifetimeMs);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		rtc::scoped_refptr<rtc::RTCCertificate> certificate = generateCertificate(lifetimeMs);
+
+		if (!certificate)
+		{
+			Debug::Log("[ERROR]certificate generation errored", Color::Red);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(poolMutex);
+
+		pool.push_back(certificate);
+	}
+
+	Debug::Log("[INFO] generated " + std::to_string(count) + " certificate(s) in " +
+		std::to_string(rtc::TimeMillis() - startMs) + " ms");
+}
+
+rtc::scoped_refptr<rtc::RTCCertificate> takeCertificate()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	if (pool.empty())
+		return nullptr;
+
+	rtc::scoped_refptr<rtc::RTCCertificate> certificate = pool.front();
+	pool.pop_front();
+
+	return certificate;
+}
+
+size_t getPooledCertificateCount()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	return pool.size();
+}
+
+void setCertificateLifetime(int64_t lifetimeMs)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	certificateLifetimeMs = std::min(std::max<int64_t>(lifetimeMs, 0), kMaxCertificateLifetimeMs);
+	if (certificateLifetimeMs == 0)
+		cachedCertificate = nullptr;
+}
+
+int64_t getCertificateLifetime()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	return certificateLifetimeMs;
+}
+
+rtc::scoped_refptr<rtc::RTCCertificate> getCachedCertificate()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	if (certificateLifetimeMs == 0)
+		return nullptr;
+
+	/* The certificate must also stay valid for the DTLS handshakes to come. */
+	const int64_t nowMs = rtc::TimeMillis();
+	if (cachedCertificate &&
+		nowMs - cachedAtMs < certificateLifetimeMs &&
+		!cachedCertificate->HasExpired(rtc::TimeUTCMillis() + kCertificateValidityMarginMs))
+	{
+		return cachedCertificate;
+	}
+
+	/* A pooled certificate generated for a shorter lifetime is dropped. */
+	rtc::scoped_refptr<rtc::RTCCertificate> certificate = takeCertificate();
+	if (!certificate ||
+		certificate->HasExpired(rtc::TimeUTCMillis() + certificateLifetimeMs + kCertificateValidityMarginMs))
+	{
+		certificate = generateCertificate(certificateLifetimeMs);
+	}
+
+	if (!certificate)
+	{
+		Debug::Log("[ERROR]certificate generation errored", Color::Red);
+		return nullptr;
+	}
+
+	cachedCertificate = certificate;
+	cachedAtMs = nowMs;
+
+	return cachedCertificate;
+}
+
+/* Each transport generates its own certificate unless one is given. */
+static double measureTransportCreation(
+	webrtc::PeerConnectionFactoryInterface* factory,
+	int iterations,
+	rtc::scoped_refptr<rtc::RTCCertificate> certificate)
+{
+	int64_t totalUs = 0;
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		const int64_t startUs = rtc::TimeMicros();
+
+		mediasoupclient::PeerConnection::Options options;
+		options.factory = factory;
+		if (certificate)
+			options.config.certificates.push_back(certificate);
+
+		mediasoupclient::PeerConnection::PrivateListener listener;
+		mediasoupclient::PeerConnection peerConnection(&listener, &options);
+		peerConnection.CreateOffer(webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+
+		totalUs += rtc::TimeMicros() - startUs;
+		peerConnection.Close();
+	}
+
+	return static_cast<double>(totalUs) / iterations / 1000.0;
+}
+
+TransportCreationBenchmark benchmarkTransportCreation(
+	webrtc::PeerConnectionFactoryInterface* factory, int iterations)
+{
+	TransportCreationBenchmark result;
+	result.iterations = std::max(iterations, 1);
+
+	/* Generated ahead, out of the figures. With the cache disabled, a local
+	 * certificate stands in for it rather than enabling the cache for the
+	 * whole process, whose transports would pick it up meanwhile.
+	 */
+	rtc::scoped_refptr<rtc::RTCCertificate> certificate = getCachedCertificate();
+	if (!certificate)
+		certificate = generateCertificate(kDefaultCertificateLifetimeMs);
+	if (!certificate)
+	{
+		Debug::Log("[ERROR]certificate generation errored", Color::Red);
+		MSC_THROW_ERROR("certificate generation errored");
+	}
+
+	result.withoutCacheMs = measureTransportCreation(factory, result.iterations, nullptr);
+	result.withCacheMs = measureTransportCreation(factory, result.iterations, certificate);
+
+	return result;
+}
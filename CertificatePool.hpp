@@ -0,0 +1,60 @@
+#ifndef MSC_TEST_CERTIFICATE_POOL_HPP
+#define MSC_TEST_CERTIFICATE_POOL_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include "api/peer_connection_interface.h"
+#include "api/scoped_refptr.h"
+#include "rtc_base/rtc_certificate.h"
+
+/* ECDSA DTLS certificates generated ahead of time, so that transports do not
+ * generate their own while joining, and a process-level cache sharing one
+ * certificate across transports.
+ */
+
+// Generates certificates into the pool. Blocks, meant for a warm-up thread.
+void generateCertificates(size_t count);
+
+// Returns a pooled certificate, or nullptr if the pool is empty and the peer
+// connection has to generate its own.
+rtc::scoped_refptr<rtc::RTCCertificate> takeCertificate();
+
+size_t getPooledCertificateCount();
+
+constexpr int64_t kDefaultCertificateLifetimeMs = 24 * 60 * 60 * 1000;
+
+// How long a certificate stays valid after it was last handed out, for the
+// DTLS handshakes in progress.
+constexpr int64_t kCertificateValidityMarginMs = 60 * 60 * 1000;
+
+// Certificates are generated valid for at most a year.
+constexpr int64_t kMaxCertificateLifetimeMs = 365LL * 24 * 60 * 60 * 1000 - kCertificateValidityMarginMs;
+
+// How long the cached certificate is reused before a new one replaces it,
+// clamped to kMaxCertificateLifetimeMs. 0 disables the cache.
+void setCertificateLifetime(int64_t lifetimeMs);
+
+int64_t getCertificateLifetime();
+
+// Certificate shared by every transport created while it is valid. A new one
+// is taken from the pool, or generated, when it expires. nullptr if the cache
+// is disabled.
+rtc::scoped_refptr<rtc::RTCCertificate> getCachedCertificate();
+
+struct TransportCreationBenchmark
+{
+	int iterations;
+	// Average time to create a peer connection and its first offer, which
+	// waits for the certificate.
+	double withoutCacheMs;
+	double withCacheMs;
+};
+
+TransportCreationBenchmark benchmarkTransportCreation(
+	webrtc::PeerConnectionFactoryInterface* factory, int iterations);
+
+#endif
\ No newline at end of file
@@ -1,5 +1,6 @@
-#include "DebugCPP.h"
+#include "DebugCpp.h"
 
+#include <cstring>
 #include<stdio.h>
 #include <string>
 #include <stdio.h>
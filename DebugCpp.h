@@ -4,7 +4,11 @@
 #include <stdio.h>
 #include <sstream>
 
+#ifdef _WIN32
 #define DLLExport __declspec(dllexport)
+#else
+#define DLLExport __attribute__((visibility("default")))
+#endif
 
 extern "C"
 {
@@ -0,0 +1,318 @@
+#define MSC_CLASS "Http"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "Http.hpp"
+
+static std::string toLower(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	return text;
+}
+
+static std::string trim(const std::string& text)
+{
+	const size_t begin = text.find_first_not_of(" \t");
+	const size_t end = text.find_last_not_of(" \t\r");
+
+	return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+std::string HttpMessage::Header(const std::string& name) const
+{
+	auto it = this->headers.find(toLower(name));
+
+	return it == this->headers.end() ? std::string() : it->second;
+}
+
+int HttpMessage::Status() const
+{
+	if (this->startLine.compare(0, 5, "HTTP/") != 0)
+		return 0;
+
+	const size_t space = this->startLine.find(' ');
+
+	return space == std::string::npos ? 0 : std::atoi(this->startLine.c_str() + space + 1);
+}
+
+std::string HttpMessage::Method() const
+{
+	return this->startLine.substr(0, this->startLine.find(' '));
+}
+
+std::string HttpMessage::Target() const
+{
+	const size_t begin = this->startLine.find(' ');
+	if (begin == std::string::npos)
+		return std::string();
+	const size_t end = this->startLine.find(' ', begin + 1);
+
+	return this->startLine.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1);
+}
+
+void HttpMessageParser::Feed(const char* data, size_t size)
+{
+	this->buffer.append(data, size);
+}
+
+bool HttpMessageParser::Next(HttpMessage& message)
+{
+	while (true)
+	{
+		switch (this->state)
+		{
+		case State::Head:
+		{
+			const size_t end = this->buffer.find("\r\n\r\n");
+			if (end == std::string::npos)
+				return false;
+
+			this->current = HttpMessage();
+			size_t lineStart = 0;
+			bool first = true;
+			while (lineStart < end)
+			{
+				size_t lineEnd = this->buffer.find("\r\n", lineStart);
+				if (lineEnd == std::string::npos || lineEnd > end)
+					lineEnd = end;
+				const std::string line = this->buffer.substr(lineStart, lineEnd - lineStart);
+				lineStart = lineEnd + 2;
+
+				if (first)
+				{
+					this->current.startLine = line;
+					first = false;
+					continue;
+				}
+
+				const size_t colon = line.find(':');
+				if (colon == std::string::npos)
+					throw std::runtime_error("malformed HTTP header: " + line);
+				this->current.headers[toLower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+			}
+			this->buffer.erase(0, end + 4);
+
+			if (toLower(this->current.Header("transfer-encoding")).find("chunked") != std::string::npos)
+			{
+				this->state = State::ChunkSize;
+			}
+			else
+			{
+				const std::string length = this->current.Header("content-length");
+				this->remaining = length.empty() ? 0 : std::stoul(length);
+				this->state = State::Body;
+			}
+			break;
+		}
+
+		case State::Body:
+			if (this->buffer.size() < this->remaining)
+				return false;
+
+			this->current.body.append(this->buffer, 0, this->remaining);
+			this->buffer.erase(0, this->remaining);
+			this->state = State::Head;
+			message = std::move(this->current);
+			return true;
+
+		case State::ChunkSize:
+		{
+			const size_t end = this->buffer.find("\r\n");
+			if (end == std::string::npos)
+				return false;
+
+			this->remaining = std::stoul(this->buffer.substr(0, end), nullptr, 16);
+			this->buffer.erase(0, end + 2);
+			this->state = this->remaining == 0 ? State::ChunkTrailer : State::ChunkData;
+			break;
+		}
+
+		case State::ChunkData:
+			// Chunk data is followed by CRLF.
+			if (this->buffer.size() < this->remaining + 2)
+				return false;
+
+			this->current.body.append(this->buffer, 0, this->remaining);
+			this->buffer.erase(0, this->remaining + 2);
+			this->state = State::ChunkSize;
+			break;
+
+		case State::ChunkTrailer:
+		{
+			// No trailer fields are expected; wait for the final empty line.
+			const size_t end = this->buffer.find("\r\n");
+			if (end == std::string::npos)
+				return false;
+
+			this->buffer.erase(0, end + 2);
+			if (end != 0)
+				break;
+
+			this->state = State::Head;
+			message = std::move(this->current);
+			return true;
+		}
+		}
+	}
+}
+
+std::string serializeHttpMessage(const HttpMessage& message)
+{
+	std::string data = message.startLine + "\r\n";
+	for (const auto& header : message.headers)
+	{
+		if (header.first != "content-length")
+			data += header.first + ": " + header.second + "\r\n";
+	}
+	data += "content-length: " + std::to_string(message.body.size()) + "\r\n\r\n";
+	data += message.body;
+
+	return data;
+}
+
+static void initializeSockets()
+{
+#ifdef _WIN32
+	static std::once_flag once;
+	std::call_once(once, []() {
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+	});
+#endif
+}
+
+/* Requests are small and latency bound. */
+static void disableNagle(SocketHandle socket)
+{
+	int enable = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+}
+
+SocketHandle connectSocket(const std::string& host, uint16_t port)
+{
+	initializeSockets();
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		return kInvalidSocket;
+
+	SocketHandle result = kInvalidSocket;
+	for (addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+	{
+		SocketHandle socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (socket == kInvalidSocket)
+			continue;
+
+		if (connect(socket, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0)
+		{
+			disableNagle(socket);
+			result = socket;
+			break;
+		}
+
+		closeSocket(socket);
+	}
+	freeaddrinfo(addresses);
+
+	return result;
+}
+
+SocketHandle listenSocket(uint16_t port, uint16_t* boundPort)
+{
+	initializeSockets();
+
+	SocketHandle socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (socket == kInvalidSocket)
+		return kInvalidSocket;
+
+#ifndef _WIN32
+	// Lets a restarted server take its port back while old connections linger in TIME_WAIT.
+	int reuse = 1;
+	setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	socklen_t length = sizeof(address);
+	if (bind(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(socket, SOMAXCONN) != 0 ||
+		getsockname(socket, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+	{
+		closeSocket(socket);
+		return kInvalidSocket;
+	}
+
+	if (boundPort)
+		*boundPort = ntohs(address.sin_port);
+
+	return socket;
+}
+
+SocketHandle acceptSocket(SocketHandle listener)
+{
+	SocketHandle socket = accept(listener, nullptr, nullptr);
+	if (socket != kInvalidSocket)
+		disableNagle(socket);
+
+	return socket;
+}
+
+bool sendAll(SocketHandle socket, const std::string& data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+#ifdef _WIN32
+		const int result = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+#else
+		const ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#endif
+		if (result <= 0)
+			return false;
+		sent += static_cast<size_t>(result);
+	}
+
+	return true;
+}
+
+int receiveSome(SocketHandle socket, char* buffer, int size)
+{
+	return static_cast<int>(recv(socket, buffer, size, 0));
+}
+
+void shutdownSocket(SocketHandle socket)
+{
+#ifdef _WIN32
+	shutdown(socket, SD_BOTH);
+#else
+	shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+void closeSocket(SocketHandle socket)
+{
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
@@ -0,0 +1,78 @@
+#ifndef MSC_TEST_HTTP_HPP
+#define MSC_TEST_HTTP_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+/* Minimal HTTP/1.1 over plain TCP, enough for the signaling client and the
+ * local stand-in server: Content-Length and chunked bodies, keep-alive and
+ * pipelining, no TLS.
+ */
+struct HttpMessage
+{
+	// Request or status line, e.g. "POST /broadcasters HTTP/1.1" or
+	// "HTTP/1.1 200 OK".
+	std::string startLine;
+	// Lower case names.
+	std::map<std::string, std::string> headers;
+	std::string body;
+
+	std::string Header(const std::string& name) const;
+	// Status code of a response, 0 if the status line is malformed.
+	int Status() const;
+	// Method and target of a request.
+	std::string Method() const;
+	std::string Target() const;
+};
+
+/* Splits a byte stream into messages as the bytes arrive. */
+class HttpMessageParser
+{
+public:
+	void Feed(const char* data, size_t size);
+	// Moves the next complete message into message. Returns false if none is
+	// complete yet. Throws on malformed input.
+	bool Next(HttpMessage& message);
+
+private:
+	enum class State
+	{
+		Head,
+		Body,
+		ChunkSize,
+		ChunkData,
+		ChunkTrailer
+	};
+
+	std::string buffer;
+	State state = State::Head;
+	HttpMessage current;
+	size_t remaining = 0;
+};
+
+std::string serializeHttpMessage(const HttpMessage& message);
+
+// Connects to host:port. Returns kInvalidSocket on failure.
+SocketHandle connectSocket(const std::string& host, uint16_t port);
+// Listens on the loopback interface. port 0 picks a free port, written to
+// boundPort. Returns kInvalidSocket on failure.
+SocketHandle listenSocket(uint16_t port, uint16_t* boundPort);
+SocketHandle acceptSocket(SocketHandle listener);
+bool sendAll(SocketHandle socket, const std::string& data);
+// Returns the number of bytes read, 0 once closed, -1 on error.
+int receiveSome(SocketHandle socket, char* buffer, int size);
+// Wakes up a thread blocked in receiveSome() or acceptSocket().
+void shutdownSocket(SocketHandle socket);
+void closeSocket(SocketHandle socket);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+#define MSC_CLASS "LocalSignalingServer"
+
+#include <condition_variable>
+#include <deque>
+#include <random>
+// Before Http.hpp includes winsock2.h, for the Windows defines of webrtc.
+#include "LoopbackRouter.hpp"
+#include "LocalSignalingServer.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "DebugCpp.h"
+
+namespace
+{
+	bool endsWith(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// Segment following "/<name>/" in path, empty if none.
+	std::string pathParameter(const std::string& path, const std::string& name)
+	{
+		const std::string marker = "/" + name + "/";
+		const size_t position = path.find(marker);
+		if (position == std::string::npos)
+			return "";
+
+		const size_t begin = position + marker.size();
+
+		return path.substr(begin, path.find('/', begin) - begin);
+	}
+
+	std::string queryParameter(const std::string& target, const std::string& name)
+	{
+		const size_t query = target.find('?');
+		if (query == std::string::npos)
+			return "";
+
+		const std::string marker = name + "=";
+		size_t begin = query + 1;
+		while (begin < target.size())
+		{
+			size_t end = target.find('&', begin);
+			if (end == std::string::npos)
+				end = target.size();
+			if (target.compare(begin, marker.size(), marker) == 0)
+				return target.substr(begin + marker.size(), end - begin - marker.size());
+
+			begin = end + 1;
+		}
+
+		return "";
+	}
+
+	std::string randomString(size_t length, const char* alphabet, size_t alphabetSize)
+	{
+		static thread_local std::mt19937 generator{ std::random_device{}() };
+		std::uniform_int_distribution<size_t> pick(0, alphabetSize - 1);
+
+		std::string result;
+		for (size_t i = 0; i < length; ++i)
+			result += alphabet[pick(generator)];
+
+		return result;
+	}
+
+	std::string randomToken(size_t length)
+	{
+		static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+		return randomString(length, kAlphabet, sizeof(kAlphabet) - 1);
+	}
+
+	std::string randomFingerprint()
+	{
+		static const char kHex[] = "0123456789ABCDEF";
+
+		std::string result;
+		for (int i = 0; i < 32; ++i)
+		{
+			if (i > 0)
+				result += ':';
+			result += randomString(2, kHex, sizeof(kHex) - 1);
+		}
+
+		return result;
+	}
+
+	// Capabilities of a router with the default codecs of the mediasoup demo.
+	nlohmann::json makeRouterRtpCapabilities()
+	{
+		const nlohmann::json videoFeedback =
+			nlohmann::json::parse(R"([ { "type": "nack" }, { "type": "nack", "parameter": "pli" },
+				{ "type": "ccm", "parameter": "fir" }, { "type": "goog-remb" }, { "type": "transport-cc" } ])");
+
+		/* clang-format off */
+		nlohmann::json codecs =
+		{
+			{
+				{ "kind",                 "audio"                                      },
+				{ "mimeType",             "audio/opus"                                 },
+				{ "preferredPayloadType", 100                                          },
+				{ "clockRate",            48000                                        },
+				{ "channels",             2                                            },
+				{ "parameters",           nlohmann::json::object()                     },
+				{ "rtcpFeedback",         { { { "type", "transport-cc" } } }           }
+			},
+			{
+				{ "kind",                 "video"                                      },
+				{ "mimeType",             "video/VP8"                                  },
+				{ "preferredPayloadType", 101                                          },
+				{ "clockRate",            90000                                        },
+				{ "parameters",           nlohmann::json::object()                     },
+				{ "rtcpFeedback",         videoFeedback                                }
+			},
+			{
+				{ "kind",                 "video"                                      },
+				{ "mimeType",             "video/rtx"                                  },
+				{ "preferredPayloadType", 102                                          },
+				{ "clockRate",            90000                                        },
+				{ "parameters",           { { "apt", 101 } }                           },
+				{ "rtcpFeedback",         nlohmann::json::array()                      }
+			},
+			{
+				{ "kind",                 "video"                                      },
+				{ "mimeType",             "video/H264"                                 },
+				{ "preferredPayloadType", 103                                          },
+				{ "clockRate",            90000                                        },
+				{ "parameters",
+					{
+						{ "packetization-mode",      1        },
+						{ "level-asymmetry-allowed", 1        },
+						{ "profile-level-id",        "42e01f" }
+					}
+				},
+				{ "rtcpFeedback",         videoFeedback                                }
+			},
+			{
+				{ "kind",                 "video"                                      },
+				{ "mimeType",             "video/rtx"                                  },
+				{ "preferredPayloadType", 104                                          },
+				{ "clockRate",            90000                                        },
+				{ "parameters",           { { "apt", 103 } }                           },
+				{ "rtcpFeedback",         nlohmann::json::array()                      }
+			}
+		};
+		/* clang-format on */
+
+		nlohmann::json headerExtensions = nlohmann::json::array();
+		int id = 1;
+		for (const char* kind : { "audio", "video" })
+		{
+			for (const char* uri :
+			     { "urn:ietf:params:rtp-hdrext:sdes:mid",
+			       "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time",
+			       "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01" })
+			{
+				/* clang-format off */
+				headerExtensions.push_back(
+				{
+					{ "kind",             kind      },
+					{ "uri",              uri       },
+					{ "preferredId",      id++      },
+					{ "preferredEncrypt", false     },
+					{ "direction",        "sendrecv" }
+				});
+				/* clang-format on */
+			}
+		}
+
+		return { { "codecs", codecs }, { "headerExtensions", headerExtensions } };
+	}
+
+	nlohmann::json makeTransport(const nlohmann::json& request)
+	{
+		/* clang-format off */
+		nlohmann::json transport =
+		{
+			{ "id", randomToken(16) },
+			{ "iceParameters",
+				{
+					{ "usernameFragment", randomToken(16) },
+					{ "password",         randomToken(32) },
+					{ "iceLite",          true            }
+				}
+			},
+			{ "iceCandidates",
+				{
+					{
+						{ "foundation", "udpcandidate" },
+						{ "priority",   1076302079     },
+						{ "ip",         "127.0.0.1"    },
+						{ "port",       40000          },
+						{ "type",       "host"         },
+						{ "protocol",   "udp"          }
+					}
+				}
+			},
+			{ "dtlsParameters",
+				{
+					{ "role", "auto" },
+					{ "fingerprints",
+						{
+							{
+								{ "algorithm", "sha-256"           },
+								{ "value",     randomFingerprint() }
+							}
+						}
+					}
+				}
+			}
+		};
+		/* clang-format on */
+
+		if (request.contains("sctpCapabilities"))
+		{
+			/* clang-format off */
+			transport["sctpParameters"] =
+			{
+				{ "port",           5000   },
+				{ "OS",             1024   },
+				{ "MIS",            1024   },
+				{ "maxMessageSize", 262144 }
+			};
+			/* clang-format on */
+		}
+
+		return transport;
+	}
+}
+
+LocalSignalingServer::LocalSignalingServer(uint16_t port, std::chrono::milliseconds latency, bool loopback)
+	: latency(latency)
+{
+	if (loopback)
+		this->router.reset(new LoopbackRouter());
+
+	this->listener = listenSocket(port, &this->port);
+	if (this->listener == kInvalidSocket)
+	{
+		Debug::Log("[ERROR]local signaling server cannot listen on port " + std::to_string(port), Color::Red);
+		MSC_THROW_ERROR("local signaling server cannot listen");
+	}
+
+	Debug::Log("[INFO] local signaling server listening on " + this->BaseUrl());
+	this->acceptor = std::thread(&LocalSignalingServer::Accept, this);
+}
+
+LocalSignalingServer::~LocalSignalingServer()
+{
+	this->stopping = true;
+	shutdownSocket(this->listener);
+	closeSocket(this->listener);
+	this->acceptor.join();
+
+	{
+		std::lock_guard<std::mutex> lock(this->connectionsMutex);
+
+		for (SocketHandle socket : this->connections)
+			shutdownSocket(socket);
+	}
+
+	for (auto& thread : this->connectionThreads)
+		thread.join();
+}
+
+uint16_t LocalSignalingServer::Port() const
+{
+	return this->port;
+}
+
+std::string LocalSignalingServer::BaseUrl() const
+{
+	return "http://127.0.0.1:" + std::to_string(this->port) + "/rooms/local";
+}
+
+uint64_t LocalSignalingServer::RequestCount() const
+{
+	return this->requestCount;
+}
+
+LoopbackRouter* LocalSignalingServer::Router() const
+{
+	return this->router.get();
+}
+
+void LocalSignalingServer::Accept()
+{
+	while (!this->stopping)
+	{
+		SocketHandle socket = acceptSocket(this->listener);
+		if (socket == kInvalidSocket)
+			continue;
+
+		std::lock_guard<std::mutex> lock(this->connectionsMutex);
+
+		if (this->stopping)
+		{
+			closeSocket(socket);
+			return;
+		}
+
+		this->connections.push_back(socket);
+		this->connectionThreads.emplace_back(&LocalSignalingServer::Serve, this, socket);
+	}
+}
+
+void LocalSignalingServer::Serve(SocketHandle socket)
+{
+	using Clock = std::chrono::steady_clock;
+
+	/* Responses leave in request order once their latency elapsed, so that
+	 * pipelined requests overlap their round trips like on a real network.
+	 */
+	std::mutex outboxMutex;
+	std::condition_variable outboxChanged;
+	std::deque<std::pair<Clock::time_point, std::string>> outbox;
+	bool closing = false;
+
+	std::thread writer([&]() {
+		std::unique_lock<std::mutex> lock(outboxMutex);
+
+		while (true)
+		{
+			outboxChanged.wait(lock, [&]() { return closing || !outbox.empty(); });
+			if (outbox.empty())
+				return;
+
+			const auto due = outbox.front().first;
+			if (Clock::now() < due)
+			{
+				outboxChanged.wait_until(lock, due);
+				continue;
+			}
+
+			std::string data = std::move(outbox.front().second);
+			outbox.pop_front();
+
+			lock.unlock();
+			const bool sent = sendAll(socket, data);
+			lock.lock();
+
+			if (!sent)
+				return;
+		}
+	});
+
+	HttpMessageParser parser;
+	char buffer[16 * 1024];
+
+	try
+	{
+		int received;
+		while ((received = receiveSome(socket, buffer, sizeof(buffer))) > 0)
+		{
+			parser.Feed(buffer, static_cast<size_t>(received));
+
+			HttpMessage request;
+			while (parser.Next(request))
+			{
+				++this->requestCount;
+
+				HttpMessage response = this->Handle(request);
+				const std::string requestId = request.Header("x-request-id");
+				if (!requestId.empty())
+					response.headers["x-request-id"] = requestId;
+
+				std::lock_guard<std::mutex> lock(outboxMutex);
+				outbox.emplace_back(Clock::now() + this->latency, serializeHttpMessage(response));
+				outboxChanged.notify_all();
+			}
+		}
+	}
+	catch (std::exception& e)
+	{
+		Debug::Log("[ERROR]local signaling server dropping connection: " + std::string(e.what()), Color::Red);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(outboxMutex);
+		closing = true;
+		outboxChanged.notify_all();
+	}
+	writer.join();
+
+	std::lock_guard<std::mutex> lock(this->connectionsMutex);
+
+	for (auto it = this->connections.begin(); it != this->connections.end(); ++it)
+	{
+		if (*it == socket)
+		{
+			this->connections.erase(it);
+			break;
+		}
+	}
+	closeSocket(socket);
+}
+
+HttpMessage LocalSignalingServer::Handle(const HttpMessage& request)
+{
+	HttpMessage response;
+	response.startLine = "HTTP/1.1 200 OK";
+	response.headers["content-type"] = "application/json";
+
+	const std::string method = request.Method();
+	const std::string target = request.Target();
+	const std::string path = target.substr(0, target.find('?'));
+	const std::string broadcasterId = pathParameter(path, "broadcasters");
+	const std::string transportId = pathParameter(path, "transports");
+	const nlohmann::json body = request.body.empty()
+		? nlohmann::json::object()
+		: nlohmann::json::parse(request.body, nullptr, false);
+
+	LoopbackRouter* router = this->router.get();
+	nlohmann::json result;
+
+	// Invalid bodies, and unknown ids of the router, throw.
+	try
+	{
+		if (method == "GET" && path.find("/broadcasters") == std::string::npos)
+			result = makeRouterRtpCapabilities();
+		else if (method == "POST" && endsWith(path, "/broadcasters"))
+			result = { { "peers", nlohmann::json::array() } };
+		else if (method == "POST" && endsWith(path, "/transports"))
+			result = router ? router->CreateTransport(broadcasterId, body.contains("sctpCapabilities")) : makeTransport(body);
+		else if (method == "POST" && endsWith(path, "/connect"))
+		{
+			if (router)
+				router->ConnectTransport(transportId, body.at("dtlsParameters"));
+			result = nlohmann::json::object();
+		}
+		else if (method == "POST" && endsWith(path, "/restart-ice"))
+			result = router ? router->RestartIce(transportId) : makeTransport(body)["iceParameters"];
+		else if (method == "POST" && endsWith(path, "/producers"))
+		{
+			result = { { "id",
+				router ? router->Produce(transportId, body.at("kind").get<std::string>(), body.at("rtpParameters"))
+				       : randomToken(16) } };
+		}
+		else if (method == "POST" && endsWith(path, "/produce/data"))
+		{
+			result = { { "id",
+				router ? router->ProduceData(transportId, body.at("sctpStreamParameters")) : randomToken(16) } };
+		}
+		else if (method == "POST" && router && endsWith(path, "/consume"))
+		{
+			std::string producerId = queryParameter(target, "producerId");
+			if (producerId.empty())
+				producerId = body.at("producerId").get<std::string>();
+			result = router->Consume(transportId, producerId);
+		}
+		else if (method == "POST" && endsWith(path, "/consume/data"))
+		{
+			if (router)
+				result = router->ConsumeData(transportId, body.at("dataProducerId").get<std::string>());
+			else
+				result = { { "id", randomToken(16) }, { "streamId", static_cast<int>(this->nextId++ % 1024) } };
+		}
+		else if (method == "DELETE" && !broadcasterId.empty())
+		{
+			if (router)
+				router->CloseOwner(broadcasterId);
+			result = nlohmann::json::object();
+		}
+		else
+		{
+			response.startLine = "HTTP/1.1 404 Not Found";
+			result = { { "error", "no route for " + method + " " + target } };
+		}
+	}
+	catch (std::exception& e)
+	{
+		response.startLine = "HTTP/1.1 500 Internal Server Error";
+		result = { { "error", e.what() } };
+	}
+
+	response.body = result.dump();
+
+	return response;
+}
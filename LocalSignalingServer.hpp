@@ -0,0 +1,62 @@
+#ifndef MSC_TEST_LOCAL_SIGNALING_SERVER_HPP
+#define MSC_TEST_LOCAL_SIGNALING_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Http.hpp"
+#include "json.hpp"
+
+class LoopbackRouter;
+
+/* In-process stand-in for the broadcaster REST API of the mediasoup demo
+ * server, to exercise SignalingClient and the Broadcaster without a server.
+ * It answers with well formed but fake transport parameters, so media never
+ * flows, unless loopback is set: transports are then served by a
+ * LoopbackRouter, which connects them and forwards their media, and
+ * ".../consume?producerId=" creates consumers. GET on the room returns router
+ * capabilities with the default codecs of the demo. Keep-alive and pipelining are supported; responses are delayed by a
+ * fixed latency to emulate the network round trip.
+ */
+class LocalSignalingServer
+{
+public:
+	// port 0 picks a free port. Throws if it cannot listen.
+	explicit LocalSignalingServer(
+		uint16_t port = 0,
+		std::chrono::milliseconds latency = std::chrono::milliseconds(0),
+		bool loopback = false);
+	~LocalSignalingServer();
+
+	uint16_t Port() const;
+	// "http://127.0.0.1:<port>/rooms/local", to pass to Broadcaster::Start().
+	std::string BaseUrl() const;
+	uint64_t RequestCount() const;
+	// nullptr unless loopback.
+	LoopbackRouter* Router() const;
+
+private:
+	void Accept();
+	void Serve(SocketHandle socket);
+	HttpMessage Handle(const HttpMessage& request);
+
+	const std::chrono::milliseconds latency;
+	std::unique_ptr<LoopbackRouter> router;
+	SocketHandle listener = kInvalidSocket;
+	uint16_t port = 0;
+	std::atomic<bool> stopping{ false };
+	std::atomic<uint64_t> requestCount{ 0 };
+	std::atomic<uint64_t> nextId{ 1 };
+	std::thread acceptor;
+
+	std::mutex connectionsMutex;
+	std::vector<SocketHandle> connections;
+	std::vector<std::thread> connectionThreads;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,1104 @@
+#define MSC_CLASS "LoopbackRouter"
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include "LoopbackRouter.hpp"
+#include "CertificatePool.hpp"
+#include "DebugCpp.h"
+#include "MediaSoupClientErrors.hpp"
+#include "api/transport/stun.h"
+#include "media/sctp/sctp_transport_factory.h"
+#include "media/sctp/sctp_transport_internal.h"
+#include "p2p/base/packet_transport_internal.h"
+#include "pc/srtp_session.h"
+#include "rtc_base/async_udp_socket.h"
+#include "rtc_base/buffer.h"
+#include "rtc_base/byte_buffer.h"
+#include "rtc_base/helpers.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/ssl_fingerprint.h"
+#include "rtc_base/ssl_stream_adapter.h"
+#include "rtc_base/stream.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace
+{
+	const int kSctpPort = 5000;
+	const int kMaxSctpMessageSize = 262144;
+	// Room for the SRTP authentication tag.
+	const size_t kSrtpOverhead = 64;
+	const size_t kMaxDtlsPacketSize = 2048;
+	const size_t kMaxPendingDtlsPackets = 8;
+
+	// First byte demultiplexing of RFC 7983.
+	bool isStun(uint8_t first)
+	{
+		return first < 4;
+	}
+
+	bool isDtls(uint8_t first)
+	{
+		return first >= 20 && first < 64;
+	}
+
+	bool isRtpOrRtcp(uint8_t first)
+	{
+		return first >= 128 && first < 192;
+	}
+
+	// RTCP packet types 192-223 take the place of the RTP marker and payload type.
+	bool isRtcp(const uint8_t* data, size_t size)
+	{
+		return size >= 2 && data[1] >= 192 && data[1] <= 223;
+	}
+
+	uint32_t readUint32(const uint8_t* data)
+	{
+		return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+		       (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+	}
+
+	void writeUint32(uint8_t* data, uint32_t value)
+	{
+		data[0] = static_cast<uint8_t>(value >> 24);
+		data[1] = static_cast<uint8_t>(value >> 16);
+		data[2] = static_cast<uint8_t>(value >> 8);
+		data[3] = static_cast<uint8_t>(value);
+	}
+
+	/* What consumers of a producer receive: its codecs and header extensions,
+	 * but the MID and RID ones, which the router does not rewrite.
+	 */
+	nlohmann::json makeConsumerRtpParameters(const nlohmann::json& rtpParameters)
+	{
+		nlohmann::json headerExtensions = nlohmann::json::array();
+		for (const auto& extension : rtpParameters.value("headerExtensions", nlohmann::json::array()))
+		{
+			const std::string uri = extension.value("uri", "");
+			if (uri != "urn:ietf:params:rtp-hdrext:sdes:mid" && uri.find("rtp-stream-id") == std::string::npos)
+				headerExtensions.push_back(extension);
+		}
+
+		const nlohmann::json rtcp = rtpParameters.value("rtcp", nlohmann::json::object());
+
+		/* clang-format off */
+		return
+		{
+			{ "codecs",           rtpParameters.at("codecs")    },
+			{ "headerExtensions", headerExtensions               },
+			{ "encodings",        nlohmann::json::array()        },
+			{ "rtcp",
+				{
+					{ "cname",       rtcp.value("cname", "loopback") },
+					{ "reducedSize", true                            },
+					{ "mux",         true                            }
+				}
+			}
+		};
+		/* clang-format on */
+	}
+
+	/* Datagrams of the UDP socket seen as a stream by the DTLS adapter, like
+	 * cricket::StreamInterfaceChannel does over an ICE transport.
+	 */
+	class PacketStream : public rtc::StreamInterface
+	{
+	public:
+		explicit PacketStream(std::function<bool(const void*, size_t)> send)
+			: send(std::move(send))
+		{
+		}
+
+		void Deliver(const char* data, size_t size)
+		{
+			// Dropped ones are retransmitted by the peer.
+			if (this->packets.size() >= kMaxPendingDtlsPackets)
+				return;
+
+			this->packets.emplace_back(data, size);
+			SignalEvent(this, rtc::SE_READ, 0);
+		}
+
+		rtc::StreamState GetState() const override
+		{
+			return this->closed ? rtc::SS_CLOSED : rtc::SS_OPEN;
+		}
+
+		rtc::StreamResult Read(void* buffer, size_t length, size_t* read, int* error) override
+		{
+			if (this->closed)
+				return rtc::SR_EOS;
+			if (this->packets.empty())
+				return rtc::SR_BLOCK;
+
+			rtc::Buffer packet = std::move(this->packets.front());
+			this->packets.pop_front();
+
+			if (packet.size() > length)
+			{
+				if (error)
+					*error = EMSGSIZE;
+
+				return rtc::SR_ERROR;
+			}
+
+			std::memcpy(buffer, packet.data(), packet.size());
+			if (read)
+				*read = packet.size();
+
+			return rtc::SR_SUCCESS;
+		}
+
+		// Datagrams are lossy, a packet that cannot be sent is not an error.
+		rtc::StreamResult Write(const void* data, size_t length, size_t* written, int* /*error*/) override
+		{
+			if (this->closed)
+				return rtc::SR_EOS;
+
+			this->send(data, length);
+			if (written)
+				*written = length;
+
+			return rtc::SR_SUCCESS;
+		}
+
+		void Close() override
+		{
+			this->closed = true;
+			this->packets.clear();
+		}
+
+	private:
+		const std::function<bool(const void*, size_t)> send;
+		std::deque<rtc::Buffer> packets;
+		bool closed = false;
+	};
+
+	/* Application data of the DTLS session, as the packet transport of the
+	 * SCTP association, like cricket::DtlsTransport is for a peer connection.
+	 */
+	class SctpCarrier : public rtc::PacketTransportInternal
+	{
+	public:
+		SctpCarrier(const std::string& name, std::function<bool(const char*, size_t)> send)
+			: name(name), send(std::move(send))
+		{
+		}
+
+		void SetWritable(bool writable)
+		{
+			if (this->isWritable == writable)
+				return;
+
+			this->isWritable = writable;
+			SignalWritableState(this);
+		}
+
+		void Deliver(const char* data, size_t size)
+		{
+			const int64_t packetTimeUs = -1;
+
+			SignalReadPacket(this, data, size, packetTimeUs, 0);
+		}
+
+		const std::string& transport_name() const override
+		{
+			return this->name;
+		}
+
+		bool writable() const override
+		{
+			return this->isWritable;
+		}
+
+		bool receiving() const override
+		{
+			return this->isWritable;
+		}
+
+		int SendPacket(const char* data, size_t length, const rtc::PacketOptions& /*options*/, int /*flags*/) override
+		{
+			if (!this->isWritable || !this->send(data, length))
+			{
+				this->error = ENOTCONN;
+
+				return -1;
+			}
+
+			return static_cast<int>(length);
+		}
+
+		int SetOption(rtc::Socket::Option /*option*/, int /*value*/) override
+		{
+			return 0;
+		}
+
+		int GetError() override
+		{
+			return this->error;
+		}
+
+	private:
+		const std::string name;
+		const std::function<bool(const char*, size_t)> send;
+		bool isWritable = false;
+		int error = 0;
+	};
+}
+
+/* One WebRtcTransport: an ICE-lite UDP endpoint, its DTLS session, the SRTP
+ * sessions keyed by it and the SCTP association over it.
+ */
+class LoopbackRouter::Transport : public sigslot::has_slots<>
+{
+public:
+	Transport(LoopbackRouter* router, const std::string& owner)
+		: router(router), id(rtc::CreateRandomUuid()), owner(owner)
+	{
+	}
+
+	~Transport() override
+	{
+		// The association writes through the DTLS session.
+		this->sctp.reset();
+		this->carrier.reset();
+		this->dtls.reset();
+	}
+
+	bool Open(rtc::SocketFactory* socketFactory, bool enableSctp)
+	{
+		this->socket.reset(rtc::AsyncUDPSocket::Create(socketFactory, rtc::SocketAddress("127.0.0.1", 0)));
+		if (!this->socket)
+			return false;
+
+		this->socket->SignalReadPacket.connect(this, &Transport::OnPacket);
+		this->ResetIce();
+
+		this->pendingStream.reset(
+			new PacketStream([this](const void* data, size_t size) { return this->Send(data, size); }));
+		this->stream = this->pendingStream.get();
+
+		if (enableSctp)
+		{
+			this->carrier.reset(new SctpCarrier(this->id, [this](const char* data, size_t size) {
+				size_t written = 0;
+				int error = 0;
+
+				return this->dtls && this->dtls->Write(data, size, &written, &error) == rtc::SR_SUCCESS;
+			}));
+			this->sctp = this->router->sctpFactory->CreateSctpTransport(this->carrier.get());
+			this->sctp->SignalDataReceived.connect(this, &Transport::OnSctpData);
+			this->sctp->Start(kSctpPort, kSctpPort, kMaxSctpMessageSize);
+		}
+
+		return true;
+	}
+
+	void ResetIce()
+	{
+		this->usernameFragment = rtc::CreateRandomString(16);
+		this->password = rtc::CreateRandomString(32);
+	}
+
+	nlohmann::json IceParameters() const
+	{
+		/* clang-format off */
+		return
+		{
+			{ "usernameFragment", this->usernameFragment },
+			{ "password",         this->password         },
+			{ "iceLite",          true                   }
+		};
+		/* clang-format on */
+	}
+
+	nlohmann::json IceCandidates() const
+	{
+		/* clang-format off */
+		return
+		{
+			{
+				{ "foundation", "udpcandidate"                          },
+				{ "priority",   1076302079                              },
+				{ "ip",         "127.0.0.1"                             },
+				{ "port",       this->socket->GetLocalAddress().port()  },
+				{ "type",       "host"                                  },
+				{ "protocol",   "udp"                                   }
+			}
+		};
+		/* clang-format on */
+	}
+
+	bool Connect(
+		const std::string& algorithm,
+		const std::string& fingerprint,
+		bool remoteIsClient,
+		const rtc::scoped_refptr<rtc::RTCCertificate>& certificate,
+		std::string& error)
+	{
+		if (this->dtls)
+		{
+			error = "transport " + this->id + " already connected";
+
+			return false;
+		}
+
+		std::unique_ptr<rtc::SSLFingerprint> remoteFingerprint =
+			rtc::SSLFingerprint::CreateUniqueFromRfc4572(algorithm, fingerprint);
+		if (!remoteFingerprint)
+		{
+			error = "invalid DTLS fingerprint " + algorithm + " " + fingerprint;
+
+			return false;
+		}
+
+		this->role = remoteIsClient ? rtc::SSL_SERVER : rtc::SSL_CLIENT;
+		this->dtls = rtc::SSLStreamAdapter::Create(std::move(this->pendingStream));
+		this->dtls->SetIdentity(certificate->identity()->Clone());
+		this->dtls->SetMode(rtc::SSL_MODE_DTLS);
+		this->dtls->SetMaxProtocolVersion(rtc::SSL_PROTOCOL_DTLS_12);
+		this->dtls->SetServerRole(this->role);
+		this->dtls->SetDtlsSrtpCryptoSuites({ rtc::SRTP_AEAD_AES_128_GCM, rtc::SRTP_AES128_CM_SHA1_80 });
+		this->dtls->SignalEvent.connect(this, &Transport::OnDtlsEvent);
+
+		if (!this->dtls->SetPeerCertificateDigest(
+		      remoteFingerprint->algorithm, remoteFingerprint->digest.cdata(), remoteFingerprint->digest.size()))
+		{
+			error = "cannot set the remote DTLS fingerprint";
+
+			return false;
+		}
+
+		// As the server it waits for the ClientHello, which may be queued already.
+		if (this->dtls->StartSSL() != 0)
+		{
+			error = "cannot start DTLS";
+
+			return false;
+		}
+
+		return true;
+	}
+
+	bool SendRtp(const uint8_t* data, size_t size, uint32_t ssrc)
+	{
+		if (!this->connected)
+			return false;
+
+		rtc::Buffer packet(size + kSrtpOverhead);
+		std::memcpy(packet.data(), data, size);
+		writeUint32(packet.data() + 8, ssrc);
+
+		int length = 0;
+		if (!this->srtpSend.ProtectRtp(packet.data(), static_cast<int>(size), static_cast<int>(packet.size()), &length))
+			return false;
+
+		return this->Send(packet.data(), static_cast<size_t>(length));
+	}
+
+	bool SendRtcp(const uint8_t* data, size_t size)
+	{
+		if (!this->connected)
+			return false;
+
+		rtc::Buffer packet(size + kSrtpOverhead);
+		std::memcpy(packet.data(), data, size);
+
+		int length = 0;
+		if (!this->srtpSend.ProtectRtcp(packet.data(), static_cast<int>(size), static_cast<int>(packet.size()), &length))
+			return false;
+
+		return this->Send(packet.data(), static_cast<size_t>(length));
+	}
+
+	bool SendSctp(int streamId, webrtc::DataMessageType type, const rtc::CopyOnWriteBuffer& payload)
+	{
+		if (!this->sctp)
+			return false;
+
+		webrtc::SendDataParams params;
+		params.type = type;
+		params.ordered = true;
+
+		cricket::SendDataResult result;
+
+		return this->sctp->SendData(streamId, params, payload, &result);
+	}
+
+	void OpenStream(int streamId)
+	{
+		if (this->sctp)
+			this->sctp->OpenStream(streamId);
+	}
+
+	LoopbackRouter* const router;
+	const std::string id;
+	const std::string owner;
+	bool connected = false;
+
+	// Media of this transport, by SSRC and SCTP stream.
+	std::unordered_map<uint32_t, std::string> producerIds;
+	std::unordered_map<uint32_t, std::string> consumerIds;
+	std::unordered_map<int, std::string> dataProducerIds;
+	int nextStreamId = 0;
+
+private:
+	bool Send(const void* data, size_t size)
+	{
+		if (!this->hasRemote)
+			return false;
+
+		return this->socket->SendTo(data, size, this->remote, rtc::PacketOptions()) >= 0;
+	}
+
+	void OnPacket(
+		rtc::AsyncPacketSocket* /*socket*/,
+		const char* data,
+		size_t size,
+		const rtc::SocketAddress& from,
+		const int64_t& /*packetTimeUs*/)
+	{
+		if (size == 0)
+			return;
+
+		const uint8_t first = static_cast<uint8_t>(data[0]);
+
+		if (isStun(first))
+			this->OnStun(data, size, from);
+		else if (!this->hasRemote || from != this->remote)
+			return;
+		else if (isDtls(first))
+			this->stream->Deliver(data, size);
+		else if (isRtpOrRtcp(first))
+			this->OnSrtp(data, size);
+	}
+
+	// ICE-lite: checks are answered and never sent. The peer is where the
+	// nominated one came from, or the first one until then.
+	void OnStun(const char* data, size_t size, const rtc::SocketAddress& from)
+	{
+		cricket::StunMessage request;
+		rtc::ByteBufferReader reader(data, size);
+		if (!request.Read(&reader) || request.type() != cricket::STUN_BINDING_REQUEST)
+			return;
+
+		const cricket::StunByteStringAttribute* username = request.GetByteString(cricket::STUN_ATTR_USERNAME);
+		if (!username || username->GetString().compare(0, this->usernameFragment.size() + 1, this->usernameFragment + ":") != 0)
+			return;
+		if (!cricket::StunMessage::ValidateMessageIntegrity(data, size, this->password))
+			return;
+
+		if (!this->hasRemote || request.GetByteString(cricket::STUN_ATTR_USE_CANDIDATE))
+		{
+			this->remote = from;
+			this->hasRemote = true;
+		}
+
+		cricket::StunMessage response;
+		response.SetType(cricket::STUN_BINDING_RESPONSE);
+		response.SetTransactionID(request.transaction_id());
+		response.AddAttribute(
+			std::make_unique<cricket::StunXorAddressAttribute>(cricket::STUN_ATTR_XOR_MAPPED_ADDRESS, from));
+		response.AddMessageIntegrity(this->password);
+		response.AddFingerprint();
+
+		rtc::ByteBufferWriter writer;
+		response.Write(&writer);
+		this->socket->SendTo(writer.Data(), writer.Length(), from, rtc::PacketOptions());
+	}
+
+	void OnDtlsEvent(rtc::StreamInterface* /*stream*/, int events, int /*error*/)
+	{
+		if (events & rtc::SE_OPEN)
+			this->OnDtlsConnected();
+
+		if ((events & rtc::SE_READ) && this->connected && this->carrier)
+		{
+			char buffer[kMaxDtlsPacketSize];
+			size_t read = 0;
+			int error = 0;
+
+			while (this->dtls->Read(buffer, sizeof(buffer), &read, &error) == rtc::SR_SUCCESS)
+				this->carrier->Deliver(buffer, read);
+		}
+
+		if (events & rtc::SE_CLOSE)
+		{
+			Debug::Log("[INFO] loopback transport " + this->id + " DTLS closed");
+
+			if (this->connected)
+				--this->router->stats.connectedTransports;
+			this->connected = false;
+			if (this->carrier)
+				this->carrier->SetWritable(false);
+		}
+	}
+
+	// Keys as in RFC 5764 4.2: client key, server key, client salt, server salt.
+	void OnDtlsConnected()
+	{
+		int suite = 0;
+		int keyLength = 0;
+		int saltLength = 0;
+
+		if (!this->dtls->GetDtlsSrtpCryptoSuite(&suite) || !rtc::GetSrtpKeyAndSaltLengths(suite, &keyLength, &saltLength))
+		{
+			Debug::Log("[ERROR]loopback transport " + this->id + " negotiated no SRTP crypto suite", Color::Red);
+
+			return;
+		}
+
+		std::vector<uint8_t> material(2 * (keyLength + saltLength));
+		if (!this->dtls->ExportKeyingMaterial(
+		      "EXTRACTOR-dtls_srtp", nullptr, 0, false, material.data(), material.size()))
+		{
+			Debug::Log("[ERROR]loopback transport " + this->id + " cannot export SRTP keys", Color::Red);
+
+			return;
+		}
+
+		std::vector<uint8_t> clientKey(material.begin(), material.begin() + keyLength);
+		std::vector<uint8_t> serverKey(material.begin() + keyLength, material.begin() + 2 * keyLength);
+		clientKey.insert(
+			clientKey.end(), material.begin() + 2 * keyLength, material.begin() + 2 * keyLength + saltLength);
+		serverKey.insert(serverKey.end(), material.begin() + 2 * keyLength + saltLength, material.end());
+
+		const std::vector<uint8_t>& sendKey = this->role == rtc::SSL_SERVER ? serverKey : clientKey;
+		const std::vector<uint8_t>& recvKey = this->role == rtc::SSL_SERVER ? clientKey : serverKey;
+
+		if (!this->srtpSend.SetSend(suite, sendKey.data(), sendKey.size(), {}) ||
+		    !this->srtpRecv.SetRecv(suite, recvKey.data(), recvKey.size(), {}))
+		{
+			Debug::Log("[ERROR]loopback transport " + this->id + " cannot create SRTP sessions", Color::Red);
+
+			return;
+		}
+
+		this->connected = true;
+		++this->router->stats.connectedTransports;
+		if (this->carrier)
+			this->carrier->SetWritable(true);
+	}
+
+	void OnSrtp(const char* data, size_t size)
+	{
+		if (!this->connected)
+			return;
+
+		rtc::Buffer packet(data, size);
+		int length = 0;
+
+		if (isRtcp(packet.data(), packet.size()))
+		{
+			if (!this->srtpRecv.UnprotectRtcp(packet.data(), static_cast<int>(packet.size()), &length))
+			{
+				++this->router->stats.packetsDropped;
+
+				return;
+			}
+
+			this->OnRtcp(packet.data(), static_cast<size_t>(length));
+		}
+		else
+		{
+			if (!this->srtpRecv.UnprotectRtp(packet.data(), static_cast<int>(packet.size()), &length) || length < 12)
+			{
+				++this->router->stats.packetsDropped;
+
+				return;
+			}
+
+			this->router->OnRtp(this, readUint32(packet.data() + 8), packet.data(), static_cast<size_t>(length));
+		}
+	}
+
+	// Looks for key frame requests in a compound packet: PLI (RFC 4585) and FIR (RFC 5104).
+	void OnRtcp(const uint8_t* data, size_t size)
+	{
+		++this->router->stats.rtcpPacketsReceived;
+
+		size_t offset = 0;
+		while (offset + 4 <= size)
+		{
+			const uint8_t* packet = data + offset;
+			const size_t length = ((static_cast<size_t>(packet[2]) << 8 | packet[3]) + 1) * 4;
+			if (offset + length > size)
+				break;
+
+			const uint8_t format = packet[0] & 0x1f;
+			if (packet[1] == 206 && format == 1 && length >= 12)
+				this->router->OnKeyFrameRequest(this, readUint32(packet + 8));
+			else if (packet[1] == 206 && format == 4 && length >= 20)
+				this->router->OnKeyFrameRequest(this, readUint32(packet + 12));
+
+			offset += length;
+		}
+	}
+
+	void OnSctpData(const cricket::ReceiveDataParams& params, const rtc::CopyOnWriteBuffer& payload)
+	{
+		this->router->OnSctpMessage(this, params.sid, params.type, payload);
+	}
+
+	std::string usernameFragment;
+	std::string password;
+	std::unique_ptr<rtc::AsyncPacketSocket> socket;
+	rtc::SocketAddress remote;
+	bool hasRemote = false;
+
+	// Owned by pendingStream until connected, then by dtls.
+	PacketStream* stream = nullptr;
+	std::unique_ptr<PacketStream> pendingStream;
+	std::unique_ptr<rtc::SSLStreamAdapter> dtls;
+	rtc::SSLRole role = rtc::SSL_SERVER;
+	cricket::SrtpSession srtpSend;
+	cricket::SrtpSession srtpRecv;
+
+	std::unique_ptr<SctpCarrier> carrier;
+	std::unique_ptr<cricket::SctpTransportInternal> sctp;
+};
+
+LoopbackRouter::LoopbackRouter()
+	: thread(rtc::Thread::CreateWithSocketServer())
+{
+	this->thread->SetName("LoopbackRouter", nullptr);
+	this->thread->Start();
+	this->sctpFactory.reset(new cricket::SctpTransportFactory(this->thread.get()));
+
+	// One certificate for every transport, as a mediasoup worker does.
+	this->certificate = getCachedCertificate();
+	if (!this->certificate)
+		this->certificate = takeCertificate();
+	if (!this->certificate)
+		this->certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams(rtc::KT_ECDSA), absl::nullopt);
+	if (!this->certificate)
+		MSC_THROW_ERROR("cannot generate the loopback router certificate");
+}
+
+LoopbackRouter::~LoopbackRouter()
+{
+	// Sockets, DTLS and SCTP go away on the thread they run on.
+	this->thread->Invoke<void>(RTC_FROM_HERE, [this]() {
+		this->dataConsumers.clear();
+		this->dataProducers.clear();
+		this->consumers.clear();
+		this->producers.clear();
+		this->transports.clear();
+	});
+	this->thread->Stop();
+}
+
+nlohmann::json LoopbackRouter::CreateTransport(const std::string& owner, bool enableSctp)
+{
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		std::unique_ptr<Transport> transport(new Transport(this, owner));
+		if (!transport->Open(this->thread->socketserver(), enableSctp))
+		{
+			error = "cannot open a loopback UDP socket";
+
+			return nullptr;
+		}
+
+		const std::unique_ptr<rtc::SSLFingerprint> fingerprint =
+			rtc::SSLFingerprint::CreateFromCertificate(*this->certificate);
+
+		/* clang-format off */
+		nlohmann::json answer =
+		{
+			{ "id",            transport->id              },
+			{ "iceParameters", transport->IceParameters() },
+			{ "iceCandidates", transport->IceCandidates() },
+			{ "dtlsParameters",
+				{
+					{ "role", "auto" },
+					{ "fingerprints",
+						{
+							{
+								{ "algorithm", fingerprint->algorithm                 },
+								{ "value",     fingerprint->GetRfc4572Fingerprint()   }
+							}
+						}
+					}
+				}
+			}
+		};
+		/* clang-format on */
+
+		if (enableSctp)
+		{
+			/* clang-format off */
+			answer["sctpParameters"] =
+			{
+				{ "port",           kSctpPort           },
+				{ "OS",             1024                },
+				{ "MIS",            1024                },
+				{ "maxMessageSize", kMaxSctpMessageSize }
+			};
+			/* clang-format on */
+		}
+
+		this->transports[transport->id] = std::move(transport);
+		++this->stats.transports;
+
+		return answer;
+	});
+}
+
+void LoopbackRouter::ConnectTransport(const std::string& transportId, const nlohmann::json& dtlsParameters)
+{
+	// Parsed here, json throws.
+	const nlohmann::json& fingerprint = dtlsParameters.at("fingerprints").at(0);
+	const std::string algorithm = fingerprint.at("algorithm").get<std::string>();
+	const std::string value = fingerprint.at("value").get<std::string>();
+	// Against "auto" the client takes the client role.
+	const bool remoteIsClient = dtlsParameters.value("role", "client") != "server";
+
+	this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (transport)
+			transport->Connect(algorithm, value, remoteIsClient, this->certificate, error);
+
+		return nullptr;
+	});
+}
+
+nlohmann::json LoopbackRouter::RestartIce(const std::string& transportId)
+{
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (!transport)
+			return nullptr;
+
+		transport->ResetIce();
+
+		return transport->IceParameters();
+	});
+}
+
+std::string LoopbackRouter::Produce(
+	const std::string& transportId, const std::string& kind, const nlohmann::json& rtpParameters)
+{
+	const nlohmann::json& encodings = rtpParameters.at("encodings");
+	if (encodings.empty() || !encodings[0].contains("ssrc"))
+		MSC_THROW_TYPE_ERROR("rtpParameters without encoding SSRC");
+
+	Producer producer{
+		transportId, kind, makeConsumerRtpParameters(rtpParameters), encodings[0]["ssrc"].get<uint32_t>(), {}
+	};
+
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (!transport)
+			return nullptr;
+
+		const std::string id = rtc::CreateRandomUuid();
+		transport->producerIds[producer.ssrc] = id;
+		this->producers[id] = std::move(producer);
+		++this->stats.producers;
+
+		return id;
+	}).get<std::string>();
+}
+
+std::string LoopbackRouter::ProduceData(const std::string& transportId, const nlohmann::json& sctpStreamParameters)
+{
+	const int streamId = sctpStreamParameters.at("streamId").get<int>();
+
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (!transport)
+			return nullptr;
+
+		const std::string id = rtc::CreateRandomUuid();
+		transport->dataProducerIds[streamId] = id;
+		transport->OpenStream(streamId);
+		this->dataProducers[id] = DataProducer{ transportId, streamId, {} };
+		++this->stats.dataProducers;
+
+		return id;
+	}).get<std::string>();
+}
+
+nlohmann::json LoopbackRouter::Consume(const std::string& transportId, const std::string& producerId)
+{
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (!transport)
+			return nullptr;
+
+		auto producer = this->producers.find(producerId);
+		if (producer == this->producers.end())
+		{
+			error = "producer " + producerId + " not found";
+
+			return nullptr;
+		}
+
+		const std::string id = rtc::CreateRandomUuid();
+		const uint32_t ssrc = this->nextSsrc++;
+		transport->consumerIds[ssrc] = id;
+		producer->second.consumerIds.push_back(id);
+		this->consumers[id] = Consumer{ transportId, producerId, ssrc };
+		++this->stats.consumers;
+
+		this->RequestKeyFrame(producer->second);
+
+		nlohmann::json rtpParameters = producer->second.consumerRtpParameters;
+		rtpParameters["encodings"].push_back({ { "ssrc", ssrc } });
+
+		/* clang-format off */
+		return
+		{
+			{ "id",            id                     },
+			{ "producerId",    producerId             },
+			{ "kind",          producer->second.kind  },
+			{ "type",          "simple"               },
+			{ "rtpParameters", rtpParameters          }
+		};
+		/* clang-format on */
+	});
+}
+
+nlohmann::json LoopbackRouter::ConsumeData(const std::string& transportId, const std::string& dataProducerId)
+{
+	return this->Call([&](std::string& error) -> nlohmann::json {
+		Transport* transport = this->FindTransport(transportId, error);
+		if (!transport)
+			return nullptr;
+
+		auto dataProducer = this->dataProducers.find(dataProducerId);
+		if (dataProducer == this->dataProducers.end())
+		{
+			error = "data producer " + dataProducerId + " not found";
+
+			return nullptr;
+		}
+
+		const std::string id = rtc::CreateRandomUuid();
+		const int streamId = transport->nextStreamId++;
+		transport->OpenStream(streamId);
+		dataProducer->second.dataConsumerIds.push_back(id);
+		this->dataConsumers[id] = DataConsumer{ transportId, dataProducerId, streamId };
+		++this->stats.dataConsumers;
+
+		return { { "id", id }, { "dataProducerId", dataProducerId }, { "streamId", streamId } };
+	});
+}
+
+void LoopbackRouter::CloseOwner(const std::string& owner)
+{
+	this->Call([&](std::string& /*error*/) -> nlohmann::json {
+		std::vector<std::string> transportIds;
+		for (const auto& item : this->transports)
+		{
+			if (item.second->owner == owner)
+				transportIds.push_back(item.first);
+		}
+
+		for (const auto& transportId : transportIds)
+			this->CloseTransport(transportId);
+
+		return nullptr;
+	});
+}
+
+LoopbackRouter::Stats LoopbackRouter::GetStats()
+{
+	return this->thread->Invoke<Stats>(RTC_FROM_HERE, [this]() { return this->stats; });
+}
+
+nlohmann::json LoopbackRouter::Call(std::function<nlohmann::json(std::string& error)> fn)
+{
+	std::string error;
+	nlohmann::json result = this->thread->Invoke<nlohmann::json>(RTC_FROM_HERE, [&]() { return fn(error); });
+
+	if (!error.empty())
+		MSC_THROW_ERROR("%s", error.c_str());
+
+	return result;
+}
+
+LoopbackRouter::Transport* LoopbackRouter::FindTransport(const std::string& transportId, std::string& error)
+{
+	auto it = this->transports.find(transportId);
+	if (it == this->transports.end())
+	{
+		error = "transport " + transportId + " not found";
+
+		return nullptr;
+	}
+
+	return it->second.get();
+}
+
+// Closes the transport with what it produces and consumes, and the consumers
+// of its producers on other transports.
+void LoopbackRouter::CloseTransport(const std::string& transportId)
+{
+	auto removeId = [](std::vector<std::string>& ids, const std::string& id) {
+		for (auto it = ids.begin(); it != ids.end(); ++it)
+		{
+			if (*it == id)
+			{
+				ids.erase(it);
+				return;
+			}
+		}
+	};
+
+	for (auto it = this->consumers.begin(); it != this->consumers.end();)
+	{
+		auto producer = this->producers.find(it->second.producerId);
+		const bool hasProducer = producer != this->producers.end();
+		if (it->second.transportId != transportId && hasProducer && producer->second.transportId != transportId)
+		{
+			++it;
+			continue;
+		}
+
+		if (hasProducer)
+			removeId(producer->second.consumerIds, it->first);
+		auto transport = this->transports.find(it->second.transportId);
+		if (transport != this->transports.end())
+			transport->second->consumerIds.erase(it->second.ssrc);
+
+		it = this->consumers.erase(it);
+		--this->stats.consumers;
+	}
+
+	for (auto it = this->producers.begin(); it != this->producers.end();)
+	{
+		if (it->second.transportId != transportId)
+		{
+			++it;
+			continue;
+		}
+
+		it = this->producers.erase(it);
+		--this->stats.producers;
+	}
+
+	for (auto it = this->dataConsumers.begin(); it != this->dataConsumers.end();)
+	{
+		auto dataProducer = this->dataProducers.find(it->second.dataProducerId);
+		const bool hasDataProducer = dataProducer != this->dataProducers.end();
+		if (it->second.transportId != transportId && hasDataProducer && dataProducer->second.transportId != transportId)
+		{
+			++it;
+			continue;
+		}
+
+		if (hasDataProducer)
+			removeId(dataProducer->second.dataConsumerIds, it->first);
+
+		it = this->dataConsumers.erase(it);
+		--this->stats.dataConsumers;
+	}
+
+	for (auto it = this->dataProducers.begin(); it != this->dataProducers.end();)
+	{
+		if (it->second.transportId != transportId)
+		{
+			++it;
+			continue;
+		}
+
+		it = this->dataProducers.erase(it);
+		--this->stats.dataProducers;
+	}
+
+	auto transport = this->transports.find(transportId);
+	if (transport == this->transports.end())
+		return;
+
+	if (transport->second->connected)
+		--this->stats.connectedTransports;
+	this->transports.erase(transport);
+	--this->stats.transports;
+}
+
+void LoopbackRouter::OnRtp(Transport* transport, uint32_t ssrc, const uint8_t* data, size_t size)
+{
+	++this->stats.rtpPacketsReceived;
+	this->stats.rtpBytesReceived += size;
+
+	// Other encodings and RTX end here.
+	auto producerId = transport->producerIds.find(ssrc);
+	if (producerId == transport->producerIds.end())
+		return;
+
+	auto producer = this->producers.find(producerId->second);
+	if (producer == this->producers.end())
+		return;
+
+	for (const auto& consumerId : producer->second.consumerIds)
+	{
+		const Consumer& consumer = this->consumers.at(consumerId);
+		auto target = this->transports.find(consumer.transportId);
+
+		if (target != this->transports.end() && target->second->SendRtp(data, size, consumer.ssrc))
+			++this->stats.rtpPacketsForwarded;
+		else
+			++this->stats.packetsDropped;
+	}
+}
+
+void LoopbackRouter::OnKeyFrameRequest(Transport* transport, uint32_t ssrc)
+{
+	auto consumerId = transport->consumerIds.find(ssrc);
+	if (consumerId == transport->consumerIds.end())
+		return;
+
+	auto consumer = this->consumers.find(consumerId->second);
+	if (consumer == this->consumers.end())
+		return;
+
+	auto producer = this->producers.find(consumer->second.producerId);
+	if (producer != this->producers.end())
+		this->RequestKeyFrame(producer->second);
+}
+
+void LoopbackRouter::OnSctpMessage(
+	Transport* transport, int streamId, webrtc::DataMessageType type, const rtc::CopyOnWriteBuffer& payload)
+{
+	++this->stats.sctpMessagesReceived;
+
+	auto dataProducerId = transport->dataProducerIds.find(streamId);
+	if (dataProducerId == transport->dataProducerIds.end())
+		return;
+
+	auto dataProducer = this->dataProducers.find(dataProducerId->second);
+	if (dataProducer == this->dataProducers.end())
+		return;
+
+	for (const auto& dataConsumerId : dataProducer->second.dataConsumerIds)
+	{
+		const DataConsumer& dataConsumer = this->dataConsumers.at(dataConsumerId);
+		auto target = this->transports.find(dataConsumer.transportId);
+
+		if (target != this->transports.end() && target->second->SendSctp(dataConsumer.streamId, type, payload))
+			++this->stats.sctpMessagesForwarded;
+		else
+			++this->stats.packetsDropped;
+	}
+}
+
+// Picture loss indication (RFC 4585 6.3.1) to the producer.
+void LoopbackRouter::RequestKeyFrame(const Producer& producer)
+{
+	if (producer.kind != "video")
+		return;
+
+	auto transport = this->transports.find(producer.transportId);
+	if (transport == this->transports.end())
+		return;
+
+	uint8_t pli[12] = { 0x81, 206, 0, 2 };
+	writeUint32(pli + 4, 1);
+	writeUint32(pli + 8, producer.ssrc);
+
+	++this->stats.keyFrameRequests;
+	if (!transport->second->SendRtcp(pli, sizeof(pli)))
+		++this->stats.packetsDropped;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef MSC_TEST_LOOPBACK_ROUTER_HPP
+#define MSC_TEST_LOOPBACK_ROUTER_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "json.hpp"
+#include "api/scoped_refptr.h"
+#include "api/transport/data_channel_transport_interface.h"
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/rtc_certificate.h"
+#include "rtc_base/thread.h"
+
+namespace cricket
+{
+	class SctpTransportFactory;
+}
+
+/* Minimal in-process stand-in for a mediasoup router, behind the
+ * LocalSignalingServer. Every transport is an ICE-lite endpoint on a loopback
+ * UDP port which terminates DTLS, SRTP and SCTP like mediasoup does, so that
+ * SendTransport and RecvTransport connect for real. RTP of a producer is
+ * forwarded to its consumers, and SCTP messages of a data producer to its data
+ * consumers.
+ *
+ * It is meant for benchmarks, not as an SFU: one network thread serves every
+ * transport, only the first encoding of a producer is forwarded (no simulcast
+ * layer switching, no RTX), RTCP is terminated except for key frame requests,
+ * and no bandwidth estimation feedback is sent.
+ *
+ * Methods are called by the signaling server threads and run on the network
+ * thread. Unknown ids throw.
+ */
+class LoopbackRouter
+{
+public:
+	struct Stats
+	{
+		// Open ones.
+		uint64_t transports;
+		uint64_t connectedTransports;
+		uint64_t producers;
+		uint64_t consumers;
+		uint64_t dataProducers;
+		uint64_t dataConsumers;
+		// Since the start.
+		uint64_t rtpPacketsReceived;
+		uint64_t rtpBytesReceived;
+		uint64_t rtpPacketsForwarded;
+		uint64_t rtcpPacketsReceived;
+		uint64_t keyFrameRequests;
+		uint64_t sctpMessagesReceived;
+		uint64_t sctpMessagesForwarded;
+		// Packets that could not be decrypted, encrypted or sent.
+		uint64_t packetsDropped;
+	};
+
+	LoopbackRouter();
+	~LoopbackRouter();
+
+	// Answers like mediasoup createWebRtcTransport(): id, iceParameters,
+	// iceCandidates, dtlsParameters and sctpParameters if enableSctp.
+	// owner groups the transports closed by CloseOwner().
+	nlohmann::json CreateTransport(const std::string& owner, bool enableSctp);
+	void ConnectTransport(const std::string& transportId, const nlohmann::json& dtlsParameters);
+	// Returns the new iceParameters.
+	nlohmann::json RestartIce(const std::string& transportId);
+	// Returns the producer id.
+	std::string Produce(const std::string& transportId, const std::string& kind, const nlohmann::json& rtpParameters);
+	// Returns the data producer id.
+	std::string ProduceData(const std::string& transportId, const nlohmann::json& sctpStreamParameters);
+	// Returns id, producerId, kind and rtpParameters of the consumer, and asks
+	// the producer for a key frame.
+	nlohmann::json Consume(const std::string& transportId, const std::string& producerId);
+	// Returns id, dataProducerId and streamId of the data consumer.
+	nlohmann::json ConsumeData(const std::string& transportId, const std::string& dataProducerId);
+	// Closes the transports of owner, with their producers and consumers.
+	void CloseOwner(const std::string& owner);
+
+	Stats GetStats();
+
+private:
+	class Transport;
+
+	struct Producer
+	{
+		std::string transportId;
+		std::string kind;
+		// Given to its consumers, without encodings.
+		nlohmann::json consumerRtpParameters;
+		// Of the first encoding, the one forwarded.
+		uint32_t ssrc;
+		std::vector<std::string> consumerIds;
+	};
+
+	struct Consumer
+	{
+		std::string transportId;
+		std::string producerId;
+		uint32_t ssrc;
+	};
+
+	struct DataProducer
+	{
+		std::string transportId;
+		int streamId;
+		std::vector<std::string> dataConsumerIds;
+	};
+
+	struct DataConsumer
+	{
+		std::string transportId;
+		std::string dataProducerId;
+		int streamId;
+	};
+
+	// Runs fn on the network thread. A non empty error is thrown here.
+	nlohmann::json Call(std::function<nlohmann::json(std::string& error)> fn);
+	Transport* FindTransport(const std::string& transportId, std::string& error);
+	void CloseTransport(const std::string& transportId);
+
+	// From the transports, on the network thread.
+	void OnRtp(Transport* transport, uint32_t ssrc, const uint8_t* data, size_t size);
+	void OnKeyFrameRequest(Transport* transport, uint32_t ssrc);
+	void OnSctpMessage(
+		Transport* transport, int streamId, webrtc::DataMessageType type, const rtc::CopyOnWriteBuffer& payload);
+	void RequestKeyFrame(const Producer& producer);
+
+	std::unique_ptr<rtc::Thread> thread;
+	std::unique_ptr<cricket::SctpTransportFactory> sctpFactory;
+	rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+
+	// Network thread only.
+	std::unordered_map<std::string, std::unique_ptr<Transport>> transports;
+	std::unordered_map<std::string, Producer> producers;
+	std::unordered_map<std::string, Consumer> consumers;
+	std::unordered_map<std::string, DataProducer> dataProducers;
+	std::unordered_map<std::string, DataConsumer> dataConsumers;
+	uint32_t nextSsrc = 0x10000000;
+	Stats stats{};
+};
+
+#endif
\ No newline at end of file
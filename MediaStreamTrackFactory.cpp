@@ -1,79 +1,470 @@
 #define MSC_CLASS "MediaStreamTrackFactory"
 
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "MediaSoupClientErrors.hpp"
 #include "MediaStreamTrackFactory.hpp"
+#include "SimulatedTime.hpp"
+#include "ThreadPolicy.hpp"
+#include "Tracing.hpp"
 #include "pc/test/fake_audio_capture_module.h"
 #include "pc/test/fake_periodic_video_track_source.h"
 #include "pc/test/frame_generator_capturer_video_track_source.h"
+#include "rtc_base/socket_server.h"
+#include "rtc_base/time_utils.h"
 #include "system_wrappers/include/clock.h"
 #include "api/audio_codecs/builtin_audio_decoder_factory.h"
 #include "api/audio_codecs/builtin_audio_encoder_factory.h"
-#include "api/create_peerconnection_factory.h"
+#include "api/call/call_factory_interface.h"
+#include "api/peer_connection_interface.h"
+#include "api/rtc_event_log/rtc_event_log_factory.h"
+#include "api/task_queue/default_task_queue_factory.h"
+#include "api/transport/field_trial_based_config.h"
+#include "api/test/create_frame_generator.h"
 #include "api/video_codecs/builtin_video_decoder_factory.h"
 #include "api/video_codecs/builtin_video_encoder_factory.h"
+#include "media/engine/webrtc_media_engine.h"
+#include "modules/audio_processing/include/audio_processing.h"
+#include "test/frame_generator_capturer.h"
+#include "test/passthrough_audio_encoder_factory.h"
+#include "test/passthrough_encoder_factory.h"
 #include "DebugCpp.h"
 
 using namespace mediasoupclient;
 
-static rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
-
 /* MediaStreamTrack holds reference to the threads of the PeerConnectionFactory.
  * Use plain pointers in order to avoid threads being destructed before tracks.
  */
-static rtc::Thread* networkThread;
-static rtc::Thread* signalingThread;
-static rtc::Thread* workerThread;
+struct FactoryShard
+{
+	rtc::Thread* networkThread;
+	rtc::Thread* signalingThread;
+	rtc::Thread* workerThread;
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
+};
+
+/* Shards are never destroyed once created, see above. */
+static std::mutex shardsMutex;
+static std::vector<FactoryShard*> shards;
+static std::atomic<size_t> nextShard{ 0 };
+
+/* Set when the factories replay pre-encoded files. Owned by shard 0's factory. */
+static webrtc::test::PassthroughEncoderFactory* passthroughEncoderFactory;
+/* Runs the frame generator capturers, and the fake audio devices on simulated time. */
+static webrtc::TaskQueueFactory* taskQueueFactory;
+
+/* Set by initializeFactoriesAsync(), ready once the shards are created. */
+static std::shared_future<void> factoriesReady;
 
-static void createFactory()
+/* Startup timing in rtc::TimeMillis(), -1 until it happens. */
+static std::atomic<int64_t> prewarmStartMs{ -1 };
+static std::atomic<int64_t> prewarmEndMs{ -1 };
+static std::atomic<int64_t> joinStartMs{ -1 };
+static std::atomic<int64_t> factoryWaitMs{ -1 };
+static std::atomic<int64_t> firstFrameMs{ -1 };
+
+/* Records when the first video frame is captured. */
+class FirstFrameSink : public rtc::VideoSinkInterface<webrtc::VideoFrame>
 {
-	networkThread = rtc::Thread::Create().release();
-	signalingThread = rtc::Thread::Create().release();
-	workerThread = rtc::Thread::Create().release();
+public:
+	void OnFrame(const webrtc::VideoFrame& /*frame*/) override
+	{
+		int64_t none = -1;
+		if (firstFrameMs.compare_exchange_strong(none, rtc::TimeMillis()))
+			traceInstant("media", "FirstFrameCaptured");
+	}
+};
 
-	networkThread->SetName("network_thread", nullptr);
-	signalingThread->SetName("signaling_thread", nullptr);
-	workerThread->SetName("worker_thread", nullptr);
+static FirstFrameSink firstFrameSink;
 
-	if (!networkThread->Start() || !signalingThread->Start() || !workerThread->Start())
+static std::atomic<bool> firstFrameDecoded{ false };
+
+/* Traces when the first video frame of a consumer is decoded. */
+class FirstDecodedFrameSink : public rtc::VideoSinkInterface<webrtc::VideoFrame>
+{
+public:
+	void OnFrame(const webrtc::VideoFrame& /*frame*/) override
+	{
+		if (!firstFrameDecoded && !firstFrameDecoded.exchange(true))
+			traceInstant("media", "FirstFrameDecoded");
+	}
+};
+
+static FirstDecodedFrameSink firstDecodedFrameSink;
+
+/* Without socketServer the thread has no sockets, which only the network thread needs. */
+static rtc::Thread* createThread(
+	ThreadRole role, const std::string& name, size_t index, std::unique_ptr<rtc::SocketServer> socketServer = nullptr)
+{
+	const std::string threadName = name + "_" + std::to_string(index);
+	rtc::Thread* thread = socketServer ? new rtc::Thread(std::move(socketServer)) : rtc::Thread::Create().release();
+	thread->SetName(threadName, nullptr);
+
+	if (!thread->Start())
 	{
 		Debug::Log("[ERROR]thread start errored", Color::Red);
 		MSC_THROW_INVALID_STATE_ERROR("thread start errored");
 	}
 
-	webrtc::PeerConnectionInterface::RTCConfiguration config;
+	thread->Invoke<void>(RTC_FROM_HERE, [role, threadName]() { registerCurrentThread(role, threadName); });
+
+	return thread;
+}
 
-	auto fakeAudioCaptureModule = FakeAudioCaptureModule::Create();
+static FactoryShard* createShard(
+	size_t index,
+	const FactoryConfig& config,
+	rtc::scoped_refptr<webrtc::AudioEncoderFactory> audioEncoderFactory)
+{
+	auto* shard = new FactoryShard();
+	shard->networkThread = createThread(
+		ThreadRole::Network,
+		"network_thread",
+		index,
+		config.emulatedNetwork ? createEmulatedSocketServer() : rtc::SocketServer::CreateDefault());
+	shard->signalingThread = createThread(ThreadRole::Signaling, "signaling_thread", index);
+	shard->workerThread = createThread(ThreadRole::Worker, "worker_thread", index);
+
+	/* On simulated time the audio device runs on the pump, not a thread of its own. */
+	auto fakeAudioCaptureModule = isSimulatedTime() ? FakeAudioCaptureModule::Create(taskQueueFactory)
+	                                                : FakeAudioCaptureModule::Create();
 	if (!fakeAudioCaptureModule)
 	{
 		Debug::Log("[ERROR]audio capture module creation errored", Color::Red);
 		MSC_THROW_INVALID_STATE_ERROR("audio capture module creation errored");
 	}
 
-	factory = webrtc::CreatePeerConnectionFactory(
-		networkThread,
-		workerThread,
-		signalingThread,
-		fakeAudioCaptureModule,
-		webrtc::CreateBuiltinAudioEncoderFactory(),
-		webrtc::CreateBuiltinAudioDecoderFactory(),
-		webrtc::CreateBuiltinVideoEncoderFactory(),
-		webrtc::CreateBuiltinVideoDecoderFactory(),
-		nullptr /*audio_mixer*/,
-		nullptr /*audio_processing*/);
+	if (!isSimulatedTime())
+	{
+		const std::string audioThreadName = "audio_module_thread_" + std::to_string(index);
+		fakeAudioCaptureModule->SetProcessThreadStartedCallback(
+			[audioThreadName]() { registerCurrentThread(ThreadRole::AudioModule, audioThreadName); });
+	}
+
+	std::unique_ptr<webrtc::VideoEncoderFactory> videoEncoderFactory;
+
+	if (config.useEncodedFiles)
+	{
+		/* Clips are loaded once and shared by all shards. */
+		if (passthroughEncoderFactory)
+		{
+			videoEncoderFactory = passthroughEncoderFactory->Clone();
+		}
+		else
+		{
+			auto passthrough = std::make_unique<webrtc::test::PassthroughEncoderFactory>(
+				config.encodedFiles.videoFiles);
+			passthroughEncoderFactory = passthrough.get();
+			videoEncoderFactory = std::move(passthrough);
+		}
+	}
+	else
+	{
+		videoEncoderFactory = webrtc::CreateBuiltinVideoEncoderFactory();
+	}
+
+	/* What webrtc::CreatePeerConnectionFactory() does, but with the task queues
+	 * of the media engine on simulated time when enabled.
+	 */
+	webrtc::PeerConnectionFactoryDependencies dependencies;
+	dependencies.network_thread = shard->networkThread;
+	dependencies.worker_thread = shard->workerThread;
+	dependencies.signaling_thread = shard->signalingThread;
+	dependencies.task_queue_factory =
+		isSimulatedTime() ? createSimulatedTaskQueueFactory() : webrtc::CreateDefaultTaskQueueFactory();
+	dependencies.call_factory = webrtc::CreateCallFactory();
+	dependencies.event_log_factory =
+		std::make_unique<webrtc::RtcEventLogFactory>(dependencies.task_queue_factory.get());
+	dependencies.trials = std::make_unique<webrtc::FieldTrialBasedConfig>();
+
+	cricket::MediaEngineDependencies mediaDependencies;
+	mediaDependencies.task_queue_factory = dependencies.task_queue_factory.get();
+	mediaDependencies.adm = fakeAudioCaptureModule;
+	mediaDependencies.audio_encoder_factory = audioEncoderFactory;
+	mediaDependencies.audio_decoder_factory = webrtc::CreateBuiltinAudioDecoderFactory();
+	mediaDependencies.audio_processing = webrtc::AudioProcessingBuilder().Create();
+	mediaDependencies.video_encoder_factory = std::move(videoEncoderFactory);
+	mediaDependencies.video_decoder_factory = webrtc::CreateBuiltinVideoDecoderFactory();
+	mediaDependencies.trials = dependencies.trials.get();
+	dependencies.media_engine = cricket::CreateMediaEngine(std::move(mediaDependencies));
+
+	shard->factory = webrtc::CreateModularPeerConnectionFactory(std::move(dependencies));
 
-	if (!factory)
+	if (!shard->factory)
 	{
 		Debug::Log("[ERROR]error ocurred creating peerconnection factory", Color::Red);
 		MSC_THROW_ERROR("error ocurred creating peerconnection factory");
 	}
+
+	return shard;
+}
+
+/* Creates the shards of config, without publishing them. Only called before
+ * any shard is published, see initializeFactories() and ensureFactories().
+ */
+static std::vector<FactoryShard*> createFactories(const FactoryConfig& config)
+{
+	if (config.shardCount == 0)
+	{
+		Debug::Log("[ERROR]shardCount must be at least 1", Color::Red);
+		MSC_THROW_TYPE_ERROR("shardCount must be at least 1");
+	}
+
+	if (config.useEncodedFiles && config.encodedFiles.videoFiles.empty())
+	{
+		Debug::Log("[ERROR]no encoded video file given", Color::Red);
+		MSC_THROW_TYPE_ERROR("no encoded video file given");
+	}
+
+	rtc::scoped_refptr<webrtc::AudioEncoderFactory> audioEncoderFactory =
+		webrtc::CreateBuiltinAudioEncoderFactory();
+
+	if (config.useEncodedFiles)
+	{
+		Debug::Log("[INFO] replaying pre-encoded media instead of encoding");
+		if (!config.encodedFiles.opusFile.empty())
+		{
+			audioEncoderFactory = webrtc::test::CreatePassthroughAudioEncoderFactory(
+				config.encodedFiles.opusFile, audioEncoderFactory);
+		}
+	}
+
+	const bool enablesSimulatedTime = config.simulatedTime && !isSimulatedTime();
+	const NetworkConditions previousConditions = getNetworkConditions();
+
+	if (enablesSimulatedTime)
+		enableSimulatedTime(config.simulatedTimeSpeed);
+
+	if (config.emulatedNetwork)
+	{
+		Debug::Log("[INFO] opening the network thread sockets on an emulated network");
+		setNetworkConditions(config.networkConditions);
+	}
+
+	std::vector<FactoryShard*> created;
+	try
+	{
+		taskQueueFactory = isSimulatedTime()
+			? createSimulatedTaskQueueFactory().release()
+			: createThreadPolicyTaskQueueFactory(ThreadRole::FrameGenerator, webrtc::CreateDefaultTaskQueueFactory()).release();
+
+		Debug::Log("[INFO] creating " + std::to_string(config.shardCount) + " peerconnection factory shard(s)");
+		for (size_t i = 0; i < config.shardCount; ++i)
+			created.push_back(createShard(i, config, audioEncoderFactory));
+	}
+	catch (...)
+	{
+		/* Shards created so far are left alone, like all shards, but the
+		 * process settings go back to what they were before this config.
+		 */
+		passthroughEncoderFactory = nullptr;
+		taskQueueFactory = nullptr;
+		if (config.emulatedNetwork)
+			setNetworkConditions(previousConditions);
+		if (enablesSimulatedTime)
+			disableSimulatedTime();
+
+		throw;
+	}
+
+	return created;
+}
+
+/* Enumerating the capabilities loads the codecs of the media engine. */
+static void loadCodecs(FactoryShard* shard)
+{
+	shard->factory->GetRtpSenderCapabilities(cricket::MEDIA_TYPE_AUDIO);
+	shard->factory->GetRtpSenderCapabilities(cricket::MEDIA_TYPE_VIDEO);
+	shard->factory->GetRtpReceiverCapabilities(cricket::MEDIA_TYPE_AUDIO);
+	shard->factory->GetRtpReceiverCapabilities(cricket::MEDIA_TYPE_VIDEO);
+}
+
+/* Waits for initializeFactoriesAsync() if it runs, then creates the default
+ * shard if there is none yet. Rethrows the error of the warm-up if it
+ * failed. Must be called with shardsMutex not held.
+ */
+static void ensureFactories()
+{
+	std::shared_future<void> ready;
+	{
+		std::lock_guard<std::mutex> lock(shardsMutex);
+		ready = factoriesReady;
+	}
+
+	if (ready.valid())
+		ready.get();
+
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	if (shards.empty())
+		shards = createFactories(FactoryConfig());
+}
+
+static FactoryShard* getShard(int shard)
+{
+	/* The first factory request marks the start of the join. */
+	const int64_t startMs = rtc::TimeMillis();
+	int64_t none = -1;
+	const bool firstRequest = joinStartMs.compare_exchange_strong(none, startMs);
+
+	ensureFactories();
+
+	if (firstRequest)
+		factoryWaitMs = rtc::TimeMillis() - startMs;
+
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	if (shard == kAnyFactoryShard)
+		return shards[nextShard++ % shards.size()];
+
+	if (shard < 0 || static_cast<size_t>(shard) >= shards.size())
+	{
+		Debug::Log("[ERROR]invalid factory shard " + std::to_string(shard), Color::Red);
+		MSC_THROW_TYPE_ERROR("invalid factory shard");
+	}
+
+	return shards[shard];
+}
+
+static rtc::scoped_refptr<webrtc::VideoTrackInterface> watchFirstFrame(
+	rtc::scoped_refptr<webrtc::VideoTrackInterface> track)
+{
+	if (firstFrameMs == -1)
+		track->AddOrUpdateSink(&firstFrameSink, rtc::VideoSinkWants());
+
+	return track;
+}
+
+void watchFirstDecodedFrame(webrtc::MediaStreamTrackInterface* track)
+{
+	if (!isTracingEnabled() || firstFrameDecoded || !track || track->kind() != webrtc::MediaStreamTrackInterface::kVideoKind)
+		return;
+
+	static_cast<webrtc::VideoTrackInterface*>(track)->AddOrUpdateSink(&firstDecodedFrameSink, rtc::VideoSinkWants());
+}
+
+void initializeFactories(const FactoryConfig& config)
+{
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	if (!shards.empty() || factoriesReady.valid())
+	{
+		Debug::Log("[ERROR]peerconnection factories already created", Color::Red);
+		MSC_THROW_INVALID_STATE_ERROR("peerconnection factories already created");
+	}
+
+	shards = createFactories(config);
+}
+
+void initializeFactoriesAsync(const FactoryConfig& config, std::function<void()> then)
+{
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	if (!shards.empty() || factoriesReady.valid())
+	{
+		Debug::Log("[ERROR]peerconnection factories already created", Color::Red);
+		MSC_THROW_INVALID_STATE_ERROR("peerconnection factories already created");
+	}
+
+	auto ready = std::make_shared<std::promise<void>>();
+	factoriesReady = ready->get_future().share();
+	prewarmStartMs = rtc::TimeMillis();
+
+	std::thread([config, then, ready]() {
+		try
+		{
+			/* Built unlocked, so that getFactoryShardCount() and the like do
+			 * not block on the warm-up; calls needing a shard wait for ready.
+			 */
+			std::vector<FactoryShard*> created = createFactories(config);
+			for (FactoryShard* shard : created)
+				loadCodecs(shard);
+
+			{
+				std::lock_guard<std::mutex> lock(shardsMutex);
+
+				shards = std::move(created);
+			}
+
+			prewarmEndMs = rtc::TimeMillis();
+			Debug::Log(
+				"[INFO] factories warmed up in " + std::to_string(prewarmEndMs.load() - prewarmStartMs.load()) + " ms");
+		}
+		catch (std::exception& e)
+		{
+			/* Waiting callers get the error rather than shards of another config. */
+			Debug::Log("[ERROR]factory warm-up errored: " + std::string(e.what()), Color::Red);
+			ready->set_exception(std::current_exception());
+
+			if (then)
+				Debug::Log("[ERROR]skipping the rest of the warm-up since the factories failed", Color::Red);
+
+			return;
+		}
+
+		ready->set_value();
+
+		if (!then)
+			return;
+
+		try
+		{
+			then();
+		}
+		catch (std::exception& e)
+		{
+			Debug::Log("[ERROR]warm-up errored: " + std::string(e.what()), Color::Red);
+		}
+	}).detach();
+}
+
+StartupStats getStartupStats()
+{
+	/* Each loaded once, so that the checks and the differences agree. */
+	const int64_t prewarmStart = prewarmStartMs.load();
+	const int64_t prewarmEnd = prewarmEndMs.load();
+	const int64_t joinStart = joinStartMs.load();
+	const int64_t firstFrame = firstFrameMs.load();
+
+	StartupStats stats;
+	stats.prewarmed = prewarmEnd != -1 && joinStart != -1 && prewarmEnd <= joinStart;
+	stats.prewarmMs = prewarmEnd != -1 ? prewarmEnd - prewarmStart : -1;
+	stats.factoryWaitMs = factoryWaitMs.load();
+	stats.timeToFirstFrameMs = firstFrame != -1 && joinStart != -1 ? firstFrame - joinStart : -1;
+
+	return stats;
+}
+
+size_t getFactoryShardCount()
+{
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	return shards.size();
+}
+
+size_t assignFactoryShard()
+{
+	ensureFactories();
+
+	std::lock_guard<std::mutex> lock(shardsMutex);
+
+	return nextShard++ % shards.size();
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> getFactory(int shard)
+{
+	return getShard(shard)->factory;
 }
 
 // Audio track creation.
-rtc::scoped_refptr<webrtc::AudioTrackInterface> createAudioTrack(const std::string& label)
+rtc::scoped_refptr<webrtc::AudioTrackInterface> createAudioTrack(const std::string& label, int shard)
 {
-	if (!factory)
-		createFactory();
+	auto factory = getFactory(shard);
 
 	cricket::AudioOptions options;
 	options.highpass_filter = false;
@@ -84,27 +475,77 @@ rtc::scoped_refptr<webrtc::AudioTrackInterface> createAudioTrack(const std::stri
 }
 
 // Video track creation.
-rtc::scoped_refptr<webrtc::VideoTrackInterface> createVideoTrack(const std::string& /*label*/)
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createVideoTrack(const std::string& /*label*/, int shard)
 {
-	if (!factory)
-		createFactory();
+	auto factory = getFactory(shard);
 
 	auto* videoTrackSource =
 		new rtc::RefCountedObject<webrtc::FakePeriodicVideoTrackSource>(false /* remote */);
 
-	return factory->CreateVideoTrack(rtc::CreateRandomUuid(), videoTrackSource);
+	return watchFirstFrame(factory->CreateVideoTrack(rtc::CreateRandomUuid(), videoTrackSource));
 }
 
-rtc::scoped_refptr<webrtc::VideoTrackInterface> createSquaresVideoTrack(const std::string& /*label*/)
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createSquaresVideoTrack(const std::string& /*label*/, int shard)
 {
-	if (!factory)
-		createFactory();
+	auto factory = getFactory(shard);
 
 	Debug::Log("[INFO] getting frame generator");
+	/* Built here rather than by the track source so that the capturer runs on
+	 * a task queue following the thread policy.
+	 */
+	webrtc::FrameGeneratorCapturerVideoTrackSource::Config config;
+	auto capturer = std::make_unique<webrtc::test::FrameGeneratorCapturer>(
+		getMediaClock(),
+		webrtc::test::CreateSquareFrameGenerator(
+			config.width, config.height, absl::nullopt, config.num_squares_generated),
+		config.frames_per_second,
+		*taskQueueFactory);
+	capturer->Init();
+
 	auto* videoTrackSource = new rtc::RefCountedObject<webrtc::FrameGeneratorCapturerVideoTrackSource>(
-		webrtc::FrameGeneratorCapturerVideoTrackSource::Config(), webrtc::Clock::GetRealTimeClock(), false);
+		std::move(capturer), false /* is_screencast */);
 	videoTrackSource->Start();
 
 	Debug::Log( "[INFO] creating video track");
-	return factory->CreateVideoTrack(rtc::CreateRandomUuid(), videoTrackSource);
+	return watchFirstFrame(factory->CreateVideoTrack(rtc::CreateRandomUuid(), videoTrackSource));
+}
+
+void createEncodedFileFactory(const EncodedFileOptions& options)
+{
+	FactoryConfig config;
+	config.useEncodedFiles = true;
+	config.encodedFiles = options;
+
+	initializeFactories(config);
+}
+
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createEncodedFileVideoTrack(const std::string& /*label*/, int shard)
+{
+	auto factory = getFactory(shard);
+
+	if (!passthroughEncoderFactory)
+	{
+		Debug::Log("[ERROR]encoded file factory not created", Color::Red);
+		MSC_THROW_INVALID_STATE_ERROR("encoded file factory not created");
+	}
+
+	/* The encoder drops the frame content, so a single slide shown forever is
+	 * enough. It only has to match the top layer so that every simulcast layer
+	 * gets configured.
+	 */
+	auto capturer = std::make_unique<webrtc::test::FrameGeneratorCapturer>(
+		getMediaClock(),
+		webrtc::test::CreateSlideFrameGenerator(
+			passthroughEncoderFactory->width(),
+			passthroughEncoderFactory->height(),
+			std::numeric_limits<int>::max()),
+		passthroughEncoderFactory->framerate(),
+		*taskQueueFactory);
+	capturer->Init();
+
+	auto* videoTrackSource = new rtc::RefCountedObject<webrtc::FrameGeneratorCapturerVideoTrackSource>(
+		std::move(capturer), false /* is_screencast */);
+	videoTrackSource->Start();
+
+	return watchFirstFrame(factory->CreateVideoTrack(rtc::CreateRandomUuid(), videoTrackSource));
 }
@@ -1,14 +1,108 @@
 #ifndef MSC_TEST_MEDIA_STREAM_TRACK_FACTORY_HPP
 #define MSC_TEST_MEDIA_STREAM_TRACK_FACTORY_HPP
+#ifdef _WIN32
 #define WEBRTC_WIN
 #define NOMINMAX
+#endif
 
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
 #include "api/media_stream_interface.h"
+#include "api/peer_connection_interface.h"
+#include "NetworkEmulation.hpp"
 
-rtc::scoped_refptr<webrtc::AudioTrackInterface> createAudioTrack(const std::string& label);
+/* Pre-encoded media replayed instead of encoding the synthetic tracks. */
+struct EncodedFileOptions
+{
+	// VP8 or H.264 IVF clips, one per simulcast layer, lowest layer first.
+	// The last clip is reused for layers without their own clip.
+	std::vector<std::string> videoFiles;
+	// Opus packets, each preceded by its 16-bit little endian size.
+	// If empty the built-in Opus encoder is used.
+	std::string opusFile;
+};
 
-rtc::scoped_refptr<webrtc::VideoTrackInterface> createVideoTrack(const std::string& label);
+struct FactoryConfig
+{
+	// Number of PeerConnectionFactory shards. Every shard owns its own network,
+	// signaling and worker thread, so sessions spread over shards do not
+	// contend for the same threads.
+	size_t shardCount = 1;
+	// Replay encodedFiles instead of encoding (see createEncodedFileFactory()).
+	bool useEncodedFiles = false;
+	EncodedFileOptions encodedFiles;
+	// Run the media pipeline on virtual time (see enableSimulatedTime()),
+	// simulatedTimeSpeed times faster than real time, 0 for as fast as
+	// possible.
+	bool simulatedTime = false;
+	double simulatedTimeSpeed = 0;
+	// Open the sockets of the network threads through the impaired network
+	// of NetworkEmulation.hpp, starting with networkConditions. The
+	// conditions can be changed later with setNetworkConditions().
+	bool emulatedNetwork = false;
+	NetworkConditions networkConditions;
+};
 
-rtc::scoped_refptr<webrtc::VideoTrackInterface> createSquaresVideoTrack(const std::string& label);
+// Pass as shard to let the factory pick one round-robin.
+constexpr int kAnyFactoryShard = -1;
+
+// Creates the factory shards. Must be called before any track or factory is
+// requested; otherwise a single default shard is created on first use.
+void initializeFactories(const FactoryConfig& config);
+
+// Creates the factory shards and loads their codecs on a background thread,
+// then runs `then` there unless that failed. Calls needing a factory wait for
+// the shards instead of creating default ones, and throw the error of the
+// warm-up if it failed.
+void initializeFactoriesAsync(const FactoryConfig& config, std::function<void()> then = nullptr);
+
+struct StartupStats
+{
+	// Whether the warm-up finished before the first factory request, i.e. the
+	// first track or transport of the join.
+	bool prewarmed;
+	// Duration of the warm-up, -1 without warm-up or while it runs.
+	int64_t prewarmMs;
+	// Time the first factory request spent waiting for the warm-up, or
+	// creating the factories without warm-up.
+	int64_t factoryWaitMs;
+	// From the first factory request to the first captured video frame, -1
+	// until then.
+	int64_t timeToFirstFrameMs;
+};
+
+StartupStats getStartupStats();
+
+size_t getFactoryShardCount();
+
+// Returns the next shard in round-robin order. Tracks and the transport they
+// are produced on should use the same shard.
+size_t assignFactoryShard();
+
+// Returns the factory of the given shard, initializing the default shard if
+// needed. Transports must use it too for the tracks to be encoded by it.
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> getFactory(int shard = 0);
+
+// Creates a single shard with encoders replaying the given files. Must be
+// called before any track is created.
+void createEncodedFileFactory(const EncodedFileOptions& options);
+
+rtc::scoped_refptr<webrtc::AudioTrackInterface> createAudioTrack(const std::string& label, int shard = 0);
+
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createVideoTrack(const std::string& label, int shard = 0);
+
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createSquaresVideoTrack(const std::string& label, int shard = 0);
+
+// Video track whose frames are replaced by the clips given to
+// createEncodedFileFactory(). It runs at the resolution and frame rate of the
+// top layer clip and costs no encoding.
+rtc::scoped_refptr<webrtc::VideoTrackInterface> createEncodedFileVideoTrack(const std::string& label, int shard = 0);
+
+// While tracing (see Tracing.hpp), traces the first frame decoded by the given
+// consumer tracks, once per process like the first captured frame. Ignores
+// audio tracks.
+void watchFirstDecodedFrame(webrtc::MediaStreamTrackInterface* track);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,399 @@
+#define MSC_CLASS "NetworkEmulation"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "NetworkEmulation.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "rtc_base/async_socket.h"
+#include "rtc_base/buffer.h"
+#include "rtc_base/socket.h"
+#include "rtc_base/task_utils/pending_task_safety_flag.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+
+namespace
+{
+	const size_t kMaxUdpPacketSize = 65536;
+
+	std::mutex conditionsMutex;
+	NetworkConditions currentConditions;
+	// Bumped by every change, so that sockets copy the conditions only then.
+	std::atomic<uint64_t> conditionsGeneration{ 1 };
+	std::atomic<uint32_t> socketCount{ 0 };
+
+	struct AtomicLinkStats
+	{
+		std::atomic<uint64_t> packets{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> lost{ 0 };
+		std::atomic<uint64_t> queueDropped{ 0 };
+		std::atomic<uint64_t> reordered{ 0 };
+
+		LinkStats Get() const
+		{
+			return { this->packets, this->bytes, this->lost, this->queueDropped, this->reordered };
+		}
+	};
+
+	AtomicLinkStats upStats;
+	AtomicLinkStats downStats;
+
+	// One direction of one socket.
+	struct Link
+	{
+		// When the bandwidth is free again.
+		int64_t idleAtUs = 0;
+		// Delivery time of the last packet that was not reordered.
+		int64_t lastDueUs = 0;
+		bool inLossBurst = false;
+	};
+
+	// Gilbert-Elliott model where the bad state loses every packet: leaving it
+	// with probability r makes bursts 1 / r long, entering it with probability
+	// p = loss * r / (1 - loss) keeps the loss rate.
+	bool isLost(const LinkConditions& conditions, Link& link, std::mt19937& random)
+	{
+		const double loss = conditions.lossPercent / 100;
+		if (loss <= 0)
+			return false;
+		if (loss >= 1)
+			return true;
+
+		std::uniform_real_distribution<double> uniform(0, 1);
+
+		if (conditions.burstLength <= 1)
+			return uniform(random) < loss;
+
+		const double r = 1 / conditions.burstLength;
+		const double p = std::min(loss * r / (1 - loss), 1.0);
+
+		link.inLossBurst = link.inLossBurst ? uniform(random) >= r : uniform(random) < p;
+
+		return link.inLossBurst;
+	}
+
+	// Delivery time of a packet entering the link at nowUs, -1 if dropped.
+	int64_t schedulePacket(
+		const LinkConditions& conditions,
+		Link& link,
+		std::mt19937& random,
+		size_t size,
+		int64_t nowUs,
+		AtomicLinkStats& stats)
+	{
+		++stats.packets;
+		stats.bytes += size;
+
+		if (isLost(conditions, link, random))
+		{
+			++stats.lost;
+
+			return -1;
+		}
+
+		int64_t departUs = nowUs;
+		if (conditions.bandwidthKbps > 0)
+		{
+			const int64_t startUs = std::max(nowUs, link.idleAtUs);
+			if (startUs - nowUs > conditions.queueMs * 1000)
+			{
+				++stats.queueDropped;
+
+				return -1;
+			}
+
+			departUs = startUs + static_cast<int64_t>(size) * 8000 / conditions.bandwidthKbps;
+			link.idleAtUs = departUs;
+		}
+
+		std::uniform_real_distribution<double> percent(0, 100);
+
+		if (conditions.reorderPercent > 0 && percent(random) < conditions.reorderPercent)
+		{
+			++stats.reordered;
+
+			return departUs;
+		}
+
+		int64_t delayUs = conditions.delayMs * 1000;
+		if (conditions.jitterMs > 0)
+		{
+			std::uniform_int_distribution<int64_t> jitter(-conditions.jitterMs * 1000, conditions.jitterMs * 1000);
+			delayUs = std::max<int64_t>(delayUs + jitter(random), 0);
+		}
+
+		link.lastDueUs = std::max(departUs + delayUs, link.lastDueUs);
+
+		return link.lastDueUs;
+	}
+
+	LinkConditions parseLinkConditions(const nlohmann::json& json)
+	{
+		LinkConditions conditions;
+		conditions.delayMs = json.value("delayMs", conditions.delayMs);
+		conditions.jitterMs = json.value("jitterMs", conditions.jitterMs);
+		conditions.lossPercent = json.value("lossPercent", conditions.lossPercent);
+		conditions.burstLength = json.value("burstLength", conditions.burstLength);
+		conditions.reorderPercent = json.value("reorderPercent", conditions.reorderPercent);
+		conditions.bandwidthKbps = json.value("bandwidthKbps", conditions.bandwidthKbps);
+		conditions.queueMs = json.value("queueMs", conditions.queueMs);
+
+		if (conditions.delayMs < 0 || conditions.jitterMs < 0 || conditions.lossPercent < 0 ||
+		    conditions.reorderPercent < 0 || conditions.bandwidthKbps < 0 || conditions.queueMs < 0)
+		{
+			MSC_THROW_TYPE_ERROR("network conditions must not be negative");
+		}
+
+		return conditions;
+	}
+
+	/* UDP socket whose sent packets go through the up link and received ones
+	 * through the down link. Delayed packets wait in tasks of the network
+	 * thread, which the socket runs on.
+	 */
+	class EmulatedSocket : public rtc::AsyncSocketAdapter
+	{
+	public:
+		// Takes ownership of socket.
+		explicit EmulatedSocket(rtc::AsyncSocket* socket)
+			: rtc::AsyncSocketAdapter(socket), receiveBuffer(kMaxUdpPacketSize)
+		{
+			const uint32_t seed = this->Conditions().seed;
+			const uint32_t index = socketCount++;
+
+			this->random.seed(seed != 0 ? seed + index : std::random_device{}());
+		}
+
+		int Send(const void* data, size_t size) override
+		{
+			return this->SendThroughLink(data, size, [this](const void* packet, size_t packetSize) {
+				return this->AsyncSocketAdapter::Send(packet, packetSize);
+			});
+		}
+
+		int SendTo(const void* data, size_t size, const rtc::SocketAddress& address) override
+		{
+			return this->SendThroughLink(data, size, [this, address](const void* packet, size_t packetSize) {
+				return this->AsyncSocketAdapter::SendTo(packet, packetSize, address);
+			});
+		}
+
+		int Recv(void* buffer, size_t size, int64_t* timestamp) override
+		{
+			return this->RecvFrom(buffer, size, nullptr, timestamp);
+		}
+
+		int RecvFrom(void* buffer, size_t size, rtc::SocketAddress* address, int64_t* timestamp) override
+		{
+			if (this->received.empty())
+			{
+				this->SetError(EWOULDBLOCK);
+
+				return -1;
+			}
+
+			Packet packet = std::move(this->received.front());
+			this->received.pop_front();
+
+			// Truncated like a datagram read into a short buffer.
+			const size_t length = std::min(size, packet.data.size());
+			std::memcpy(buffer, packet.data.data(), length);
+			if (address)
+				*address = packet.address;
+			if (timestamp)
+				*timestamp = packet.timestampUs;
+
+			return static_cast<int>(length);
+		}
+
+	protected:
+		void OnReadEvent(rtc::AsyncSocket* /*socket*/) override
+		{
+			rtc::SocketAddress address;
+			int64_t timestampUs = -1;
+			int size;
+
+			while ((size = this->AsyncSocketAdapter::RecvFrom(
+			          this->receiveBuffer.data(), this->receiveBuffer.size(), &address, &timestampUs)) >= 0)
+			{
+				const int64_t nowUs = rtc::TimeMicros();
+				const int64_t dueUs = schedulePacket(
+					this->Conditions().down, this->downLink, this->random, static_cast<size_t>(size), nowUs, downStats);
+				if (dueUs < 0)
+					continue;
+
+				Packet packet{ rtc::Buffer(this->receiveBuffer.data(), static_cast<size_t>(size)), address, timestampUs };
+
+				if (dueUs <= nowUs)
+				{
+					this->Deliver(std::move(packet));
+				}
+				else
+				{
+					// Received when it is delivered.
+					packet.timestampUs = -1;
+					auto delayed = std::make_shared<Packet>(std::move(packet));
+					this->PostAt(dueUs, [this, delayed]() { this->Deliver(std::move(*delayed)); });
+				}
+			}
+		}
+
+	private:
+		struct Packet
+		{
+			rtc::Buffer data;
+			rtc::SocketAddress address;
+			int64_t timestampUs;
+		};
+
+		const NetworkConditions& Conditions()
+		{
+			const uint64_t generation = conditionsGeneration;
+			if (generation != this->generation)
+			{
+				std::lock_guard<std::mutex> lock(conditionsMutex);
+
+				this->conditions = currentConditions;
+				this->generation = generation;
+			}
+
+			return this->conditions;
+		}
+
+		// Lost and delayed packets count as sent for the caller.
+		int SendThroughLink(const void* data, size_t size, std::function<int(const void*, size_t)> send)
+		{
+			const int64_t nowUs = rtc::TimeMicros();
+			const int64_t dueUs = schedulePacket(this->Conditions().up, this->upLink, this->random, size, nowUs, upStats);
+
+			if (dueUs < 0)
+				return static_cast<int>(size);
+			if (dueUs <= nowUs)
+				return send(data, size);
+
+			auto packet = std::make_shared<rtc::Buffer>(static_cast<const uint8_t*>(data), size);
+			this->PostAt(dueUs, [send, packet]() { send(packet->data(), packet->size()); });
+
+			return static_cast<int>(size);
+		}
+
+		void Deliver(Packet packet)
+		{
+			this->received.push_back(std::move(packet));
+			SignalReadEvent(this);
+		}
+
+		// Rounded up to the next millisecond of the same clock as the thread
+		// timers, which keeps packets in the order of their due times.
+		void PostAt(int64_t dueUs, std::function<void()> task)
+		{
+			const int64_t delayMs = std::max<int64_t>((dueUs + 999) / 1000 - rtc::TimeMillis(), 0);
+
+			rtc::Thread::Current()->PostDelayedTask(
+				webrtc::ToQueuedTask(this->safety.flag(), std::move(task)), static_cast<uint32_t>(delayMs));
+		}
+
+		NetworkConditions conditions;
+		uint64_t generation = 0;
+		std::mt19937 random;
+		Link upLink;
+		Link downLink;
+		std::vector<uint8_t> receiveBuffer;
+		std::deque<Packet> received;
+		// Drops the pending tasks with the socket.
+		webrtc::ScopedTaskSafety safety;
+	};
+
+	/* Physical socket server handing out EmulatedSocket for UDP. */
+	class EmulatedSocketServer : public rtc::SocketServer
+	{
+	public:
+		EmulatedSocketServer()
+			: physical(rtc::SocketServer::CreateDefault())
+		{
+		}
+
+		rtc::Socket* CreateSocket(int family, int type) override
+		{
+			return this->physical->CreateSocket(family, type);
+		}
+
+		rtc::AsyncSocket* CreateAsyncSocket(int family, int type) override
+		{
+			rtc::AsyncSocket* socket = this->physical->CreateAsyncSocket(family, type);
+			if (!socket || type != SOCK_DGRAM)
+				return socket;
+
+			return new EmulatedSocket(socket);
+		}
+
+		void SetMessageQueue(rtc::Thread* queue) override
+		{
+			this->physical->SetMessageQueue(queue);
+		}
+
+		bool Wait(int cms, bool processIo) override
+		{
+			return this->physical->Wait(cms, processIo);
+		}
+
+		void WakeUp() override
+		{
+			this->physical->WakeUp();
+		}
+
+	private:
+		const std::unique_ptr<rtc::SocketServer> physical;
+	};
+}
+
+void setNetworkConditions(const NetworkConditions& conditions)
+{
+	std::lock_guard<std::mutex> lock(conditionsMutex);
+
+	currentConditions = conditions;
+	++conditionsGeneration;
+}
+
+NetworkConditions getNetworkConditions()
+{
+	std::lock_guard<std::mutex> lock(conditionsMutex);
+
+	return currentConditions;
+}
+
+NetworkEmulationStats getNetworkEmulationStats()
+{
+	return { upStats.Get(), downStats.Get() };
+}
+
+NetworkConditions parseNetworkConditions(const nlohmann::json& json)
+{
+	NetworkConditions conditions;
+
+	if (json.contains("up") || json.contains("down"))
+	{
+		conditions.up = parseLinkConditions(json.value("up", nlohmann::json::object()));
+		conditions.down = parseLinkConditions(json.value("down", nlohmann::json::object()));
+	}
+	else
+	{
+		conditions.up = parseLinkConditions(json);
+		conditions.down = conditions.up;
+	}
+	conditions.seed = json.value("seed", conditions.seed);
+
+	return conditions;
+}
+
+std::unique_ptr<rtc::SocketServer> createEmulatedSocketServer()
+{
+	return std::unique_ptr<rtc::SocketServer>(new EmulatedSocketServer());
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef MSC_TEST_NETWORK_EMULATION_HPP
+#define MSC_TEST_NETWORK_EMULATION_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#endif
+
+#include <cstdint>
+#include <memory>
+#include "json.hpp"
+#include "rtc_base/socket_server.h"
+
+/* Impaired network for the factory network threads: the UDP sockets they open
+ * delay, drop, reorder and pace packets, sent ones by the up link conditions
+ * and received ones by the down link conditions. Every socket, i.e. every
+ * local candidate of a transport, has links of its own.
+ *
+ * Conditions are process-wide and can change at any time; sockets pick the
+ * change up with their next packet.
+ */
+struct LinkConditions
+{
+	int64_t delayMs = 0;
+	// Delay varies uniformly within delayMs +- jitterMs. Jitter alone does not
+	// reorder packets.
+	int64_t jitterMs = 0;
+	double lossPercent = 0;
+	// Mean number of packets lost in a row. Above 1 losses come in bursts
+	// (Gilbert-Elliott model) for about the same loss rate.
+	double burstLength = 1;
+	// Packets sent right away instead of delayed, which overtake those in
+	// flight (as netem does).
+	double reorderPercent = 0;
+	// 0 for unlimited.
+	int64_t bandwidthKbps = 0;
+	// Packets waiting longer than this for the bandwidth are dropped.
+	int64_t queueMs = 500;
+};
+
+struct NetworkConditions
+{
+	LinkConditions up;
+	LinkConditions down;
+	// Seeds the random draws of every socket, for repeatable runs. 0 for a
+	// random seed.
+	uint32_t seed = 0;
+};
+
+struct LinkStats
+{
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t lost;
+	// Dropped for waiting longer than queueMs.
+	uint64_t queueDropped;
+	uint64_t reordered;
+};
+
+struct NetworkEmulationStats
+{
+	LinkStats up;
+	LinkStats down;
+};
+
+void setNetworkConditions(const NetworkConditions& conditions);
+
+NetworkConditions getNetworkConditions();
+
+// Since the start, over every emulated socket.
+NetworkEmulationStats getNetworkEmulationStats();
+
+// { "up": { "delayMs", "jitterMs", "lossPercent", "burstLength", "reorderPercent",
+// "bandwidthKbps", "queueMs" }, "down": { ... }, "seed": 0 }. Without "up" and
+// "down" the link fields at the top apply to both directions. Throws TypeError
+// on negative values.
+NetworkConditions parseNetworkConditions(const nlohmann::json& json);
+
+// Socket server of a network thread, whose UDP sockets follow the conditions.
+std::unique_ptr<rtc::SocketServer> createEmulatedSocketServer();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,245 @@
+#define MSC_CLASS "ReconnectionManager"
+
+#include <algorithm>
+#include <future>
+#include <vector>
+#include "ReconnectionManager.hpp"
+#include "Tracing.hpp"
+#include "DebugCpp.h"
+
+using namespace mediasoupclient;
+
+static bool isConnected(const std::string& state)
+{
+	return state == "connected" || state == "completed";
+}
+
+ReconnectionManager::ReconnectionManager(IceParametersProvider provider, GiveUpHandler giveUp, const Options& options)
+	: provider(std::move(provider)), giveUp(std::move(giveUp)), options(options)
+{
+}
+
+ReconnectionManager::~ReconnectionManager()
+{
+	std::set<TimerWheel::TimerId> timers;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+		timers = this->liveTimers;
+	}
+	// Also waits for a callback blocked on the mutex, which then sees stopping.
+	for (TimerWheel::TimerId timer : timers)
+		getTimerWheel().Cancel(timer);
+
+	if (this->restartThread.joinable())
+		this->restartThread.join();
+}
+
+void ReconnectionManager::AddTransport(Transport* transport)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->states.emplace(transport, TransportState());
+}
+
+void ReconnectionManager::RemoveTransport(Transport* transport)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->states.erase(transport);
+}
+
+void ReconnectionManager::OnConnectionStateChange(Transport* transport, const std::string& connectionState)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto it = this->states.find(transport);
+	if (it == this->states.end() || this->stopping)
+		return;
+
+	const bool wasConnected = isConnected(it->second.connectionState);
+	it->second.connectionState = connectionState;
+
+	if (isConnected(connectionState))
+	{
+		it->second.connectedOnce = true;
+
+		if (!this->recovering || !this->AllConnected())
+			return;
+
+		const double recoveryMs =
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->lostAt).count();
+
+		if (this->attempts == 0)
+			++this->stats.selfRecoveries;
+		++this->stats.recoveries;
+		this->stats.lastRecoveryMs = recoveryMs;
+		this->stats.maxRecoveryMs = std::max(this->stats.maxRecoveryMs, recoveryMs);
+		this->stats.meanRecoveryMs += (recoveryMs - this->stats.meanRecoveryMs) / this->stats.recoveries;
+
+		Debug::Log("[INFO] connectivity recovered in " + std::to_string(recoveryMs) + " ms");
+
+		this->recovering = false;
+		this->attempts = 0;
+		++this->generation;
+
+		return;
+	}
+
+	// Failing to connect in the first place is not a loss of connectivity.
+	if (!it->second.connectedOnce)
+		return;
+
+	const bool failed = connectionState == "failed";
+	if (!failed && !(connectionState == "disconnected" && wasConnected))
+		return;
+
+	if (!this->recovering)
+	{
+		Debug::Log("[WARN] transport " + transport->GetId() + " " + connectionState + ", recovering");
+
+		this->recovering = true;
+		this->lostAt = std::chrono::steady_clock::now();
+		this->attempts = 0;
+		++this->stats.disconnections;
+		this->Schedule(failed ? std::chrono::milliseconds(0) : this->options.gracePeriod);
+	}
+	else if (failed && this->attempts == 0)
+	{
+		// No point waiting for the rest of the grace period.
+		this->Schedule(std::chrono::milliseconds(0));
+	}
+}
+
+ReconnectionManager::Stats ReconnectionManager::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->stats;
+}
+
+// Must be called with mutex held.
+void ReconnectionManager::Schedule(std::chrono::milliseconds delay)
+{
+	const uint64_t generation = ++this->generation;
+	// Filled before the callback can take the mutex.
+	auto timer = std::make_shared<TimerWheel::TimerId>(0);
+
+	*timer = getTimerWheel().Schedule(delay, [this, generation, timer]() { this->OnTimer(generation, timer); });
+	this->liveTimers.insert(*timer);
+}
+
+void ReconnectionManager::OnTimer(uint64_t generation, const std::shared_ptr<TimerWheel::TimerId>& timer)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->liveTimers.erase(*timer);
+	if (this->stopping || generation != this->generation || !this->recovering)
+		return;
+	// The running restart schedules the next check itself.
+	if (this->restartRunning)
+		return;
+
+	// The previous restart thread is done, joining it does not block.
+	if (this->restartThread.joinable())
+		this->restartThread.join();
+
+	this->restartRunning = true;
+	this->restartThread = std::thread(&ReconnectionManager::Restart, this);
+}
+
+void ReconnectionManager::Restart()
+{
+	std::vector<Transport*> transports;
+	int attempt;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		for (const auto& state : this->states)
+		{
+			if (state.second.connectedOnce && !isConnected(state.second.connectionState))
+				transports.push_back(state.first);
+		}
+		attempt = ++this->attempts;
+	}
+
+	if (transports.empty())
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->restartRunning = false;
+
+		return;
+	}
+
+	/* Check after the last restart: transports still not connected. */
+	if (attempt > this->options.maxAttempts)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			this->restartRunning = false;
+			if (!this->recovering || this->stopping)
+				return;
+
+			Debug::Log("[ERROR]giving up reconnecting after " + std::to_string(attempt - 1) + " attempts", Color::Red);
+
+			++this->stats.failures;
+			this->recovering = false;
+			this->attempts = 0;
+		}
+
+		if (this->giveUp)
+			this->giveUp();
+
+		return;
+	}
+
+	Debug::Log("[INFO] restarting ICE on " + std::to_string(transports.size()) + " transports, attempt " + std::to_string(attempt));
+
+	std::vector<std::future<bool>> restarts;
+	for (Transport* transport : transports)
+	{
+		restarts.push_back(std::async(std::launch::async, [this, transport]() {
+			TraceScope trace("network", "RestartIce");
+			try
+			{
+				transport->RestartIce(this->provider(transport));
+
+				return true;
+			}
+			catch (std::exception& e)
+			{
+				Debug::Log("[ERROR]ICE restart of transport " + transport->GetId() + " failed: " + e.what(), Color::Red);
+
+				return false;
+			}
+		}));
+	}
+
+	size_t restarted = 0;
+	for (auto& restart : restarts)
+		restarted += restart.get() ? 1 : 0;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->stats.iceRestarts += restarted;
+	this->restartRunning = false;
+	if (!this->recovering || this->stopping)
+		return;
+
+	// Checked again unless all transports reconnect before, the last restart
+	// included: the check after it gives up.
+	this->Schedule(this->options.retryInterval);
+}
+
+// Must be called with mutex held. Transports that never connected do not count.
+bool ReconnectionManager::AllConnected() const
+{
+	for (const auto& state : this->states)
+	{
+		if (state.second.connectedOnce && !isConnected(state.second.connectionState))
+			return false;
+	}
+
+	return true;
+}
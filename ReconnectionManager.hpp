@@ -0,0 +1,108 @@
+#ifndef MSC_TEST_RECONNECTION_MANAGER_HPP
+#define MSC_TEST_RECONNECTION_MANAGER_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include "mediasoupclient.hpp"
+#include "json.hpp"
+#include "TimerWheel.hpp"
+
+/* Restarts ICE on transports that lost connectivity instead of closing them.
+ * Only transports that connected once are looked after: one that never did
+ * has nothing to recover. When a transport reports "disconnected", it is given a grace period to
+ * recover on its own; after that, or right away on "failed", every transport
+ * not connected gets new ICE parameters from the server and restarts ICE, all
+ * in parallel. Producers and consumers stay as they are, so media resumes
+ * without renegotiating them.
+ */
+class ReconnectionManager
+{
+public:
+	// Asks the server to restart ICE on its side of the transport and returns
+	// the new remote ICE parameters. Throws on failure.
+	using IceParametersProvider = std::function<nlohmann::json(mediasoupclient::Transport* transport)>;
+	// Called when the transports are still not connected retryInterval after
+	// the last attempt.
+	using GiveUpHandler = std::function<void()>;
+
+	struct Options
+	{
+		std::chrono::milliseconds gracePeriod{ 2000 };
+		// Between failed attempts, and before retrying transports that did not
+		// reconnect after a restart.
+		std::chrono::milliseconds retryInterval{ 3000 };
+		int maxAttempts = 5;
+	};
+
+	struct Stats
+	{
+		uint64_t disconnections;
+		// Recovered within the grace period, without restart.
+		uint64_t selfRecoveries;
+		uint64_t iceRestarts;
+		uint64_t recoveries;
+		uint64_t failures;
+		// From the first transport leaving "connected" to all being back.
+		double lastRecoveryMs;
+		double maxRecoveryMs;
+		double meanRecoveryMs;
+	};
+
+	ReconnectionManager(IceParametersProvider provider, GiveUpHandler giveUp, const Options& options);
+	~ReconnectionManager();
+
+	void AddTransport(mediasoupclient::Transport* transport);
+	void RemoveTransport(mediasoupclient::Transport* transport);
+
+	// To be called from Transport::Listener::OnConnectionStateChange.
+	void OnConnectionStateChange(mediasoupclient::Transport* transport, const std::string& connectionState);
+
+	Stats GetStats() const;
+
+private:
+	struct TransportState
+	{
+		std::string connectionState = "new";
+		bool connectedOnce = false;
+	};
+
+	void Schedule(std::chrono::milliseconds delay);
+	void OnTimer(uint64_t generation, const std::shared_ptr<TimerWheel::TimerId>& timer);
+	void Restart();
+	bool AllConnected() const;
+
+	const IceParametersProvider provider;
+	const GiveUpHandler giveUp;
+	const Options options;
+
+	mutable std::mutex mutex;
+	bool stopping = false;
+	std::map<mediasoupclient::Transport*, TransportState> states;
+	// Whether connectivity is being recovered, and since when.
+	bool recovering = false;
+	std::chrono::steady_clock::time_point lostAt;
+	int attempts = 0;
+	// Only the timer of the latest Schedule() acts; the others still fire.
+	uint64_t generation = 0;
+	std::set<TimerWheel::TimerId> liveTimers;
+	Stats stats = {};
+	// ICE restarts block on the peer connections, so they run on a thread of
+	// their own rather than on the thread reporting the state or on the timer
+	// wheel. No thread is left while connected.
+	bool restartRunning = false;
+	std::thread restartThread;
+};
+
+#endif
\ No newline at end of file
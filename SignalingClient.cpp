@@ -0,0 +1,234 @@
+#define MSC_CLASS "SignalingClient"
+
+#include <stdexcept>
+#include "MediaSoupClientErrors.hpp"
+#include "SignalingClient.hpp"
+#include "DebugCpp.h"
+
+SignalingClient::SignalingClient(const std::string& baseUrl)
+{
+	const std::string scheme = "http://";
+	if (baseUrl.compare(0, scheme.size(), scheme) != 0)
+	{
+		Debug::Log("[ERROR]signaling base URL must start with http:// " + baseUrl, Color::Red);
+		MSC_THROW_TYPE_ERROR("signaling base URL must start with http://");
+	}
+
+	std::string authority = baseUrl.substr(scheme.size());
+	const size_t slash = authority.find('/');
+	if (slash != std::string::npos)
+	{
+		this->pathPrefix = authority.substr(slash);
+		authority.erase(slash);
+		if (!this->pathPrefix.empty() && this->pathPrefix.back() == '/')
+			this->pathPrefix.pop_back();
+	}
+
+	const size_t colon = authority.rfind(':');
+	if (colon != std::string::npos)
+	{
+		this->port = static_cast<uint16_t>(std::stoi(authority.substr(colon + 1)));
+		authority.erase(colon);
+	}
+	this->host = authority;
+}
+
+SignalingClient::~SignalingClient()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->Fail("signaling client destroyed");
+	}
+
+	if (this->reader.joinable())
+		this->reader.join();
+	for (auto& reader : this->retiredReaders)
+		reader.join();
+}
+
+std::future<SignalingClient::Response> SignalingClient::Request(
+	const std::string& method, const std::string& path, const nlohmann::json& body)
+{
+	/* Held while writing, so that the wire order matches the queue. The write
+	 * itself is outside mutex, which the reader needs to deliver responses.
+	 */
+	std::lock_guard<std::mutex> sendLock(this->sendMutex);
+
+	SocketHandle socket;
+	uint64_t connection;
+	std::string data;
+	std::future<Response> future;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (this->socket == kInvalidSocket)
+			this->Connect();
+
+		PendingRequest request;
+		request.id = this->nextId++;
+		request.method = method;
+		request.path = path;
+
+		HttpMessage message;
+		message.startLine = method + " " + this->pathPrefix + path + " HTTP/1.1";
+		message.headers["host"] = this->host + ":" + std::to_string(this->port);
+		message.headers["x-request-id"] = std::to_string(request.id);
+		if (!body.is_null())
+		{
+			message.headers["content-type"] = "application/json";
+			message.body = body.dump();
+		}
+
+		future = request.promise.get_future();
+		request.sentAt = std::chrono::steady_clock::now();
+		this->pending.push_back(std::move(request));
+
+		data = serializeHttpMessage(message);
+		socket = this->socket;
+		connection = this->generation;
+	}
+
+	if (!sendAll(socket, data))
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		/* Unless the connection was dropped and failed its requests already. */
+		if (connection == this->generation)
+			this->Fail("signaling connection lost while sending");
+	}
+
+	return future;
+}
+
+std::vector<SignalingClient::RequestStats> SignalingClient::GetRequestStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return std::vector<RequestStats>(this->stats.begin(), this->stats.end());
+}
+
+/* Must be called with mutex held. */
+void SignalingClient::Connect()
+{
+	/* The reader of the previous connection may still be waking up, and needs
+	 * the lock to exit.
+	 */
+	if (this->reader.joinable())
+		this->retiredReaders.push_back(std::move(this->reader));
+
+	this->socket = connectSocket(this->host, this->port);
+	if (this->socket == kInvalidSocket)
+	{
+		Debug::Log("[ERROR]cannot connect to signaling server " + this->host + ":" + std::to_string(this->port), Color::Red);
+		MSC_THROW_ERROR("cannot connect to signaling server");
+	}
+
+	this->reader = std::thread(&SignalingClient::Read, this, this->socket, this->generation);
+}
+
+void SignalingClient::Read(SocketHandle socket, uint64_t connection)
+{
+	HttpMessageParser parser;
+	char buffer[16 * 1024];
+
+	while (true)
+	{
+		const int received = receiveSome(socket, buffer, sizeof(buffer));
+
+		if (!this->Deliver(parser, buffer, received, connection))
+			break;
+	}
+
+	/* The reader owns its socket; others only shut it down to wake it. Not
+	 * closed while a request is written to it, so that the handle cannot be
+	 * reused under the writer.
+	 */
+	std::lock_guard<std::mutex> sendLock(this->sendMutex);
+
+	closeSocket(socket);
+}
+
+bool SignalingClient::Deliver(HttpMessageParser& parser, const char* data, int received, uint64_t connection)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (connection != this->generation)
+		return false;
+
+	if (received <= 0)
+	{
+		this->Fail("signaling connection closed");
+		return false;
+	}
+
+	try
+	{
+		parser.Feed(data, static_cast<size_t>(received));
+
+		HttpMessage message;
+		while (parser.Next(message))
+		{
+			if (this->pending.empty())
+				throw std::runtime_error("unexpected response");
+
+			PendingRequest request = std::move(this->pending.front());
+			this->pending.pop_front();
+
+			const std::string echoedId = message.Header("x-request-id");
+			if (!echoedId.empty() && echoedId != std::to_string(request.id))
+				throw std::runtime_error("response for request " + echoedId + " while waiting for " + std::to_string(request.id));
+
+			Response response;
+			response.id = request.id;
+			response.status = message.Status();
+			response.rttMs = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - request.sentAt).count();
+			response.body = nlohmann::json::parse(message.body, nullptr, false);
+			if (response.body.is_discarded())
+				response.body = message.body;
+
+			this->Record(request, response.status, response.rttMs);
+			request.promise.set_value(std::move(response));
+
+			if (message.Header("connection") == "close")
+				throw std::runtime_error("signaling server closed the connection");
+		}
+	}
+	catch (std::exception& e)
+	{
+		this->Fail(e.what());
+		return false;
+	}
+
+	return true;
+}
+
+void SignalingClient::Fail(const std::string& reason)
+{
+	if (!this->pending.empty())
+		Debug::Log("[ERROR]" + reason + ", failing " + std::to_string(this->pending.size()) + " request(s)", Color::Red);
+
+	for (auto& request : this->pending)
+	{
+		this->Record(request, 0, std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - request.sentAt).count());
+		request.promise.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
+	}
+	this->pending.clear();
+
+	if (this->socket != kInvalidSocket)
+	{
+		shutdownSocket(this->socket);
+		this->socket = kInvalidSocket;
+		++this->generation;
+	}
+}
+
+void SignalingClient::Record(const PendingRequest& request, int status, double rttMs)
+{
+	this->stats.push_back({ request.id, request.method, request.path, status, rttMs });
+	if (this->stats.size() > kMaxRequestStats)
+		this->stats.pop_front();
+}
@@ -0,0 +1,92 @@
+#ifndef MSC_TEST_SIGNALING_CLIENT_HPP
+#define MSC_TEST_SIGNALING_CLIENT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Http.hpp"
+#include "json.hpp"
+
+/* Client for the broadcaster REST API of the mediasoup demo server. All
+ * requests share one keep-alive connection and are pipelined: a request is
+ * written as soon as it is made, without waiting for the responses to the
+ * earlier ones, which the server returns in order.
+ */
+class SignalingClient
+{
+public:
+	struct Response
+	{
+		uint64_t id;
+		int status;
+		// Parsed JSON body, or the raw body as a string if it is not JSON.
+		nlohmann::json body;
+		double rttMs;
+	};
+
+	struct RequestStats
+	{
+		uint64_t id;
+		std::string method;
+		std::string path;
+		// 0 if the connection failed before the response.
+		int status;
+		double rttMs;
+	};
+
+	static constexpr size_t kMaxRequestStats = 256;
+
+	// baseUrl : "http://host[:port][/prefix]". TLS is not supported.
+	explicit SignalingClient(const std::string& baseUrl);
+	~SignalingClient();
+
+	// Connects if needed and sends the request. The future throws if the
+	// connection breaks before the response arrives; the next request then
+	// reconnects.
+	std::future<Response> Request(
+		const std::string& method, const std::string& path, const nlohmann::json& body = nlohmann::json());
+
+	// Stats of the last kMaxRequestStats requests, oldest first.
+	std::vector<RequestStats> GetRequestStats() const;
+
+private:
+	struct PendingRequest
+	{
+		uint64_t id;
+		std::string method;
+		std::string path;
+		std::chrono::steady_clock::time_point sentAt;
+		std::promise<Response> promise;
+	};
+
+	void Connect();
+	void Read(SocketHandle socket, uint64_t connection);
+	// Returns false once the reader of connection has to stop.
+	bool Deliver(HttpMessageParser& parser, const char* data, int received, uint64_t connection);
+	// Must be called with mutex held.
+	void Fail(const std::string& reason);
+	void Record(const PendingRequest& request, int status, double rttMs);
+
+	std::string host;
+	uint16_t port = 80;
+	std::string pathPrefix;
+
+	// Serializes the writes of requests. Taken before mutex, never after.
+	std::mutex sendMutex;
+	mutable std::mutex mutex;
+	SocketHandle socket = kInvalidSocket;
+	// Incremented whenever socket is dropped, so that its reader knows.
+	uint64_t generation = 0;
+	std::thread reader;
+	std::vector<std::thread> retiredReaders;
+	uint64_t nextId = 1;
+	std::deque<PendingRequest> pending;
+	std::deque<RequestStats> stats;
+};
+
+#endif
\ No newline at end of file
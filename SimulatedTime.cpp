@@ -0,0 +1,323 @@
+#define MSC_CLASS "SimulatedTime"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MediaSoupClientErrors.hpp"
+#include "SimulatedTime.hpp"
+#include "ThreadPolicy.hpp"
+#include "api/task_queue/queued_task.h"
+#include "api/task_queue/task_queue_base.h"
+#include "rtc_base/time_utils.h"
+#include "DebugCpp.h"
+
+namespace
+{
+	// Virtual time the pump moves forward per round.
+	constexpr int64_t kPumpStepUs = 1000;
+
+	class SimulatedTaskQueue;
+
+	/* Pending tasks of every simulated queue, run in order of due time, then
+	 * of posting.
+	 */
+	class Scheduler
+	{
+	public:
+		explicit Scheduler(int64_t startUs) : clock(startUs)
+		{
+		}
+
+		void Post(SimulatedTaskQueue* queue, std::unique_ptr<webrtc::QueuedTask> task, int64_t delayMs);
+		// Waits for the running task of the queue, then drops its pending ones.
+		void Remove(SimulatedTaskQueue* queue);
+		// Runs the tasks due by targetUs, moving the clock to each, then sets
+		// the clock to targetUs.
+		void RunUntil(int64_t targetUs);
+
+		int64_t NowUs()
+		{
+			return this->clock.TimeInMicroseconds();
+		}
+
+		webrtc::SimulatedClock clock;
+		std::atomic<uint64_t> tasksRun{ 0 };
+		// Set by disableSimulatedTime(), ends the pump.
+		std::atomic<bool> stopped{ false };
+
+	private:
+		struct Pending
+		{
+			SimulatedTaskQueue* queue;
+			std::unique_ptr<webrtc::QueuedTask> task;
+		};
+
+		// One runner at a time; the clock only moves under it.
+		std::mutex runMutex;
+		std::mutex mutex;
+		std::condition_variable taskDone;
+		// Keyed by due time and posting order.
+		std::map<std::pair<int64_t, uint64_t>, Pending> tasks;
+		uint64_t nextSequence = 0;
+		SimulatedTaskQueue* running = nullptr;
+	};
+
+	class SimulatedTaskQueue : public webrtc::TaskQueueBase
+	{
+	public:
+		explicit SimulatedTaskQueue(Scheduler* scheduler) : scheduler(scheduler)
+		{
+		}
+
+		void Delete() override
+		{
+			this->scheduler->Remove(this);
+
+			delete this;
+		}
+
+		void PostTask(std::unique_ptr<webrtc::QueuedTask> task) override
+		{
+			this->scheduler->Post(this, std::move(task), 0);
+		}
+
+		void PostDelayedTask(std::unique_ptr<webrtc::QueuedTask> task, uint32_t milliseconds) override
+		{
+			this->scheduler->Post(this, std::move(task), milliseconds);
+		}
+
+		void Run(std::unique_ptr<webrtc::QueuedTask> task)
+		{
+			CurrentTaskQueueSetter setCurrent(this);
+
+			// A task returning false took care of its own deletion.
+			if (!task->Run())
+				task.release();
+		}
+
+	private:
+		Scheduler* const scheduler;
+	};
+
+	class SimulatedTaskQueueFactory : public webrtc::TaskQueueFactory
+	{
+	public:
+		explicit SimulatedTaskQueueFactory(Scheduler* scheduler) : scheduler(scheduler)
+		{
+		}
+
+		std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter> CreateTaskQueue(
+			absl::string_view /*name*/, Priority /*priority*/) const override
+		{
+			return std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter>(new SimulatedTaskQueue(this->scheduler));
+		}
+
+	private:
+		Scheduler* const scheduler;
+	};
+
+	/* Makes rtc::TimeMillis() and friends read the virtual clock. */
+	class RtcClock : public rtc::ClockInterface
+	{
+	public:
+		explicit RtcClock(Scheduler* scheduler) : scheduler(scheduler)
+		{
+		}
+
+		int64_t TimeNanos() const override
+		{
+			return this->scheduler->NowUs() * 1000;
+		}
+
+	private:
+		Scheduler* const scheduler;
+	};
+
+	void Scheduler::Post(SimulatedTaskQueue* queue, std::unique_ptr<webrtc::QueuedTask> task, int64_t delayMs)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		const int64_t dueUs = this->NowUs() + delayMs * 1000;
+		this->tasks.emplace(std::make_pair(dueUs, this->nextSequence++), Pending{ queue, std::move(task) });
+	}
+
+	void Scheduler::Remove(SimulatedTaskQueue* queue)
+	{
+		std::vector<std::unique_ptr<webrtc::QueuedTask>> dropped;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+
+			// Unless the queue deletes itself from its own task.
+			if (webrtc::TaskQueueBase::Current() != queue)
+				this->taskDone.wait(lock, [this, queue]() { return this->running != queue; });
+
+			for (auto it = this->tasks.begin(); it != this->tasks.end();)
+			{
+				if (it->second.queue == queue)
+				{
+					dropped.push_back(std::move(it->second.task));
+					it = this->tasks.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+		// Destroyed unlocked, their destructors may post tasks.
+	}
+
+	void Scheduler::RunUntil(int64_t targetUs)
+	{
+		std::lock_guard<std::mutex> runLock(this->runMutex);
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		for (auto it = this->tasks.begin(); it != this->tasks.end() && it->first.first <= targetUs;
+		     it = this->tasks.begin())
+		{
+			const int64_t dueUs = it->first.first;
+			Pending pending = std::move(it->second);
+			this->tasks.erase(it);
+
+			if (dueUs > this->NowUs())
+				this->clock.AdvanceTimeMicroseconds(dueUs - this->NowUs());
+
+			this->running = pending.queue;
+			lock.unlock();
+
+			pending.queue->Run(std::move(pending.task));
+
+			lock.lock();
+			this->running = nullptr;
+			++this->tasksRun;
+			this->taskDone.notify_all();
+		}
+
+		if (targetUs > this->NowUs())
+			this->clock.AdvanceTimeMicroseconds(targetUs - this->NowUs());
+	}
+
+	void pump(Scheduler* scheduler, double speed)
+	{
+		registerCurrentThread(ThreadRole::FrameGenerator, "simulated_time_pump");
+
+		const auto realStart = std::chrono::steady_clock::now();
+		const int64_t virtualStartUs = scheduler->NowUs();
+
+		while (!scheduler->stopped)
+		{
+			const int64_t targetUs = scheduler->NowUs() + kPumpStepUs;
+			if (speed > 0)
+			{
+				std::this_thread::sleep_until(
+					realStart + std::chrono::microseconds(static_cast<int64_t>((targetUs - virtualStartUs) / speed)));
+			}
+
+			const uint64_t tasksRun = scheduler->tasksRun;
+			scheduler->RunUntil(targetUs);
+
+			// Let the real threads catch up when there was nothing to do.
+			if (speed == 0 && scheduler->tasksRun == tasksRun)
+				std::this_thread::yield();
+		}
+	}
+} // namespace
+
+/* Never destroyed: task queues, the pump and the global rtc clock point to it. */
+static std::mutex simulatedTimeMutex;
+static std::atomic<Scheduler*> scheduler{ nullptr };
+static double pumpSpeed;
+static int64_t virtualStartUs;
+static std::chrono::steady_clock::time_point realStart;
+
+void enableSimulatedTime(double speed)
+{
+	std::lock_guard<std::mutex> lock(simulatedTimeMutex);
+
+	if (scheduler)
+	{
+		Debug::Log("[ERROR]simulated time already enabled", Color::Red);
+		MSC_THROW_INVALID_STATE_ERROR("simulated time already enabled");
+	}
+
+	// Starts from the real time, so that timestamps still look current.
+	auto* newScheduler = new Scheduler(rtc::TimeMicros());
+	virtualStartUs = newScheduler->NowUs();
+	realStart = std::chrono::steady_clock::now();
+	pumpSpeed = speed;
+
+	rtc::SetClockForTesting(new RtcClock(newScheduler));
+	scheduler = newScheduler;
+
+	Debug::Log("[INFO] simulated time enabled [speed:" + std::to_string(speed) + "]");
+
+	if (speed >= 0)
+		std::thread(pump, newScheduler, speed).detach();
+}
+
+void disableSimulatedTime()
+{
+	std::lock_guard<std::mutex> lock(simulatedTimeMutex);
+
+	Scheduler* current = scheduler;
+	if (!current)
+		return;
+
+	rtc::SetClockForTesting(nullptr);
+	scheduler = nullptr;
+	current->stopped = true;
+
+	Debug::Log("[INFO] simulated time disabled");
+}
+
+bool isSimulatedTime()
+{
+	return scheduler != nullptr;
+}
+
+void advanceSimulatedTime(int64_t ms)
+{
+	Scheduler* current = scheduler;
+	if (!current || pumpSpeed >= 0)
+		MSC_THROW_INVALID_STATE_ERROR("simulated time not in manual mode");
+
+	current->RunUntil(current->NowUs() + ms * 1000);
+}
+
+webrtc::Clock* getMediaClock()
+{
+	Scheduler* current = scheduler;
+
+	return current ? &current->clock : webrtc::Clock::GetRealTimeClock();
+}
+
+std::unique_ptr<webrtc::TaskQueueFactory> createSimulatedTaskQueueFactory()
+{
+	Scheduler* current = scheduler;
+	if (!current)
+		MSC_THROW_INVALID_STATE_ERROR("simulated time not enabled");
+
+	return std::unique_ptr<webrtc::TaskQueueFactory>(new SimulatedTaskQueueFactory(current));
+}
+
+SimulatedTimeStats getSimulatedTimeStats()
+{
+	SimulatedTimeStats stats = {};
+
+	Scheduler* current = scheduler;
+	if (!current)
+		return stats;
+
+	stats.enabled = true;
+	stats.virtualMs = (current->NowUs() - virtualStartUs) / 1000;
+	stats.realMs =
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - realStart).count();
+	stats.tasksRun = current->tasksRun;
+
+	return stats;
+}
@@ -0,0 +1,63 @@
+#ifndef MSC_TEST_SIMULATED_TIME_HPP
+#define MSC_TEST_SIMULATED_TIME_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#endif
+
+#include <cstdint>
+#include <memory>
+#include "api/task_queue/task_queue_factory.h"
+#include "system_wrappers/include/clock.h"
+
+/* Virtual time for the media pipeline, so that long runs finish faster than
+ * real time. Once enabled, rtc::TimeMillis() and the clock of the frame
+ * generators read a virtual clock, and the task queues of the factories
+ * (encoders, pacers, RTCP), of the frame generators and of the fake audio
+ * device run on one pump thread. The pump runs tasks in order of due time
+ * and moves the clock from one to the next instead of waiting, so the
+ * media side of a run does not depend on thread scheduling.
+ *
+ * The network, signaling and worker threads stay real: their timeouts count
+ * virtual time but socket I/O happens in real time, and so does signaling.
+ * Use a speed the peer can keep up with when a run involves a server.
+ *
+ * Tasks must not block waiting for other simulated task queues, which only
+ * run on the same pump thread.
+ */
+
+struct SimulatedTimeStats
+{
+	bool enabled;
+	// Time elapsed since enableSimulatedTime(), virtual and real.
+	int64_t virtualMs;
+	int64_t realMs;
+	uint64_t tasksRun;
+};
+
+// Switches the process to virtual time, for good. speed is virtual seconds
+// per real second, 0 to run as fast as the tasks allow, and negative to only
+// advance with advanceSimulatedTime(). Must be called before the factories
+// are created.
+void enableSimulatedTime(double speed);
+
+// Undoes enableSimulatedTime() when the factories it was enabled for failed
+// to be created: the pump stops and rtc::TimeMillis() reads the real clock
+// again. Task queues created in between keep the stopped virtual clock.
+void disableSimulatedTime();
+
+bool isSimulatedTime();
+
+// Runs the tasks due within ms of virtual time on the calling thread, then
+// sets the clock ms ahead. Only when enabled with a negative speed.
+void advanceSimulatedTime(int64_t ms);
+
+// The clock for frame generators: virtual if enabled, real otherwise.
+webrtc::Clock* getMediaClock();
+
+// Task queues on the pump. Throws unless enabled.
+std::unique_ptr<webrtc::TaskQueueFactory> createSimulatedTaskQueueFactory();
+
+SimulatedTimeStats getSimulatedTimeStats();
+
+#endif
\ No newline at end of file
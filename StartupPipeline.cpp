@@ -0,0 +1,186 @@
+#define MSC_CLASS "StartupPipeline"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "StartupPipeline.hpp"
+#include "Tracing.hpp"
+#include "DebugCpp.h"
+
+namespace
+{
+	enum class StepState
+	{
+		Pending,
+		Running,
+		Succeeded,
+		Failed
+	};
+}
+
+void StartupPipeline::AddStep(
+	const std::string& name,
+	const std::vector<std::string>& dependencies,
+	std::function<void()> run,
+	const std::string& resource)
+{
+	this->steps.push_back({ name, dependencies, std::move(run), resource });
+}
+
+bool StartupPipeline::Run()
+{
+	using Clock = std::chrono::steady_clock;
+
+	const size_t count = this->steps.size();
+	const auto origin = Clock::now();
+	auto elapsedUs = [origin]() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+	};
+
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::vector<StepState> states(count, StepState::Pending);
+	std::set<std::string> busyResources;
+	std::vector<std::thread> threads;
+	size_t running = 0;
+
+	this->timeline.assign(count, TimelineEntry());
+	for (size_t i = 0; i < count; ++i)
+	{
+		this->timeline[i].name = this->steps[i].name;
+		this->timeline[i].startUs = -1;
+		this->timeline[i].endUs = -1;
+		this->timeline[i].succeeded = false;
+	}
+
+	auto indexOf = [this](const std::string& name) {
+		for (size_t i = 0; i < this->steps.size(); ++i)
+		{
+			if (this->steps[i].name == name)
+				return i;
+		}
+
+		return this->steps.size();
+	};
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		bool progressed = false;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (states[i] != StepState::Pending)
+				continue;
+
+			const Step& step = this->steps[i];
+			bool ready = true;
+			std::string blocker;
+
+			for (const auto& dependency : step.dependencies)
+			{
+				const size_t index = indexOf(dependency);
+				if (index == count)
+				{
+					blocker = "unknown dependency " + dependency;
+					break;
+				}
+				if (states[index] == StepState::Failed)
+				{
+					blocker = "dependency " + dependency + " failed";
+					break;
+				}
+				if (states[index] != StepState::Succeeded)
+					ready = false;
+			}
+
+			if (!blocker.empty())
+			{
+				states[i] = StepState::Failed;
+				this->timeline[i].error = blocker;
+				progressed = true;
+				continue;
+			}
+
+			if (!ready || (!step.resource.empty() && busyResources.count(step.resource) != 0))
+				continue;
+
+			states[i] = StepState::Running;
+			if (!step.resource.empty())
+				busyResources.insert(step.resource);
+			++running;
+			progressed = true;
+
+			this->timeline[i].startUs = elapsedUs();
+			threads.emplace_back([&, i]() {
+				setTraceThreadName("startup " + this->steps[i].name);
+
+				std::string error;
+				try
+				{
+					TraceScope trace("startup", this->steps[i].name);
+					this->steps[i].run();
+				}
+				catch (std::exception& e)
+				{
+					error = e.what();
+				}
+				catch (...)
+				{
+					error = "unknown error";
+				}
+
+				std::lock_guard<std::mutex> stepLock(mutex);
+
+				TimelineEntry& entry = this->timeline[i];
+				entry.endUs = elapsedUs();
+				entry.succeeded = error.empty();
+				entry.error = error;
+				states[i] = error.empty() ? StepState::Succeeded : StepState::Failed;
+				if (!this->steps[i].resource.empty())
+					busyResources.erase(this->steps[i].resource);
+				--running;
+				finished.notify_all();
+			});
+		}
+
+		// Failures and launches may unblock other steps; look again first.
+		if (progressed)
+			continue;
+
+		if (running == 0)
+			break;
+
+		finished.wait(lock);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (states[i] == StepState::Pending)
+			this->timeline[i].error = "dependency cycle";
+	}
+
+	lock.unlock();
+	for (auto& thread : threads)
+		thread.join();
+
+	bool succeeded = true;
+	for (const auto& entry : this->timeline)
+	{
+		if (entry.succeeded)
+			continue;
+
+		succeeded = false;
+		Debug::Log("[ERROR]startup step " + entry.name + " failed: " + entry.error, Color::Red);
+	}
+
+	return succeeded;
+}
+
+std::vector<StartupPipeline::TimelineEntry> StartupPipeline::GetTimeline() const
+{
+	return this->timeline;
+}
@@ -0,0 +1,56 @@
+#ifndef MSC_TEST_STARTUP_PIPELINE_HPP
+#define MSC_TEST_STARTUP_PIPELINE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Runs named steps as soon as the steps they depend on succeeded, so that
+ * independent steps run concurrently, and records when each ran.
+ */
+class StartupPipeline
+{
+public:
+	struct TimelineEntry
+	{
+		std::string name;
+		// Microseconds since Run() was called, -1 if the step never ran.
+		int64_t startUs;
+		int64_t endUs;
+		bool succeeded;
+		// Why the step failed or was skipped.
+		std::string error;
+	};
+
+	// Steps sharing a resource never run at the same time, e.g. two producers
+	// negotiating on the same transport. Dependencies may be added later but
+	// must exist when Run() is called.
+	void AddStep(
+		const std::string& name,
+		const std::vector<std::string>& dependencies,
+		std::function<void()> run,
+		const std::string& resource = "");
+
+	// Runs every step, each on its own thread, and returns once all finished.
+	// A step throwing fails, and the steps depending on it are skipped.
+	// Returns whether all steps succeeded.
+	bool Run();
+
+	// Entries in the order the steps were added.
+	std::vector<TimelineEntry> GetTimeline() const;
+
+private:
+	struct Step
+	{
+		std::string name;
+		std::vector<std::string> dependencies;
+		std::function<void()> run;
+		std::string resource;
+	};
+
+	std::vector<Step> steps;
+	std::vector<TimelineEntry> timeline;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,420 @@
+#define MSC_CLASS "ThreadPolicy"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "MediaSoupClientErrors.hpp"
+#include "ThreadPolicy.hpp"
+#include "Tracing.hpp"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "DebugCpp.h"
+
+using namespace mediasoupclient;
+
+namespace
+{
+	constexpr size_t kThreadRoleCount = 5;
+
+	constexpr const char* kThreadRoleNames[kThreadRoleCount] =
+	{
+		"network", "signaling", "worker", "frameGenerator", "audioModule"
+	};
+
+	constexpr const char* kThreadPriorityNames[] =
+	{
+		"unchanged", "low", "normal", "high", "highest", "realtime"
+	};
+
+	struct RegisteredThread
+	{
+		ThreadRole role;
+		std::string name;
+		uint64_t threadId;
+#ifdef _WIN32
+		HANDLE handle;
+		// Windows cannot query the affinity of a thread, remember the last one set.
+		uint64_t affinityMask;
+#else
+		pthread_t handle;
+#endif
+		std::string error;
+	};
+
+	/* Unregisters the thread it belongs to when that thread exits. */
+	struct ThreadRegistration
+	{
+		RegisteredThread* thread = nullptr;
+
+		~ThreadRegistration();
+	};
+
+	std::mutex policyMutex;
+	ThreadSettings roleSettings[kThreadRoleCount];
+	std::list<RegisteredThread*> registeredThreads;
+	thread_local ThreadRegistration currentRegistration;
+
+	ThreadRegistration::~ThreadRegistration()
+	{
+		if (!thread)
+			return;
+
+		std::lock_guard<std::mutex> lock(policyMutex);
+
+		registeredThreads.remove(thread);
+#ifdef _WIN32
+		CloseHandle(thread->handle);
+#endif
+		delete thread;
+	}
+
+#ifdef _WIN32
+	int toOsPriority(ThreadPriority priority)
+	{
+		switch (priority)
+		{
+		case ThreadPriority::Low:
+			return THREAD_PRIORITY_BELOW_NORMAL;
+		case ThreadPriority::High:
+			return THREAD_PRIORITY_ABOVE_NORMAL;
+		case ThreadPriority::Highest:
+			return THREAD_PRIORITY_HIGHEST;
+		case ThreadPriority::Realtime:
+			return THREAD_PRIORITY_TIME_CRITICAL;
+		default:
+			return THREAD_PRIORITY_NORMAL;
+		}
+	}
+
+	ThreadPriority fromOsPriority(int osPriority)
+	{
+		if (osPriority >= THREAD_PRIORITY_TIME_CRITICAL)
+			return ThreadPriority::Realtime;
+		if (osPriority >= THREAD_PRIORITY_HIGHEST)
+			return ThreadPriority::Highest;
+		if (osPriority >= THREAD_PRIORITY_ABOVE_NORMAL)
+			return ThreadPriority::High;
+		if (osPriority >= THREAD_PRIORITY_NORMAL)
+			return ThreadPriority::Normal;
+
+		return ThreadPriority::Low;
+	}
+
+	void initializeThread(RegisteredThread* thread)
+	{
+		thread->threadId = GetCurrentThreadId();
+		// GetCurrentThread() is a pseudo handle only valid on the thread itself.
+		DuplicateHandle(
+			GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread->handle, 0, FALSE, DUPLICATE_SAME_ACCESS);
+
+		DWORD_PTR processMask;
+		DWORD_PTR systemMask;
+		thread->affinityMask = GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) ? processMask : 0;
+	}
+
+	std::string applySettings(RegisteredThread* thread, const ThreadSettings& settings)
+	{
+		std::string error;
+
+		if (settings.priority != ThreadPriority::Unchanged &&
+			!SetThreadPriority(thread->handle, toOsPriority(settings.priority)))
+		{
+			error += "SetThreadPriority failed (" + std::to_string(GetLastError()) + ") ";
+		}
+
+		if (settings.affinityMask != 0)
+		{
+			if (SetThreadAffinityMask(thread->handle, static_cast<DWORD_PTR>(settings.affinityMask)) == 0)
+				error += "SetThreadAffinityMask failed (" + std::to_string(GetLastError()) + ") ";
+			else
+				thread->affinityMask = settings.affinityMask;
+		}
+
+		return error;
+	}
+
+	EffectiveThreadSettings readSettings(const RegisteredThread* thread)
+	{
+		EffectiveThreadSettings effective;
+		effective.osPriority = GetThreadPriority(thread->handle);
+		effective.priority = fromOsPriority(effective.osPriority);
+		effective.affinityMask = thread->affinityMask;
+
+		return effective;
+	}
+#else
+	/* Nice values. Raising the priority needs CAP_SYS_NICE or RLIMIT_NICE. */
+	int toNice(ThreadPriority priority)
+	{
+		switch (priority)
+		{
+		case ThreadPriority::Low:
+			return 10;
+		case ThreadPriority::High:
+			return -5;
+		case ThreadPriority::Highest:
+			return -10;
+		default:
+			return 0;
+		}
+	}
+
+	ThreadPriority fromNice(int nice)
+	{
+		if (nice > 0)
+			return ThreadPriority::Low;
+		if (nice == 0)
+			return ThreadPriority::Normal;
+		if (nice >= -5)
+			return ThreadPriority::High;
+
+		return ThreadPriority::Highest;
+	}
+
+	std::string errnoString(const char* call, int error)
+	{
+		return std::string(call) + " failed (" + std::strerror(error) + ") ";
+	}
+
+	void initializeThread(RegisteredThread* thread)
+	{
+		thread->threadId = static_cast<uint64_t>(syscall(SYS_gettid));
+		thread->handle = pthread_self();
+	}
+
+	std::string applySettings(RegisteredThread* thread, const ThreadSettings& settings)
+	{
+		std::string error;
+		const pid_t tid = static_cast<pid_t>(thread->threadId);
+
+		if (settings.priority == ThreadPriority::Realtime)
+		{
+			sched_param param = {};
+			param.sched_priority = std::min(
+				std::max(settings.realtimePriority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+
+			int result = pthread_setschedparam(thread->handle, SCHED_FIFO, &param);
+			if (result != 0)
+				error += errnoString("pthread_setschedparam", result);
+		}
+		else if (settings.priority != ThreadPriority::Unchanged)
+		{
+			int policy;
+			sched_param param = {};
+			if (pthread_getschedparam(thread->handle, &policy, &param) == 0 && policy != SCHED_OTHER)
+			{
+				param.sched_priority = 0;
+				int result = pthread_setschedparam(thread->handle, SCHED_OTHER, &param);
+				if (result != 0)
+					error += errnoString("pthread_setschedparam", result);
+			}
+
+			// On Linux the nice value is per thread when given a thread id.
+			if (setpriority(PRIO_PROCESS, tid, toNice(settings.priority)) != 0)
+				error += errnoString("setpriority", errno);
+		}
+
+		if (settings.affinityMask != 0)
+		{
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (settings.affinityMask & (uint64_t{ 1 } << cpu))
+					CPU_SET(cpu, &cpus);
+			}
+
+			if (sched_setaffinity(tid, sizeof(cpus), &cpus) != 0)
+				error += errnoString("sched_setaffinity", errno);
+		}
+
+		return error;
+	}
+
+	EffectiveThreadSettings readSettings(const RegisteredThread* thread)
+	{
+		EffectiveThreadSettings effective;
+		const pid_t tid = static_cast<pid_t>(thread->threadId);
+
+		int policy = SCHED_OTHER;
+		sched_param param = {};
+		pthread_getschedparam(thread->handle, &policy, &param);
+		if (policy == SCHED_FIFO || policy == SCHED_RR)
+		{
+			effective.priority = ThreadPriority::Realtime;
+			effective.osPriority = param.sched_priority;
+		}
+		else
+		{
+			errno = 0;
+			int nice = getpriority(PRIO_PROCESS, tid);
+			effective.osPriority = errno == 0 ? nice : 0;
+			effective.priority = fromNice(effective.osPriority);
+		}
+
+		effective.affinityMask = 0;
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		if (sched_getaffinity(tid, sizeof(cpus), &cpus) == 0)
+		{
+			for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (CPU_ISSET(cpu, &cpus))
+					effective.affinityMask |= uint64_t{ 1 } << cpu;
+			}
+		}
+
+		return effective;
+	}
+#endif
+
+	/* Must be called with policyMutex held. */
+	void applyAndLog(RegisteredThread* thread)
+	{
+		thread->error = applySettings(thread, roleSettings[static_cast<size_t>(thread->role)]);
+
+		if (!thread->error.empty())
+			Debug::Log("[ERROR]thread settings of " + thread->name + " not applied: " + thread->error, Color::Red);
+	}
+
+	class ThreadPolicyTaskQueueFactory : public webrtc::TaskQueueFactory
+	{
+	public:
+		ThreadPolicyTaskQueueFactory(ThreadRole role, std::unique_ptr<webrtc::TaskQueueFactory> taskQueueFactory)
+			: role(role), taskQueueFactory(std::move(taskQueueFactory))
+		{
+		}
+
+		std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter> CreateTaskQueue(
+			absl::string_view name, Priority priority) const override
+		{
+			auto taskQueue = this->taskQueueFactory->CreateTaskQueue(name, priority);
+
+			// The first task runs on the thread of the queue before any frame is generated.
+			ThreadRole role = this->role;
+			std::string queueName(name);
+			taskQueue->PostTask(webrtc::ToQueuedTask([role, queueName]() { registerCurrentThread(role, queueName); }));
+
+			return taskQueue;
+		}
+
+	private:
+		const ThreadRole role;
+		const std::unique_ptr<webrtc::TaskQueueFactory> taskQueueFactory;
+	};
+}
+
+const char* threadRoleName(ThreadRole role)
+{
+	return kThreadRoleNames[static_cast<size_t>(role)];
+}
+
+const char* threadPriorityName(ThreadPriority priority)
+{
+	return kThreadPriorityNames[static_cast<size_t>(priority)];
+}
+
+ThreadRole threadRoleFromName(const std::string& name)
+{
+	for (size_t i = 0; i < kThreadRoleCount; ++i)
+	{
+		if (name == kThreadRoleNames[i])
+			return static_cast<ThreadRole>(i);
+	}
+
+	Debug::Log("[ERROR]unknown thread role " + name, Color::Red);
+	MSC_THROW_TYPE_ERROR("unknown thread role");
+}
+
+ThreadPriority threadPriorityFromName(const std::string& name)
+{
+	for (size_t i = 0; i < sizeof(kThreadPriorityNames) / sizeof(kThreadPriorityNames[0]); ++i)
+	{
+		if (name == kThreadPriorityNames[i])
+			return static_cast<ThreadPriority>(i);
+	}
+
+	Debug::Log("[ERROR]unknown thread priority " + name, Color::Red);
+	MSC_THROW_TYPE_ERROR("unknown thread priority");
+}
+
+void setThreadSettings(ThreadRole role, const ThreadSettings& settings)
+{
+	if (settings.priority == ThreadPriority::Realtime &&
+		(settings.realtimePriority < 1 || settings.realtimePriority > 99))
+	{
+		Debug::Log("[ERROR]realtimePriority must be between 1 and 99", Color::Red);
+		MSC_THROW_TYPE_ERROR("realtimePriority must be between 1 and 99");
+	}
+
+	std::lock_guard<std::mutex> lock(policyMutex);
+
+	roleSettings[static_cast<size_t>(role)] = settings;
+
+	for (RegisteredThread* thread : registeredThreads)
+	{
+		if (thread->role == role)
+			applyAndLog(thread);
+	}
+}
+
+ThreadSettings getThreadSettings(ThreadRole role)
+{
+	std::lock_guard<std::mutex> lock(policyMutex);
+
+	return roleSettings[static_cast<size_t>(role)];
+}
+
+void registerCurrentThread(ThreadRole role, const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(policyMutex);
+
+	RegisteredThread* thread = currentRegistration.thread;
+	if (!thread)
+	{
+		thread = new RegisteredThread();
+		initializeThread(thread);
+		registeredThreads.push_back(thread);
+		currentRegistration.thread = thread;
+	}
+
+	thread->role = role;
+	thread->name = name;
+	applyAndLog(thread);
+
+	setTraceThreadName(name);
+}
+
+std::vector<EffectiveThreadSettings> getEffectiveThreadSettings()
+{
+	std::lock_guard<std::mutex> lock(policyMutex);
+
+	std::vector<EffectiveThreadSettings> result;
+	for (const RegisteredThread* thread : registeredThreads)
+	{
+		EffectiveThreadSettings effective = readSettings(thread);
+		effective.role = thread->role;
+		effective.name = thread->name;
+		effective.threadId = thread->threadId;
+		effective.error = thread->error;
+		result.push_back(effective);
+	}
+
+	return result;
+}
+
+std::unique_ptr<webrtc::TaskQueueFactory> createThreadPolicyTaskQueueFactory(
+	ThreadRole role, std::unique_ptr<webrtc::TaskQueueFactory> taskQueueFactory)
+{
+	return std::make_unique<ThreadPolicyTaskQueueFactory>(role, std::move(taskQueueFactory));
+}
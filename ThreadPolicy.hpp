@@ -0,0 +1,81 @@
+#ifndef MSC_TEST_THREAD_POLICY_HPP
+#define MSC_TEST_THREAD_POLICY_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "api/task_queue/task_queue_factory.h"
+
+/* Threads whose scheduling can be tuned. */
+enum class ThreadRole
+{
+	Network,
+	Signaling,
+	Worker,
+	FrameGenerator, // task queues running the frame generator capturers
+	AudioModule     // threads pushing and pulling audio in the fake audio device
+};
+
+enum class ThreadPriority
+{
+	Unchanged,
+	Low,
+	Normal,
+	High,
+	Highest,
+	// SCHED_FIFO on Linux, time critical priority on Windows.
+	Realtime
+};
+
+struct ThreadSettings
+{
+	ThreadPriority priority = ThreadPriority::Unchanged;
+	// SCHED_FIFO priority (1-99) used by ThreadPriority::Realtime on Linux.
+	int realtimePriority = 10;
+	// Bit i allows the thread on CPU i. 0 leaves the affinity unchanged.
+	uint64_t affinityMask = 0;
+};
+
+/* What the OS reports for a registered thread. */
+struct EffectiveThreadSettings
+{
+	ThreadRole role;
+	std::string name;
+	uint64_t threadId;
+	ThreadPriority priority;
+	// Raw value: Windows thread priority, SCHED_FIFO priority or nice value.
+	int osPriority;
+	uint64_t affinityMask;
+	// Why the last settings could not be applied, empty on success.
+	std::string error;
+};
+
+const char* threadRoleName(ThreadRole role);
+const char* threadPriorityName(ThreadPriority priority);
+
+// Throw TypeError on unknown names.
+ThreadRole threadRoleFromName(const std::string& name);
+ThreadPriority threadPriorityFromName(const std::string& name);
+
+// Stores the settings of a role and applies them to its registered threads.
+// Threads registered later get them as they register.
+void setThreadSettings(ThreadRole role, const ThreadSettings& settings);
+
+ThreadSettings getThreadSettings(ThreadRole role);
+
+// Registers the calling thread under the given role and applies the settings
+// of the role to it. The thread is unregistered when it exits.
+void registerCurrentThread(ThreadRole role, const std::string& name);
+
+std::vector<EffectiveThreadSettings> getEffectiveThreadSettings();
+
+// Task queue factory registering the threads of the queues it creates.
+std::unique_ptr<webrtc::TaskQueueFactory> createThreadPolicyTaskQueueFactory(
+	ThreadRole role, std::unique_ptr<webrtc::TaskQueueFactory> taskQueueFactory);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+#define MSC_CLASS "TimerWheel"
+
+#include <algorithm>
+#include <vector>
+#include "TimerWheel.hpp"
+
+TimerWheel::TimerWheel()
+{
+	this->thread = std::thread(&TimerWheel::Run, this);
+}
+
+TimerWheel::~TimerWheel()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->changed.notify_all();
+	this->thread.join();
+}
+
+TimerWheel::TimerId TimerWheel::Schedule(std::chrono::milliseconds delay, Callback callback)
+{
+	return this->Add(static_cast<uint64_t>(std::max<int64_t>(delay.count(), 0)), 0, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::SchedulePeriodic(
+	std::chrono::milliseconds firstDelay, std::chrono::milliseconds interval, Callback callback)
+{
+	return this->Add(
+		static_cast<uint64_t>(std::max<int64_t>(firstDelay.count(), 0)),
+		static_cast<uint64_t>(std::max<int64_t>(interval.count(), 1)),
+		std::move(callback));
+}
+
+bool TimerWheel::Cancel(TimerId id)
+{
+	if (id == 0)
+		return false;
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	bool cancelled = false;
+
+	auto it = this->timers.find(id);
+	if (it != this->timers.end())
+	{
+		this->Unlink(it->second.get());
+		this->timers.erase(it);
+		++this->stats.cancelled;
+		cancelled = true;
+	}
+
+	if (std::this_thread::get_id() != this->thread.get_id())
+		this->changed.wait(lock, [&]() { return this->running != id; });
+
+	return cancelled;
+}
+
+TimerWheel::Stats TimerWheel::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Stats stats = this->stats;
+	stats.timers = this->timers.size();
+
+	return stats;
+}
+
+TimerWheel::TimerId TimerWheel::Add(uint64_t delay, uint64_t interval, Callback callback)
+{
+	std::unique_ptr<Timer> timer(new Timer());
+	timer->interval = interval;
+	timer->callback = std::move(callback);
+
+	TimerId id;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		id = timer->id = this->nextId++;
+		// The wheel may lag behind the clock; count from now, not from it.
+		timer->expiry = std::max(this->Now(), this->current) + delay;
+		this->Link(timer.get());
+		this->timers.emplace(id, std::move(timer));
+	}
+	this->changed.notify_all();
+
+	return id;
+}
+
+uint64_t TimerWheel::Now() const
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->start).count());
+}
+
+void TimerWheel::Run()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (!this->stopping)
+	{
+		const uint64_t now = this->Now();
+		if (this->timers.empty())
+			this->current = std::max(this->current, now);
+		while (this->current < now && !this->stopping)
+			this->Advance();
+
+		const uint64_t wakeUp = this->NextWakeUp();
+		if (wakeUp == 0)
+			this->changed.wait(lock);
+		else if (wakeUp > this->Now())
+			this->changed.wait_until(lock, this->start + std::chrono::milliseconds(wakeUp));
+	}
+}
+
+void TimerWheel::Advance()
+{
+	++this->current;
+
+	if ((this->current & kSlotMask) == 0)
+	{
+		for (int level = kLevels - 1; level > 0; --level)
+		{
+			if ((this->current & ((uint64_t(1) << (kSlotBits * level)) - 1)) == 0)
+				this->Cascade(level);
+		}
+	}
+
+	// Detach the due timers first: callbacks run unlocked and may schedule or
+	// cancel timers meanwhile.
+	std::vector<TimerId> due;
+	Timer*& slot = this->slots[0][this->current & kSlotMask];
+	while (slot)
+	{
+		Timer* timer = slot;
+		this->Unlink(timer);
+		if (timer->expiry > this->current)
+			this->Link(timer);
+		else
+			due.push_back(timer->id);
+
+		if (slot == timer)
+			break;
+	}
+
+	for (TimerId id : due)
+	{
+		auto it = this->timers.find(id);
+		if (it == this->timers.end())
+			continue;
+
+		Timer* timer = it->second.get();
+		// A periodic callback keeps its timer; a one-shot one takes it along.
+		Callback callback = timer->interval > 0 ? timer->callback : std::move(timer->callback);
+		const int64_t lateness = static_cast<int64_t>(this->Now()) - static_cast<int64_t>(timer->expiry);
+
+		if (timer->interval > 0)
+		{
+			timer->expiry = this->current + timer->interval;
+			this->Link(timer);
+		}
+		else
+		{
+			this->timers.erase(it);
+		}
+
+		++this->stats.fired;
+		this->stats.maxLatenessMs = std::max(this->stats.maxLatenessMs, lateness);
+		this->running = id;
+
+		this->mutex.unlock();
+		callback();
+		this->mutex.lock();
+
+		this->running = 0;
+		this->changed.notify_all();
+	}
+}
+
+void TimerWheel::Cascade(int level)
+{
+	Timer*& slot = this->slots[level][(this->current >> (kSlotBits * level)) & kSlotMask];
+
+	while (slot)
+	{
+		Timer* timer = slot;
+		this->Unlink(timer);
+		this->Link(timer);
+	}
+}
+
+void TimerWheel::Link(Timer* timer)
+{
+	if (timer->expiry <= this->current)
+		timer->expiry = this->current + 1;
+
+	const uint64_t delta = timer->expiry - this->current;
+
+	Timer** slot = nullptr;
+	for (int level = 0; level < kLevels && !slot; ++level)
+	{
+		if (delta < (uint64_t(1) << (kSlotBits * (level + 1))))
+			slot = &this->slots[level][(timer->expiry >> (kSlotBits * level)) & kSlotMask];
+	}
+	// Beyond the range of the wheel: park it in the farthest slot, it is
+	// placed again when that slot cascades.
+	if (!slot)
+		slot = &this->slots[kLevels - 1][((this->current >> (kSlotBits * (kLevels - 1))) - 1) & kSlotMask];
+
+	timer->slot = slot;
+	timer->previous = nullptr;
+	timer->next = *slot;
+	if (*slot)
+		(*slot)->previous = timer;
+	*slot = timer;
+}
+
+void TimerWheel::Unlink(Timer* timer)
+{
+	if (!timer->slot)
+		return;
+
+	if (timer->previous)
+		timer->previous->next = timer->next;
+	else
+		*timer->slot = timer->next;
+	if (timer->next)
+		timer->next->previous = timer->previous;
+
+	timer->slot = nullptr;
+	timer->previous = nullptr;
+	timer->next = nullptr;
+}
+
+uint64_t TimerWheel::NextWakeUp() const
+{
+	if (this->timers.empty())
+		return 0;
+
+	for (uint64_t tick = this->current + 1; tick <= this->current + kSlots; ++tick)
+	{
+		if ((tick & kSlotMask) == 0)
+			return tick; // timers of the upper levels cascade here
+		if (this->slots[0][tick & kSlotMask])
+			return tick;
+	}
+
+	return this->current + kSlots;
+}
+
+TimerWheel& getTimerWheel()
+{
+	static TimerWheel timerWheel;
+
+	return timerWheel;
+}
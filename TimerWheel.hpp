@@ -0,0 +1,99 @@
+#ifndef MSC_TEST_TIMER_WHEEL_HPP
+#define MSC_TEST_TIMER_WHEEL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/* Hierarchical timer wheel running every timer of the process on a single
+ * thread, so that periodic tasks and timeouts do not each need a sleeping
+ * thread. Four levels of 256 slots cover 2^32 ticks of 1 ms; a timer sits in
+ * the slot of its expiry on the lowest level that reaches it and moves down
+ * as the wheel turns. Scheduling and cancelling are O(1).
+ *
+ * Callbacks run on the wheel thread and must not block: a slow callback
+ * delays every other timer.
+ */
+class TimerWheel
+{
+public:
+	using Callback = std::function<void()>;
+	// 0 is never a valid id.
+	using TimerId = uint64_t;
+
+	struct Stats
+	{
+		size_t timers;
+		uint64_t fired;
+		uint64_t cancelled;
+		// Largest delay between the expiry of a timer and its callback.
+		int64_t maxLatenessMs;
+	};
+
+	TimerWheel();
+	// Drops the pending timers without running them.
+	~TimerWheel();
+
+	TimerId Schedule(std::chrono::milliseconds delay, Callback callback);
+	// Runs callback after firstDelay, then every interval until cancelled.
+	TimerId SchedulePeriodic(std::chrono::milliseconds firstDelay, std::chrono::milliseconds interval, Callback callback);
+
+	// Returns false if the timer already fired or was cancelled. When the
+	// callback is running on another thread, waits for it to return, so that
+	// what it uses can be freed afterwards.
+	bool Cancel(TimerId id);
+
+	Stats GetStats() const;
+
+private:
+	static constexpr int kLevels = 4;
+	static constexpr int kSlotBits = 8;
+	static constexpr uint64_t kSlots = 1 << kSlotBits;
+	static constexpr uint64_t kSlotMask = kSlots - 1;
+
+	struct Timer
+	{
+		TimerId id;
+		uint64_t expiry;   // tick
+		uint64_t interval; // ticks, 0 for one-shot timers
+		Callback callback;
+		// Position in its slot list, if linked.
+		Timer* previous = nullptr;
+		Timer* next = nullptr;
+		Timer** slot = nullptr;
+	};
+
+	TimerId Add(uint64_t delay, uint64_t interval, Callback callback);
+	uint64_t Now() const;
+	void Run();
+	void Advance();
+	void Cascade(int level);
+	void Link(Timer* timer);
+	void Unlink(Timer* timer);
+	// Tick at which the thread must wake up next, or 0 if there are no timers.
+	uint64_t NextWakeUp() const;
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+	bool stopping = false;
+	uint64_t current = 0;
+	TimerId nextId = 1;
+	// Id of the callback being run, 0 if none.
+	TimerId running = 0;
+	Timer* slots[kLevels][kSlots] = {};
+	std::unordered_map<TimerId, std::unique_ptr<Timer>> timers;
+	Stats stats = {};
+	std::thread thread;
+};
+
+// Wheel shared by the whole process, started on first use.
+TimerWheel& getTimerWheel();
+
+#endif
\ No newline at end of file
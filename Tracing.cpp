@@ -0,0 +1,291 @@
+#define MSC_CLASS "Tracing"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Tracing.hpp"
+#include "json.hpp"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Event
+	{
+		std::string name;
+		const char* category;
+		// Chrome trace event phase: 'X' complete, 'i' instant, 'b' and 'e' async.
+		char phase;
+		int64_t timestampUs;
+		int64_t durationUs;
+		uint64_t id;
+		const char* argName;
+		std::string argValue;
+	};
+
+	constexpr size_t kChunkEvents = 1024;
+	constexpr size_t kChunks = kMaxTraceEventsPerThread / kChunkEvents;
+
+	/* Appended to by its thread only, so readers can read the events below
+	 * count while the thread writes the next ones. Slots are only reused once
+	 * cleared, under buffersMutex.
+	 */
+	struct ThreadBuffer
+	{
+		~ThreadBuffer()
+		{
+			for (auto& chunk : this->chunks)
+				delete[] chunk.load();
+		}
+
+		uint32_t tid;
+		std::atomic<Event*> chunks[kChunks] = {};
+		std::atomic<size_t> count{ 0 };
+		// First event kept, moved by clearTrace().
+		std::atomic<size_t> first{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		// Guarded by buffersMutex.
+		std::string threadName;
+	};
+
+	std::atomic<bool> enabled{ false };
+	std::atomic<uint64_t> nextId{ 1 };
+	const Clock::time_point origin = Clock::now();
+
+	// Buffers outlive their threads, which keeps the events they recorded.
+	std::mutex buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	thread_local ThreadBuffer* currentBuffer = nullptr;
+	// Until the thread has a buffer.
+	thread_local std::string currentThreadName;
+
+	int64_t toUs(Clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(time - origin).count();
+	}
+
+	ThreadBuffer* getBuffer()
+	{
+		if (!currentBuffer)
+		{
+			std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+
+			std::lock_guard<std::mutex> lock(buffersMutex);
+
+			buffer->tid = static_cast<uint32_t>(buffers.size() + 1);
+			buffer->threadName = currentThreadName;
+			currentBuffer = buffer.get();
+			buffers.push_back(std::move(buffer));
+		}
+
+		return currentBuffer;
+	}
+
+	void record(Event event)
+	{
+		ThreadBuffer* buffer = getBuffer();
+		size_t index = buffer->count.load(std::memory_order_relaxed);
+		if (index != 0 && buffer->first.load(std::memory_order_relaxed) == index)
+		{
+			// Everything was cleared: start over, while no reader looks.
+			std::lock_guard<std::mutex> lock(buffersMutex);
+
+			buffer->first = 0;
+			buffer->count.store(0, std::memory_order_relaxed);
+			index = 0;
+		}
+		if (index >= kMaxTraceEventsPerThread)
+		{
+			++buffer->dropped;
+
+			return;
+		}
+
+		std::atomic<Event*>& chunk = buffer->chunks[index / kChunkEvents];
+		if (!chunk.load(std::memory_order_relaxed))
+			chunk.store(new Event[kChunkEvents], std::memory_order_relaxed);
+
+		chunk.load(std::memory_order_relaxed)[index % kChunkEvents] = std::move(event);
+		// Publishes the event and its chunk.
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	nlohmann::json toJson(const Event& event, uint32_t tid)
+	{
+		/* clang-format off */
+		nlohmann::json json =
+		{
+			{ "name", event.name                  },
+			{ "cat",  event.category              },
+			{ "ph",   std::string(1, event.phase) },
+			{ "ts",   event.timestampUs           },
+			{ "pid",  1                           },
+			{ "tid",  tid                         }
+		};
+		/* clang-format on */
+
+		if (event.phase == 'X')
+			json["dur"] = event.durationUs;
+		else if (event.phase == 'i')
+			json["s"] = "t";
+		else
+			json["id"] = event.id;
+
+		if (event.argName[0] != '\0')
+			json["args"] = { { event.argName, event.argValue } };
+
+		return json;
+	}
+}
+
+void enableTracing(bool enable)
+{
+	enabled = enable;
+}
+
+bool isTracingEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const std::string& name)
+{
+	if (!currentBuffer)
+	{
+		currentThreadName = name;
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	currentBuffer->threadName = name;
+}
+
+void traceInstant(const char* category, const std::string& name, const char* argName, const std::string& argValue)
+{
+	if (!isTracingEnabled())
+		return;
+
+	record({ name, category, 'i', toUs(Clock::now()), 0, 0, argName, argValue });
+}
+
+uint64_t newTraceId()
+{
+	return isTracingEnabled() ? nextId++ : 0;
+}
+
+void traceAsyncBegin(const char* category, const std::string& name, uint64_t id)
+{
+	if (id == 0 || !isTracingEnabled())
+		return;
+
+	record({ name, category, 'b', toUs(Clock::now()), 0, id, "", "" });
+}
+
+void traceAsyncEnd(const char* category, const std::string& name, uint64_t id)
+{
+	if (id == 0 || !isTracingEnabled())
+		return;
+
+	record({ name, category, 'e', toUs(Clock::now()), 0, id, "", "" });
+}
+
+TraceScope::TraceScope(const char* category, const std::string& name)
+	: category(category)
+{
+	if (!isTracingEnabled())
+		return;
+
+	this->name = name;
+	this->start = Clock::now();
+}
+
+TraceScope::~TraceScope()
+{
+	if (this->start == Clock::time_point() || !isTracingEnabled())
+		return;
+
+	const auto end = Clock::now();
+
+	record({ this->name, this->category, 'X', toUs(this->start), toUs(end) - toUs(this->start), 0, "", "" });
+}
+
+std::string getTraceJson()
+{
+	nlohmann::json events = nlohmann::json::array();
+
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+
+		for (const auto& buffer : buffers)
+		{
+			const std::string threadName =
+				buffer->threadName.empty() ? "thread " + std::to_string(buffer->tid) : buffer->threadName;
+
+			/* clang-format off */
+			events.push_back(
+			{
+				{ "name", "thread_name"                },
+				{ "ph",   "M"                          },
+				{ "pid",  1                            },
+				{ "tid",  buffer->tid                  },
+				{ "args", { { "name", threadName } }   }
+			});
+			/* clang-format on */
+
+			const size_t count = buffer->count.load(std::memory_order_acquire);
+			for (size_t index = buffer->first.load(); index < count; ++index)
+			{
+				const Event* chunk = buffer->chunks[index / kChunkEvents].load(std::memory_order_relaxed);
+
+				events.push_back(toJson(chunk[index % kChunkEvents], buffer->tid));
+			}
+		}
+	}
+
+	nlohmann::json trace = { { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+
+	return trace.dump();
+}
+
+bool writeTrace(const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file << getTraceJson();
+
+	return static_cast<bool>(file);
+}
+
+void clearTrace()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	for (auto& buffer : buffers)
+	{
+		buffer->first = buffer->count.load(std::memory_order_acquire);
+		buffer->dropped = 0;
+	}
+}
+
+TraceStats getTraceStats()
+{
+	TraceStats stats = { isTracingEnabled(), 0, 0, 0 };
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	for (const auto& buffer : buffers)
+	{
+		stats.events += buffer->count.load() - buffer->first.load();
+		stats.dropped += buffer->dropped.load();
+	}
+	stats.threads = buffers.size();
+
+	return stats;
+}
\ No newline at end of file
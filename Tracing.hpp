@@ -0,0 +1,107 @@
+#ifndef MSC_TEST_TRACING_HPP
+#define MSC_TEST_TRACING_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* Spans and events of the join and of the media pipeline, written out in the
+ * Chrome trace event format to be opened in Perfetto or chrome://tracing.
+ * Disabled by default, when every call below returns right away.
+ *
+ * Each thread appends to a buffer of its own without locks; readers only see
+ * events once fully written. A thread keeps at most kMaxTraceEventsPerThread
+ * events and drops the later ones until its events are all cleared.
+ * Timestamps are real time, also on simulated time.
+ *
+ * Categories are string literals: "api" for DLL exports, "startup" for
+ * StartupPipeline steps, "signaling" for requests awaited by
+ * libmediasoupclient, "network" and "media".
+ */
+
+constexpr size_t kMaxTraceEventsPerThread = 256 * 1024;
+
+struct TraceStats
+{
+	bool enabled;
+	// Kept since the last clear.
+	uint64_t events;
+	uint64_t dropped;
+	size_t threads;
+};
+
+void enableTracing(bool enable);
+
+bool isTracingEnabled();
+
+// Names the calling thread in the trace, also while disabled. Threads
+// registered with registerCurrentThread() are named already.
+void setTraceThreadName(const std::string& name);
+
+// Event with no duration. argName, if not empty, is shown with argValue.
+void traceInstant(
+	const char* category, const std::string& name, const char* argName = "", const std::string& argValue = "");
+
+// Unique id of an async event, 0 while disabled.
+uint64_t newTraceId();
+
+// Async events can end on another thread than they began; ids of 0 are
+// ignored, so that events begun while disabled do not end.
+void traceAsyncBegin(const char* category, const std::string& name, uint64_t id);
+void traceAsyncEnd(const char* category, const std::string& name, uint64_t id);
+
+// Span of the enclosing scope, on the calling thread.
+class TraceScope
+{
+public:
+	TraceScope(const char* category, const std::string& name);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* category;
+	std::string name;
+	// Zero if disabled at the start.
+	std::chrono::steady_clock::time_point start;
+};
+
+// Ends an async event when it goes out of scope, e.g. when the future
+// resolving it returns or throws.
+class TraceAsyncEnd
+{
+public:
+	TraceAsyncEnd(const char* category, const char* name, uint64_t id)
+		: category(category), name(name), id(id)
+	{
+	}
+
+	~TraceAsyncEnd()
+	{
+		traceAsyncEnd(this->category, this->name, this->id);
+	}
+
+	TraceAsyncEnd(const TraceAsyncEnd&) = delete;
+	TraceAsyncEnd& operator=(const TraceAsyncEnd&) = delete;
+
+private:
+	const char* category;
+	const char* name;
+	uint64_t id;
+};
+
+// { "traceEvents": [ ... ], "displayTimeUnit": "ms" } with the events since
+// the last clear.
+std::string getTraceJson();
+
+// Returns false if the file cannot be written.
+bool writeTrace(const std::string& path);
+
+// Drops the events recorded so far, and those a thread records next are
+// buffered from the start again.
+void clearTrace();
+
+TraceStats getTraceStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,264 @@
+#define MSC_CLASS "TransportPool"
+
+#include <algorithm>
+#include <vector>
+#include "CertificatePool.hpp"
+#include "MediaSoupClientErrors.hpp"
+#include "TransportPool.hpp"
+#include "DebugCpp.h"
+
+using namespace mediasoupclient;
+
+TransportPool::TransportPool(
+	Device* device,
+	SendTransport::Listener* sendListener,
+	RecvTransport::Listener* recvListener,
+	Provisioner provisioner,
+	Warmer warmer,
+	Releaser releaser,
+	const PeerConnection::Options& peerConnectionOptions,
+	std::chrono::milliseconds idleTimeout)
+	: device(device),
+	  sendListener(sendListener),
+	  recvListener(recvListener),
+	  provisioner(std::move(provisioner)),
+	  warmer(std::move(warmer)),
+	  releaser(std::move(releaser)),
+	  peerConnectionOptions(peerConnectionOptions),
+	  idleTimeout(idleTimeout)
+{
+	this->thread = std::thread(&TransportPool::Run, this);
+}
+
+TransportPool::~TransportPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wakeUp.notify_all();
+	this->thread.join();
+
+	for (auto& idle : this->idleSend)
+		this->Release(idle.transport, "send");
+	for (auto& idle : this->idleRecv)
+		this->Release(idle.transport, "recv");
+}
+
+void TransportPool::Prewarm(size_t sendCount, size_t recvCount)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->sendTarget = sendCount;
+		this->recvTarget = recvCount;
+	}
+	this->wakeUp.notify_all();
+}
+
+SendTransport* TransportPool::TakeSendTransport()
+{
+	return this->Take(this->idleSend);
+}
+
+RecvTransport* TransportPool::TakeRecvTransport()
+{
+	return this->Take(this->idleRecv);
+}
+
+template<class T>
+T* TransportPool::Take(std::deque<IdleTransport<T>>& idle)
+{
+	T* transport = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (idle.empty())
+		{
+			++this->stats.misses;
+			return nullptr;
+		}
+
+		/* The oldest one is the most likely to be connected. */
+		transport = idle.front().transport;
+		idle.pop_front();
+		++this->stats.hits;
+	}
+
+	// Replace it.
+	this->wakeUp.notify_all();
+
+	return transport;
+}
+
+TransportPool::Stats TransportPool::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Stats result = this->stats;
+	result.idleSend = this->idleSend.size();
+	result.idleRecv = this->idleRecv.size();
+
+	return result;
+}
+
+void TransportPool::Run()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (!this->stopping)
+	{
+		lock.unlock();
+		this->ExpireIdle();
+		this->Refill();
+		lock.lock();
+
+		/* Wakes up for Prewarm(), Take() and to expire idle transports. */
+		auto hasWork = [this]() {
+			return this->stopping || this->idleSend.size() < this->sendTarget ||
+				this->idleRecv.size() < this->recvTarget;
+		};
+		/* At least 1 ms, or a timeout under 2 ms would make this spin. */
+		if (this->idleTimeout.count() > 0)
+			this->wakeUp.wait_for(lock, std::max(this->idleTimeout / 2, std::chrono::milliseconds(1)), hasWork);
+		else
+			this->wakeUp.wait(lock, hasWork);
+	}
+}
+
+void TransportPool::Refill()
+{
+	while (true)
+	{
+		std::string direction;
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			if (this->stopping)
+				return;
+
+			if (this->idleSend.size() < this->sendTarget)
+				direction = "send";
+			else if (this->idleRecv.size() < this->recvTarget)
+				direction = "recv";
+			else
+				return;
+		}
+
+		Transport* transport = nullptr;
+		try
+		{
+			const nlohmann::json parameters = this->provisioner(direction);
+			if (parameters.is_null())
+				MSC_THROW_ERROR("provisioner returned no transport");
+
+			/* Pooled transports share the cached certificate too. */
+			PeerConnection::Options options = this->peerConnectionOptions;
+			if (options.config.certificates.empty())
+			{
+				if (auto certificate = getCachedCertificate())
+					options.config.certificates.push_back(certificate);
+			}
+
+			const std::string id = parameters.at("id").get<std::string>();
+			const nlohmann::json sctpParameters = parameters.value("sctpParameters", nlohmann::json());
+
+			if (direction == "send")
+			{
+				transport = sctpParameters.is_null()
+					? this->device->CreateSendTransport(
+						this->sendListener, id, parameters.at("iceParameters"), parameters.at("iceCandidates"),
+						parameters.at("dtlsParameters"), &options)
+					: this->device->CreateSendTransport(
+						this->sendListener, id, parameters.at("iceParameters"), parameters.at("iceCandidates"),
+						parameters.at("dtlsParameters"), sctpParameters, &options);
+			}
+			else
+			{
+				transport = sctpParameters.is_null()
+					? this->device->CreateRecvTransport(
+						this->recvListener, id, parameters.at("iceParameters"), parameters.at("iceCandidates"),
+						parameters.at("dtlsParameters"), &options)
+					: this->device->CreateRecvTransport(
+						this->recvListener, id, parameters.at("iceParameters"), parameters.at("iceCandidates"),
+						parameters.at("dtlsParameters"), sctpParameters, &options);
+			}
+
+			if (this->warmer)
+				this->warmer(transport, direction);
+		}
+		catch (std::exception& e)
+		{
+			Debug::Log("[ERROR]pooled " + direction + " transport creation errored: " + e.what(), Color::Red);
+			if (transport)
+			{
+				transport->Close();
+				delete transport;
+			}
+
+			std::unique_lock<std::mutex> lock(this->mutex);
+			++this->stats.failures;
+			/* Retry later rather than hammering the server. */
+			this->wakeUp.wait_for(lock, std::chrono::seconds(1), [this]() { return this->stopping; });
+
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		++this->stats.created;
+		const auto now = std::chrono::steady_clock::now();
+		if (direction == "send")
+			this->idleSend.push_back({ static_cast<SendTransport*>(transport), now });
+		else
+			this->idleRecv.push_back({ static_cast<RecvTransport*>(transport), now });
+	}
+}
+
+void TransportPool::ExpireIdle()
+{
+	if (this->idleTimeout.count() <= 0)
+		return;
+
+	std::vector<std::pair<Transport*, std::string>> expired;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		const auto deadline = std::chrono::steady_clock::now() - this->idleTimeout;
+		auto expire = [&](auto& idle, size_t& target, const char* direction) {
+			while (!idle.empty() && idle.front().since < deadline)
+			{
+				expired.emplace_back(idle.front().transport, direction);
+				idle.pop_front();
+				// Nobody joined: stop keeping spares until the next Prewarm().
+				target = std::min(target, idle.size());
+			}
+		};
+		expire(this->idleSend, this->sendTarget, "send");
+		expire(this->idleRecv, this->recvTarget, "recv");
+		this->stats.expired += expired.size();
+	}
+
+	for (auto& item : expired)
+		this->Release(item.first, item.second);
+}
+
+void TransportPool::Release(Transport* transport, const std::string& direction)
+{
+	const std::string id = transport->GetId();
+
+	transport->Close();
+	delete transport;
+
+	/* Closing the client transport leaves the server one open. */
+	if (!this->releaser)
+		return;
+
+	try
+	{
+		this->releaser(id, direction);
+	}
+	catch (std::exception& e)
+	{
+		Debug::Log("[ERROR]releasing transport " + id + " errored: " + e.what(), Color::Red);
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef MSC_TEST_TRANSPORT_POOL_HPP
+#define MSC_TEST_TRANSPORT_POOL_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "mediasoupclient.hpp"
+#include "json.hpp"
+
+/* Spare send and recv transports created, and optionally connected, in the
+ * background so that a join or a room switch can take one instead of waiting
+ * for the server round trip and the ICE/DTLS handshake.
+ */
+class TransportPool
+{
+public:
+	// Creates the server side transport for direction ("send" or "recv") and
+	// returns its parameters: id, iceParameters, iceCandidates, dtlsParameters
+	// and optionally sctpParameters. Throws or returns null on failure.
+	using Provisioner = std::function<nlohmann::json(const std::string& direction)>;
+	// Starts ICE/DTLS on a fresh transport, e.g. by producing a data channel.
+	// Transports are handed out unconnected when not set.
+	using Warmer = std::function<void(mediasoupclient::Transport* transport, const std::string& direction)>;
+	// Closes the server side of a transport the pool dropped.
+	using Releaser = std::function<void(const std::string& transportId, const std::string& direction)>;
+
+	struct Stats
+	{
+		size_t idleSend;
+		size_t idleRecv;
+		uint64_t created;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t expired;
+		uint64_t failures;
+	};
+
+	TransportPool(
+		mediasoupclient::Device* device,
+		mediasoupclient::SendTransport::Listener* sendListener,
+		mediasoupclient::RecvTransport::Listener* recvListener,
+		Provisioner provisioner,
+		Warmer warmer,
+		Releaser releaser,
+		const mediasoupclient::PeerConnection::Options& peerConnectionOptions,
+		std::chrono::milliseconds idleTimeout);
+	// Closes, deletes and releases the idle transports.
+	~TransportPool();
+
+	// Keeps that many idle transports of each direction. Taken transports are
+	// replaced; expired ones are not, until the next call.
+	void Prewarm(size_t sendCount, size_t recvCount);
+
+	// Return an idle transport, now owned by the caller, or nullptr if none is
+	// ready.
+	mediasoupclient::SendTransport* TakeSendTransport();
+	mediasoupclient::RecvTransport* TakeRecvTransport();
+
+	Stats GetStats() const;
+
+private:
+	template<class T>
+	struct IdleTransport
+	{
+		T* transport;
+		std::chrono::steady_clock::time_point since;
+	};
+
+	void Run();
+	void Refill();
+	void ExpireIdle();
+	void Release(mediasoupclient::Transport* transport, const std::string& direction);
+	template<class T>
+	T* Take(std::deque<IdleTransport<T>>& idle);
+
+	mediasoupclient::Device* device;
+	mediasoupclient::SendTransport::Listener* sendListener;
+	mediasoupclient::RecvTransport::Listener* recvListener;
+	const Provisioner provisioner;
+	const Warmer warmer;
+	const Releaser releaser;
+	const mediasoupclient::PeerConnection::Options peerConnectionOptions;
+	const std::chrono::milliseconds idleTimeout;
+
+	mutable std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+	size_t sendTarget = 0;
+	size_t recvTarget = 0;
+	std::deque<IdleTransport<mediasoupclient::SendTransport>> idleSend;
+	std::deque<IdleTransport<mediasoupclient::RecvTransport>> idleRecv;
+	Stats stats = {};
+	std::thread thread;
+};
+
+#endif
\ No newline at end of file
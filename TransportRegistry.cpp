@@ -0,0 +1,70 @@
+#define MSC_CLASS "TransportRegistry"
+
+#include "MediaSoupClientErrors.hpp"
+#include "TransportRegistry.hpp"
+
+using namespace mediasoupclient;
+
+std::shared_ptr<TransportRegistry::Context> TransportRegistry::Add(
+	Transport* transport, Role role, const std::string& path)
+{
+	auto context = std::make_shared<Context>(role, transport->GetId(), path);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->contexts[transport] = context;
+
+	return context;
+}
+
+void TransportRegistry::Remove(Transport* transport)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->contexts.erase(transport);
+}
+
+void TransportRegistry::Clear()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->contexts.clear();
+}
+
+std::shared_ptr<TransportRegistry::Context> TransportRegistry::Find(Transport* transport) const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto it = this->contexts.find(transport);
+
+	return it != this->contexts.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<TransportRegistry::Context> TransportRegistry::Get(Transport* transport) const
+{
+	auto context = this->Find(transport);
+	if (!context)
+		MSC_THROW_INVALID_STATE_ERROR("unknown transport");
+
+	return context;
+}
+
+std::vector<TransportRegistry::Stats> TransportRegistry::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	std::vector<Stats> stats;
+	stats.reserve(this->contexts.size());
+	for (const auto& entry : this->contexts)
+	{
+		const Context& context = *entry.second;
+
+		stats.push_back({ context.id,
+		                  context.role,
+		                  context.connects.load(),
+		                  context.connectionStateChanges.load(),
+		                  context.produces.load() });
+	}
+
+	return stats;
+}
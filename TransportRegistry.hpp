@@ -0,0 +1,73 @@
+#ifndef MSC_TEST_TRANSPORT_REGISTRY_HPP
+#define MSC_TEST_TRANSPORT_REGISTRY_HPP
+#ifdef _WIN32
+#define WEBRTC_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mediasoupclient.hpp"
+
+/* What a transport listener needs to know about the transports it serves,
+ * keyed by the pointer the callbacks receive, so that a callback finds its
+ * transport with one hash lookup instead of comparing ids.
+ */
+class TransportRegistry
+{
+public:
+	enum class Role
+	{
+		Send,
+		Recv
+	};
+
+	struct Context
+	{
+		Context(Role role, const std::string& id, const std::string& path) : role(role), id(id), path(path)
+		{
+		}
+
+		const Role role;
+		const std::string id;
+		// Signaling path of the server side, e.g. "/broadcasters/<id>/transports/<id>".
+		const std::string path;
+
+		std::atomic<uint64_t> connects{ 0 };
+		std::atomic<uint64_t> connectionStateChanges{ 0 };
+		std::atomic<uint64_t> produces{ 0 };
+	};
+
+	struct Stats
+	{
+		std::string id;
+		Role role;
+		uint64_t connects;
+		uint64_t connectionStateChanges;
+		uint64_t produces;
+	};
+
+	// Replaces the context of a transport added before.
+	std::shared_ptr<Context> Add(mediasoupclient::Transport* transport, Role role, const std::string& path);
+	void Remove(mediasoupclient::Transport* transport);
+	void Clear();
+
+	// nullptr if the transport was not added.
+	std::shared_ptr<Context> Find(mediasoupclient::Transport* transport) const;
+	// Throws if the transport was not added.
+	std::shared_ptr<Context> Get(mediasoupclient::Transport* transport) const;
+
+	std::vector<Stats> GetStats() const;
+
+private:
+	mutable std::mutex mutex;
+	std::unordered_map<mediasoupclient::Transport*, std::shared_ptr<Context>> contexts;
+};
+
+#endif
\ No newline at end of file
@@ -15,7 +15,8 @@
 
 #include "rtc_base/checks.h"
 #include "test/frame_generator.h"
-#include "test/testsupport/ivf_video_frame_generator.h"
+#include "test/testsupport/memory_mapped_file.h"
+#include "test/testsupport/prefetching_ivf_video_frame_generator.h"
 
 namespace webrtc {
 namespace test {
@@ -36,20 +37,21 @@ std::unique_ptr<FrameGeneratorInterface> CreateFromYuvFileFrameGenerator(
     size_t height,
     int frame_repeat_count) {
   RTC_DCHECK(!filenames.empty());
-  std::vector<FILE*> files;
+  std::vector<rtc::scoped_refptr<MemoryMappedFile>> files;
   for (const std::string& filename : filenames) {
-    FILE* file = fopen(filename.c_str(), "rb");
-    RTC_DCHECK(file != nullptr) << "Failed to open: '" << filename << "'\n";
-    files.push_back(file);
+    rtc::scoped_refptr<MemoryMappedFile> file = MemoryMappedFile::Open(filename);
+    RTC_CHECK(file) << "Failed to map: '" << filename << "'\n";
+    files.push_back(std::move(file));
   }
 
-  return std::make_unique<YuvFileGenerator>(files, width, height,
-                                            frame_repeat_count);
+  return std::make_unique<MappedYuvFileGenerator>(std::move(files), width,
+                                                  height, frame_repeat_count);
 }
 
 std::unique_ptr<FrameGeneratorInterface> CreateFromIvfFileFrameGenerator(
     std::string filename) {
-  return std::make_unique<IvfVideoFrameGenerator>(std::move(filename));
+  return std::make_unique<PrefetchingIvfVideoFrameGenerator>(
+      std::move(filename), PrefetchingIvfVideoFrameGenerator::kDefaultQueueSize);
 }
 
 std::unique_ptr<FrameGeneratorInterface>
@@ -41,7 +41,8 @@ std::unique_ptr<FrameGeneratorInterface> CreateFromYuvFileFrameGenerator(
     size_t height,
     int frame_repeat_count);
 
-// Creates a frame generator that repeatedly plays an ivf file.
+// Creates a frame generator that repeatedly plays an ivf file. Frames are
+// read and decoded ahead of time on a background thread.
 std::unique_ptr<FrameGeneratorInterface> CreateFromIvfFileFrameGenerator(
     std::string filename);
 
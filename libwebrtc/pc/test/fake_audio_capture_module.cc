@@ -12,9 +12,12 @@
 
 #include <string.h>
 
+#include <utility>
+
 #include "rtc_base/checks.h"
 #include "rtc_base/location.h"
 #include "rtc_base/ref_counted_object.h"
+#include "rtc_base/task_utils/to_queued_task.h"
 #include "rtc_base/thread.h"
 #include "rtc_base/time_utils.h"
 
@@ -52,6 +55,8 @@ FakeAudioCaptureModule::FakeAudioCaptureModule()
 }
 
 FakeAudioCaptureModule::~FakeAudioCaptureModule() {
+  // Waits for a running task, which uses the members.
+  process_queue_.reset();
   if (process_thread_) {
     process_thread_->Stop();
   }
@@ -65,11 +70,27 @@ rtc::scoped_refptr<FakeAudioCaptureModule> FakeAudioCaptureModule::Create() {
   return capture_module;
 }
 
+rtc::scoped_refptr<FakeAudioCaptureModule> FakeAudioCaptureModule::Create(
+    webrtc::TaskQueueFactory* task_queue_factory) {
+  auto capture_module = rtc::make_ref_counted<FakeAudioCaptureModule>();
+  capture_module->task_queue_factory_ = task_queue_factory;
+  if (!capture_module->Initialize()) {
+    return nullptr;
+  }
+  return capture_module;
+}
+
 int FakeAudioCaptureModule::frames_received() const {
   webrtc::MutexLock lock(&mutex_);
   return frames_received_;
 }
 
+void FakeAudioCaptureModule::SetProcessThreadStartedCallback(
+    std::function<void()> callback) {
+  webrtc::MutexLock lock(&mutex_);
+  process_thread_started_callback_ = std::move(callback);
+}
+
 int32_t FakeAudioCaptureModule::ActiveAudioLayer(
     AudioLayer* /*audio_layer*/) const {
   RTC_NOTREACHED();
@@ -439,13 +460,23 @@ bool FakeAudioCaptureModule::ShouldStartProcessing() {
 }
 
 void FakeAudioCaptureModule::UpdateProcessing(bool start) {
-  if (start) {
+  if (start && task_queue_factory_) {
+    if (!process_queue_) {
+      process_queue_ = task_queue_factory_->CreateTaskQueue(
+          "fake_audio_module", webrtc::TaskQueueFactory::Priority::HIGH);
+    }
+    process_queue_->PostTask(webrtc::ToQueuedTask([this] { StartProcessP(); }));
+  } else if (start) {
     if (!process_thread_) {
       process_thread_ = rtc::Thread::Create();
       process_thread_->Start();
     }
     process_thread_->Post(RTC_FROM_HERE, this, MSG_START_PROCESS);
   } else {
+    if (process_queue_) {
+      process_queue_.reset();
+      process_thread_checker_.Detach();
+    }
     if (process_thread_) {
       process_thread_->Stop();
       process_thread_.reset(nullptr);
@@ -458,13 +489,17 @@ void FakeAudioCaptureModule::UpdateProcessing(bool start) {
 
 void FakeAudioCaptureModule::StartProcessP() {
   RTC_DCHECK_RUN_ON(&process_thread_checker_);
+  std::function<void()> started_callback;
   {
     webrtc::MutexLock lock(&mutex_);
     if (started_) {
       // Already started.
       return;
     }
+    started_callback = process_thread_started_callback_;
   }
+  if (started_callback)
+    started_callback();
   ProcessFrameP();
 }
 
@@ -490,7 +525,15 @@ void FakeAudioCaptureModule::ProcessFrameP() {
   const int64_t current_time = rtc::TimeMillis();
   const int64_t wait_time =
       (next_frame_time_ > current_time) ? next_frame_time_ - current_time : 0;
-  process_thread_->PostDelayed(RTC_FROM_HERE, wait_time, this, MSG_RUN_PROCESS);
+  if (task_queue_factory_) {
+    // Not process_queue_, which UpdateProcessing() may be resetting.
+    webrtc::TaskQueueBase::Current()->PostDelayedTask(
+        webrtc::ToQueuedTask([this] { ProcessFrameP(); }),
+        static_cast<uint32_t>(wait_time));
+  } else {
+    process_thread_->PostDelayed(RTC_FROM_HERE, wait_time, this,
+                                 MSG_RUN_PROCESS);
+  }
 }
 
 void FakeAudioCaptureModule::ReceiveFrameP() {
@@ -23,10 +23,13 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
 #include <memory>
 
 #include "api/scoped_refptr.h"
 #include "api/sequence_checker.h"
+#include "api/task_queue/task_queue_base.h"
+#include "api/task_queue/task_queue_factory.h"
 #include "modules/audio_device/include/audio_device.h"
 #include "modules/audio_device/include/audio_device_defines.h"
 #include "rtc_base/message_handler.h"
@@ -51,12 +54,22 @@ class FakeAudioCaptureModule : public webrtc::AudioDeviceModule,
 
   // Creates a FakeAudioCaptureModule or returns NULL on failure.
   static rtc::scoped_refptr<FakeAudioCaptureModule> Create();
+  // Same, but pushes and pulls audio on a task queue of `task_queue_factory`,
+  // which must outlive the module, instead of on a thread of its own. Frames
+  // are still paced by rtc::TimeMillis().
+  static rtc::scoped_refptr<FakeAudioCaptureModule> Create(
+      webrtc::TaskQueueFactory* task_queue_factory);
 
   // Returns the number of frames that have been successfully pulled by the
   // instance. Note that correctly detecting success can only be done if the
   // pulled frame was generated/pushed from a FakeAudioCaptureModule.
   int frames_received() const RTC_LOCKS_EXCLUDED(mutex_);
 
+  // Runs `callback` on the thread pushing and pulling audio every time
+  // processing starts on it, e.g. to adjust the scheduling of that thread.
+  void SetProcessThreadStartedCallback(std::function<void()> callback)
+      RTC_LOCKS_EXCLUDED(mutex_);
+
   int32_t ActiveAudioLayer(AudioLayer* audio_layer) const override;
 
   // Note: Calling this method from a callback may result in deadlock.
@@ -198,6 +211,9 @@ class FakeAudioCaptureModule : public webrtc::AudioDeviceModule,
   // Callback for playout and recording.
   webrtc::AudioTransport* audio_callback_ RTC_GUARDED_BY(mutex_);
 
+  std::function<void()> process_thread_started_callback_
+      RTC_GUARDED_BY(mutex_);
+
   bool recording_ RTC_GUARDED_BY(
       mutex_);  // True when audio is being pushed from the instance.
   bool playing_ RTC_GUARDED_BY(
@@ -219,6 +235,11 @@ class FakeAudioCaptureModule : public webrtc::AudioDeviceModule,
 
   std::unique_ptr<rtc::Thread> process_thread_;
 
+  // Set when processing runs on process_queue_ rather than process_thread_.
+  webrtc::TaskQueueFactory* task_queue_factory_ = nullptr;
+  std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter>
+      process_queue_;
+
   // Buffer for storing samples received from the webrtc::AudioTransport.
   char rec_buffer_[kNumberSamples * kNumberBytesPerSample];
   // Buffer for samples to send to the webrtc::AudioTransport.
@@ -13,7 +13,9 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <limits>
 #include <memory>
+#include <utility>
 
 #include "api/video/i010_buffer.h"
 #include "api/video/nv12_buffer.h"
@@ -21,7 +23,9 @@
 #include "common_video/include/video_frame_buffer.h"
 #include "common_video/libyuv/include/webrtc_libyuv.h"
 #include "rtc_base/checks.h"
+#include "test/frame_generator_kernels.h"
 #include "test/frame_utils.h"
+#include "test/i420_buffer_pool.h"
 
 namespace webrtc {
 namespace test {
@@ -47,12 +51,14 @@ void SquareGenerator::ChangeResolution(size_t width, size_t height) {
 
 rtc::scoped_refptr<I420Buffer> SquareGenerator::CreateI420Buffer(int width,
                                                                  int height) {
-  rtc::scoped_refptr<I420Buffer> buffer(I420Buffer::Create(width, height));
-  memset(buffer->MutableDataY(), 127, height * buffer->StrideY());
-  memset(buffer->MutableDataU(), 127,
-         buffer->ChromaHeight() * buffer->StrideU());
-  memset(buffer->MutableDataV(), 127,
-         buffer->ChromaHeight() * buffer->StrideV());
+  rtc::scoped_refptr<I420Buffer> buffer(
+      I420BufferPool::Shared()->CreateI420Buffer(width, height));
+  FillRect(buffer->MutableDataY(), buffer->StrideY(), buffer->StrideY(), height,
+           127);
+  FillRect(buffer->MutableDataU(), buffer->StrideU(), buffer->StrideU(),
+           buffer->ChromaHeight(), 127);
+  FillRect(buffer->MutableDataV(), buffer->StrideV(), buffer->StrideV(),
+           buffer->ChromaHeight(), 127);
   return buffer;
 }
 
@@ -88,6 +94,8 @@ FrameGeneratorInterface::VideoFrameData SquareGenerator::NextFrame() {
   for (const auto& square : squares_)
     square->Draw(buffer);
 
+  // The I010 and NV12 conversions allocate a buffer per frame; only the I420
+  // formats used by the broadcaster are pooled.
   if (type_ == OutputType::kI010) {
     buffer = I010Buffer::Copy(*buffer->ToI420());
   } else if (type_ == OutputType::kNV12) {
@@ -116,31 +124,27 @@ void SquareGenerator::Square::Draw(
   int length = std::min(length_, length_cap);
   x_ = (x_ + random_generator_.Rand(0, 4)) % (buffer->width() - length);
   y_ = (y_ + random_generator_.Rand(0, 4)) % (buffer->height() - length);
-  for (int y = y_; y < y_ + length; ++y) {
-    uint8_t* pos_y =
-        (const_cast<uint8_t*>(buffer->DataY()) + x_ + y * buffer->StrideY());
-    memset(pos_y, yuv_y_, length);
-  }
-
-  for (int y = y_; y < y_ + length; y = y + 2) {
-    uint8_t* pos_u = (const_cast<uint8_t*>(buffer->DataU()) + x_ / 2 +
-                      y / 2 * buffer->StrideU());
-    memset(pos_u, yuv_u_, length / 2);
-    uint8_t* pos_v = (const_cast<uint8_t*>(buffer->DataV()) + x_ / 2 +
-                      y / 2 * buffer->StrideV());
-    memset(pos_v, yuv_v_, length / 2);
-  }
+  FillRect(const_cast<uint8_t*>(buffer->DataY()) + x_ + y_ * buffer->StrideY(),
+           buffer->StrideY(), length, length, yuv_y_);
+
+  // Chroma rows y_ / 2 .. (y_ + length - 1) / 2, as the per-row loop this
+  // replaces visited them.
+  const int chroma_rows = (length + 1) / 2;
+  FillRect(const_cast<uint8_t*>(buffer->DataU()) + x_ / 2 +
+               y_ / 2 * buffer->StrideU(),
+           buffer->StrideU(), length / 2, chroma_rows, yuv_u_);
+  FillRect(const_cast<uint8_t*>(buffer->DataV()) + x_ / 2 +
+               y_ / 2 * buffer->StrideV(),
+           buffer->StrideV(), length / 2, chroma_rows, yuv_v_);
 
   if (frame_buffer->type() == VideoFrameBuffer::Type::kI420)
     return;
 
   // Optionally draw on alpha plane if given.
   const webrtc::I420ABufferInterface* yuva_buffer = frame_buffer->GetI420A();
-  for (int y = y_; y < y_ + length; ++y) {
-    uint8_t* pos_y = (const_cast<uint8_t*>(yuva_buffer->DataA()) + x_ +
-                      y * yuva_buffer->StrideA());
-    memset(pos_y, yuv_a_, length);
-  }
+  FillRect(const_cast<uint8_t*>(yuva_buffer->DataA()) + x_ +
+               y_ * yuva_buffer->StrideA(),
+           yuva_buffer->StrideA(), length, length, yuv_a_);
 }
 
 YuvFileGenerator::YuvFileGenerator(std::vector<FILE*> files,
@@ -205,6 +209,77 @@ bool YuvFileGenerator::ReadNextFrame() {
   return frame_index_ != prev_frame_index || file_index_ != prev_file_index;
 }
 
+MappedYuvFileGenerator::MappedYuvFileGenerator(
+    std::vector<rtc::scoped_refptr<MemoryMappedFile>> files,
+    size_t width,
+    size_t height,
+    int frame_repeat_count)
+    : files_(std::move(files)),
+      width_(static_cast<int>(width)),
+      height_(static_cast<int>(height)),
+      chroma_width_((width_ + 1) / 2),
+      chroma_height_((height_ + 1) / 2),
+      frame_size_(CalcBufferSize(VideoType::kI420, width_, height_)),
+      frame_display_count_(frame_repeat_count),
+      current_display_count_(0),
+      file_index_(0),
+      frame_index_(std::numeric_limits<size_t>::max()) {
+  RTC_DCHECK_GT(width, 0);
+  RTC_DCHECK_GT(height, 0);
+  RTC_DCHECK_GT(frame_repeat_count, 0);
+  size_t total_frames = 0;
+  for (size_t i = 0; i < files_.size(); ++i)
+    total_frames += FrameCount(i);
+  RTC_CHECK_GT(total_frames, 0) << "No complete " << width << "x" << height
+                                << " frame in the given files.";
+}
+
+FrameGeneratorInterface::VideoFrameData MappedYuvFileGenerator::NextFrame() {
+  // Empty update by default.
+  VideoFrame::UpdateRect update_rect{0, 0, 0, 0};
+  if (current_display_count_ == 0) {
+    if (WrapNextFrame())
+      update_rect = VideoFrame::UpdateRect{0, 0, width_, height_};
+  }
+  if (++current_display_count_ >= frame_display_count_)
+    current_display_count_ = 0;
+
+  return VideoFrameData(last_frame_buffer_, update_rect);
+}
+
+bool MappedYuvFileGenerator::WrapNextFrame() {
+  // Frames prefetched past the one being wrapped.
+  constexpr size_t kReadaheadFrames = 4;
+
+  const size_t prev_frame_index = frame_index_;
+  const size_t prev_file_index = file_index_;
+  // Starts at max, so the first call lands on frame 0 of the first file.
+  ++frame_index_;
+  while (frame_index_ >= FrameCount(file_index_)) {
+    frame_index_ = 0;
+    file_index_ = (file_index_ + 1) % files_.size();
+  }
+
+  const rtc::scoped_refptr<MemoryMappedFile>& file = files_[file_index_];
+  const size_t offset = frame_index_ * frame_size_;
+  file->WillNeed(offset + frame_size_, kReadaheadFrames * frame_size_);
+
+  const uint8_t* data_y = file->data() + offset;
+  const uint8_t* data_u = data_y + width_ * height_;
+  const uint8_t* data_v = data_u + chroma_width_ * chroma_height_;
+  // The release callback holds a reference so the mapping outlives every
+  // frame taken from it.
+  last_frame_buffer_ =
+      WrapI420Buffer(width_, height_, data_y, width_, data_u, chroma_width_,
+                     data_v, chroma_width_, [file] {});
+  return frame_index_ != prev_frame_index || file_index_ != prev_file_index;
+}
+
+size_t MappedYuvFileGenerator::FrameCount(size_t file_index) const {
+  // A trailing partial frame is ignored, as ReadI420Buffer() does.
+  return files_[file_index]->size() / frame_size_;
+}
+
 SlideGenerator::SlideGenerator(int width, int height, int frame_repeat_count)
     : width_(width),
       height_(height),
@@ -230,12 +305,15 @@ void SlideGenerator::GenerateNewFrame() {
   // to simulate variation in the slides' complexity.
   const int kSquareNum = 1 << (4 + (random_generator_.Rand(0, 3) * 2));
 
-  buffer_ = I420Buffer::Create(width_, height_);
-  memset(buffer_->MutableDataY(), 127, height_ * buffer_->StrideY());
-  memset(buffer_->MutableDataU(), 127,
-         buffer_->ChromaHeight() * buffer_->StrideU());
-  memset(buffer_->MutableDataV(), 127,
-         buffer_->ChromaHeight() * buffer_->StrideV());
+  // Drop the previous slide first so its buffer can be recycled right away.
+  buffer_ = nullptr;
+  buffer_ = I420BufferPool::Shared()->CreateI420Buffer(width_, height_);
+  FillRect(buffer_->MutableDataY(), buffer_->StrideY(), buffer_->StrideY(),
+           height_, 127);
+  FillRect(buffer_->MutableDataU(), buffer_->StrideU(), buffer_->StrideU(),
+           buffer_->ChromaHeight(), 127);
+  FillRect(buffer_->MutableDataV(), buffer_->StrideV(), buffer_->StrideV(),
+           buffer_->ChromaHeight(), 127);
 
   for (int i = 0; i < kSquareNum; ++i) {
     int length = random_generator_.Rand(1, width_ > 4 ? width_ / 4 : 1);
@@ -249,18 +327,13 @@ void SlideGenerator::GenerateNewFrame() {
     uint8_t yuv_u = random_generator_.Rand(0, 255);
     uint8_t yuv_v = random_generator_.Rand(0, 255);
 
-    for (int yy = y; yy < y + length; ++yy) {
-      uint8_t* pos_y = (buffer_->MutableDataY() + x + yy * buffer_->StrideY());
-      memset(pos_y, yuv_y, length);
-    }
-    for (int yy = y; yy < y + length; yy += 2) {
-      uint8_t* pos_u =
-          (buffer_->MutableDataU() + x / 2 + yy / 2 * buffer_->StrideU());
-      memset(pos_u, yuv_u, length / 2);
-      uint8_t* pos_v =
-          (buffer_->MutableDataV() + x / 2 + yy / 2 * buffer_->StrideV());
-      memset(pos_v, yuv_v, length / 2);
-    }
+    FillRect(buffer_->MutableDataY() + x + y * buffer_->StrideY(),
+             buffer_->StrideY(), length, length, yuv_y);
+    const int chroma_rows = (length + 1) / 2;
+    FillRect(buffer_->MutableDataU() + x / 2 + y / 2 * buffer_->StrideU(),
+             buffer_->StrideU(), length / 2, chroma_rows, yuv_u);
+    FillRect(buffer_->MutableDataV() + x / 2 + y / 2 * buffer_->StrideV(),
+             buffer_->StrideV(), length / 2, chroma_rows, yuv_v);
   }
 }
 
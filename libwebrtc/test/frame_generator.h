@@ -23,6 +23,7 @@
 #include "rtc_base/random.h"
 #include "rtc_base/synchronization/mutex.h"
 #include "system_wrappers/include/clock.h"
+#include "test/testsupport/memory_mapped_file.h"
 
 namespace webrtc {
 namespace test {
@@ -38,6 +39,7 @@ class SquareGenerator : public FrameGeneratorInterface {
   VideoFrameData NextFrame() override;
 
  private:
+  // Returns a gray buffer taken from the shared I420BufferPool.
   rtc::scoped_refptr<I420Buffer> CreateI420Buffer(int width, int height);
 
   class Square {
@@ -95,6 +97,42 @@ class YuvFileGenerator : public FrameGeneratorInterface {
   rtc::scoped_refptr<I420Buffer> last_read_buffer_;
 };
 
+// MappedYuvFileGenerator plays the same kind of raw I420 files as
+// YuvFileGenerator, but maps them into memory and hands out frames that point
+// straight into the mapping instead of reading each one into a new buffer.
+// The upcoming frames are prefetched so that playback does not stall on disk.
+class MappedYuvFileGenerator : public FrameGeneratorInterface {
+ public:
+  MappedYuvFileGenerator(
+      std::vector<rtc::scoped_refptr<MemoryMappedFile>> files,
+      size_t width,
+      size_t height,
+      int frame_repeat_count);
+
+  VideoFrameData NextFrame() override;
+  void ChangeResolution(size_t width, size_t height) override {
+    RTC_NOTREACHED();
+  }
+
+ private:
+  // Returns true if a different frame than the previous one was wrapped.
+  // False only in case of a single frame in total.
+  bool WrapNextFrame();
+  size_t FrameCount(size_t file_index) const;
+
+  const std::vector<rtc::scoped_refptr<MemoryMappedFile>> files_;
+  const int width_;
+  const int height_;
+  const int chroma_width_;
+  const int chroma_height_;
+  const size_t frame_size_;
+  const int frame_display_count_;
+  int current_display_count_;
+  size_t file_index_;
+  size_t frame_index_;
+  rtc::scoped_refptr<VideoFrameBuffer> last_frame_buffer_;
+};
+
 // SlideGenerator works similarly to YuvFileGenerator but it fills the frames
 // with randomly sized and colored squares instead of reading their content
 // from files.
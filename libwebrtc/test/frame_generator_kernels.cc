@@ -0,0 +1,253 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "test/frame_generator_kernels.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/system/arch.h"
+#include "rtc_base/time_utils.h"
+#include "system_wrappers/include/cpu_features_wrapper.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <emmintrin.h>
+#endif
+
+namespace webrtc {
+namespace test {
+namespace frame_kernels_impl {
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// Defined in frame_generator_kernels_avx2.cc.
+void FillRect_AVX2(uint8_t* dst,
+                   int stride,
+                   int width,
+                   int height,
+                   uint8_t value);
+void BlitRect_AVX2(const uint8_t* src,
+                   int src_stride,
+                   uint8_t* dst,
+                   int dst_stride,
+                   int width,
+                   int height);
+#endif
+
+}  // namespace frame_kernels_impl
+
+namespace {
+
+void FillRect_Scalar(uint8_t* dst,
+                     int stride,
+                     int width,
+                     int height,
+                     uint8_t value) {
+  for (int y = 0; y < height; ++y)
+    memset(dst + y * stride, value, width);
+}
+
+void BlitRect_Scalar(const uint8_t* src,
+                     int src_stride,
+                     uint8_t* dst,
+                     int dst_stride,
+                     int width,
+                     int height) {
+  for (int y = 0; y < height; ++y)
+    memcpy(dst + y * dst_stride, src + y * src_stride, width);
+}
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+void FillRect_SSE2(uint8_t* dst,
+                   int stride,
+                   int width,
+                   int height,
+                   uint8_t value) {
+  if (width >= kFrameKernelsLibcRowThreshold) {
+    FillRect_Scalar(dst, stride, width, height, value);
+    return;
+  }
+  const __m128i v = _mm_set1_epi8(static_cast<char>(value));
+  for (int y = 0; y < height; ++y) {
+    uint8_t* row = dst + y * stride;
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), v);
+    for (; x < width; ++x)
+      row[x] = value;
+  }
+}
+
+void BlitRect_SSE2(const uint8_t* src,
+                   int src_stride,
+                   uint8_t* dst,
+                   int dst_stride,
+                   int width,
+                   int height) {
+  if (width >= kFrameKernelsLibcRowThreshold) {
+    BlitRect_Scalar(src, src_stride, dst, dst_stride, width, height);
+    return;
+  }
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* src_row = src + y * src_stride;
+    uint8_t* dst_row = dst + y * dst_stride;
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dst_row + x),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x)));
+    }
+    for (; x < width; ++x)
+      dst_row[x] = src_row[x];
+  }
+}
+#endif
+
+const FrameKernels kScalarKernels = {FrameKernelIsa::kScalar, "scalar",
+                                     &FillRect_Scalar, &BlitRect_Scalar};
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+const FrameKernels kSse2Kernels = {FrameKernelIsa::kSse2, "sse2",
+                                   &FillRect_SSE2, &BlitRect_SSE2};
+const FrameKernels kAvx2Kernels = {FrameKernelIsa::kAvx2, "avx2",
+                                   &frame_kernels_impl::FillRect_AVX2,
+                                   &frame_kernels_impl::BlitRect_AVX2};
+#endif
+
+const FrameKernels& SelectFrameKernels() {
+  for (FrameKernelIsa isa : {FrameKernelIsa::kAvx2, FrameKernelIsa::kSse2}) {
+    if (const FrameKernels* kernels = GetFrameKernels(isa))
+      return *kernels;
+  }
+  return kScalarKernels;
+}
+
+template <typename Workload>
+double MeasureMegapixelsPerSecond(int64_t pixels_per_run,
+                                  int iterations,
+                                  Workload workload) {
+  // One untimed run to fault in the planes.
+  workload();
+  const int64_t start_ns = rtc::TimeNanos();
+  for (int i = 0; i < iterations; ++i)
+    workload();
+  const int64_t elapsed_ns = std::max<int64_t>(rtc::TimeNanos() - start_ns, 1);
+  return static_cast<double>(pixels_per_run) * iterations * 1000.0 /
+         elapsed_ns;
+}
+
+}  // namespace
+
+void FillRect(uint8_t* dst, int stride, int width, int height, uint8_t value) {
+  RTC_DCHECK_GE(stride, width);
+  ActiveFrameKernels().fill_rect(dst, stride, width, height, value);
+}
+
+void BlitRect(const uint8_t* src,
+              int src_stride,
+              uint8_t* dst,
+              int dst_stride,
+              int width,
+              int height) {
+  RTC_DCHECK_GE(src_stride, width);
+  RTC_DCHECK_GE(dst_stride, width);
+  ActiveFrameKernels().blit_rect(src, src_stride, dst, dst_stride, width,
+                                 height);
+}
+
+const FrameKernels* GetFrameKernels(FrameKernelIsa isa) {
+  switch (isa) {
+    case FrameKernelIsa::kScalar:
+      return &kScalarKernels;
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    case FrameKernelIsa::kSse2:
+      return GetCPUInfo(kSSE2) != 0 ? &kSse2Kernels : nullptr;
+    case FrameKernelIsa::kAvx2:
+      return GetCPUInfo(kAVX2) != 0 ? &kAvx2Kernels : nullptr;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+const FrameKernels& ActiveFrameKernels() {
+  static const FrameKernels& kernels = SelectFrameKernels();
+  return kernels;
+}
+
+std::vector<FrameKernelBenchmarkResult> BenchmarkFrameKernels(int width,
+                                                              int height,
+                                                              int iterations) {
+  RTC_CHECK_GE(width, kBenchmarkSquareSize);
+  RTC_CHECK_GE(height, kBenchmarkSquareSize);
+  RTC_CHECK_GT(iterations, 0);
+
+  std::vector<uint8_t> src(static_cast<size_t>(width) * height, 127);
+  std::vector<uint8_t> dst(static_cast<size_t>(width) * height, 0);
+  const int squares_x = width / kBenchmarkSquareSize;
+  const int squares_y = height / kBenchmarkSquareSize;
+  const int64_t plane_pixels = static_cast<int64_t>(width) * height;
+  const int64_t square_pixels = static_cast<int64_t>(squares_x) * squares_y *
+                                kBenchmarkSquareSize * kBenchmarkSquareSize;
+
+  std::vector<FrameKernelBenchmarkResult> results;
+  for (FrameKernelIsa isa : {FrameKernelIsa::kScalar, FrameKernelIsa::kSse2,
+                             FrameKernelIsa::kAvx2}) {
+    const FrameKernels* kernels = GetFrameKernels(isa);
+    if (!kernels)
+      continue;
+
+    auto add_result = [&](const char* kernel, double mpps) {
+      FrameKernelBenchmarkResult result;
+      result.isa = kernels->name;
+      result.kernel = kernel;
+      result.megapixels_per_second = mpps;
+      results.push_back(result);
+    };
+
+    add_result("fill_plane",
+               MeasureMegapixelsPerSecond(plane_pixels, iterations, [&] {
+                 kernels->fill_rect(dst.data(), width, width, height, 42);
+               }));
+    add_result("fill_squares",
+               MeasureMegapixelsPerSecond(square_pixels, iterations, [&] {
+                 for (int sy = 0; sy < squares_y; ++sy) {
+                   for (int sx = 0; sx < squares_x; ++sx) {
+                     kernels->fill_rect(
+                         dst.data() + sy * kBenchmarkSquareSize * width +
+                             sx * kBenchmarkSquareSize,
+                         width, kBenchmarkSquareSize, kBenchmarkSquareSize,
+                         static_cast<uint8_t>(sx + sy));
+                   }
+                 }
+               }));
+    add_result("blit_plane",
+               MeasureMegapixelsPerSecond(plane_pixels, iterations, [&] {
+                 kernels->blit_rect(src.data(), width, dst.data(), width,
+                                    width, height);
+               }));
+    add_result("blit_squares",
+               MeasureMegapixelsPerSecond(square_pixels, iterations, [&] {
+                 for (int sy = 0; sy < squares_y; ++sy) {
+                   for (int sx = 0; sx < squares_x; ++sx) {
+                     const int offset = sy * kBenchmarkSquareSize * width +
+                                        sx * kBenchmarkSquareSize;
+                     kernels->blit_rect(src.data() + offset, width,
+                                        dst.data() + offset, width,
+                                        kBenchmarkSquareSize,
+                                        kBenchmarkSquareSize);
+                   }
+                 }
+               }));
+  }
+  return results;
+}
+
+}  // namespace test
+}  // namespace webrtc
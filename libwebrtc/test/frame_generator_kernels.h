@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef TEST_FRAME_GENERATOR_KERNELS_H_
+#define TEST_FRAME_GENERATOR_KERNELS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace webrtc {
+namespace test {
+
+// Pixel kernels used by the synthetic frame generators. All kernels work on a
+// single 8-bit plane; the best implementation for the running CPU is picked
+// once, on first use.
+
+// Sets a `width` x `height` rectangle starting at `dst` to `value`.
+void FillRect(uint8_t* dst, int stride, int width, int height, uint8_t value);
+
+// Copies a `width` x `height` rectangle from `src` to `dst`.
+void BlitRect(const uint8_t* src,
+              int src_stride,
+              uint8_t* dst,
+              int dst_stride,
+              int width,
+              int height);
+
+// Rows at least this wide are handed to memset()/memcpy() by the vector
+// kernels: libc already uses wide (and, for big planes, non-temporal) stores
+// there, and the hand-written loops only pay off for the short rows of the
+// squares the generators draw.
+constexpr int kFrameKernelsLibcRowThreshold = 512;
+
+enum class FrameKernelIsa { kScalar, kSse2, kAvx2 };
+
+struct FrameKernels {
+  FrameKernelIsa isa;
+  const char* name;
+  void (*fill_rect)(uint8_t* dst,
+                    int stride,
+                    int width,
+                    int height,
+                    uint8_t value);
+  void (*blit_rect)(const uint8_t* src,
+                    int src_stride,
+                    uint8_t* dst,
+                    int dst_stride,
+                    int width,
+                    int height);
+};
+
+// Returns the kernels for `isa`, or nullptr if they are not compiled in or
+// not supported by the running CPU.
+const FrameKernels* GetFrameKernels(FrameKernelIsa isa);
+
+// Returns the kernels FillRect() and BlitRect() dispatch to.
+const FrameKernels& ActiveFrameKernels();
+
+struct FrameKernelBenchmarkResult {
+  std::string isa;
+  std::string kernel;
+  double megapixels_per_second = 0;
+};
+
+// Side of the squares used by the "square" benchmark workloads; about the
+// average size SquareGenerator draws at 720p.
+constexpr int kBenchmarkSquareSize = 64;
+
+// Runs every supported kernel variant over a `width` x `height` plane, both
+// as whole-plane operations and as the small squares the generators draw,
+// and reports the throughput of each. `width` and `height` must be at least
+// kBenchmarkSquareSize and `iterations` positive.
+std::vector<FrameKernelBenchmarkResult> BenchmarkFrameKernels(int width,
+                                                              int height,
+                                                              int iterations);
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_FRAME_GENERATOR_KERNELS_H_
@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "test/frame_generator_kernels.h"
+
+// Only called after a runtime AVX2 check, so allow GCC/Clang to emit AVX2
+// for these functions without building the whole target with -mavx2. MSVC
+// accepts the intrinsics without extra flags.
+#if defined(__GNUC__) || defined(__clang__)
+#define FRAME_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FRAME_KERNELS_TARGET_AVX2
+#endif
+
+namespace webrtc {
+namespace test {
+namespace frame_kernels_impl {
+
+FRAME_KERNELS_TARGET_AVX2 void FillRect_AVX2(uint8_t* dst,
+                                             int stride,
+                                             int width,
+                                             int height,
+                                             uint8_t value) {
+  if (width >= kFrameKernelsLibcRowThreshold) {
+    for (int y = 0; y < height; ++y)
+      memset(dst + y * stride, value, width);
+    return;
+  }
+  const __m256i v = _mm256_set1_epi8(static_cast<char>(value));
+  const __m128i v128 = _mm256_castsi256_si128(v);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* row = dst + y * stride;
+    int x = 0;
+    for (; x + 32 <= width; x += 32)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), v);
+    if (x + 16 <= width) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), v128);
+      x += 16;
+    }
+    for (; x < width; ++x)
+      row[x] = value;
+  }
+}
+
+FRAME_KERNELS_TARGET_AVX2 void BlitRect_AVX2(const uint8_t* src,
+                                             int src_stride,
+                                             uint8_t* dst,
+                                             int dst_stride,
+                                             int width,
+                                             int height) {
+  if (width >= kFrameKernelsLibcRowThreshold) {
+    for (int y = 0; y < height; ++y)
+      memcpy(dst + y * dst_stride, src + y * src_stride, width);
+    return;
+  }
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* src_row = src + y * src_stride;
+    uint8_t* dst_row = dst + y * dst_stride;
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(dst_row + x),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src_row + x)));
+    }
+    if (x + 16 <= width) {
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dst_row + x),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x)));
+      x += 16;
+    }
+    for (; x < width; ++x)
+      dst_row[x] = src_row[x];
+  }
+}
+
+}  // namespace frame_kernels_impl
+}  // namespace test
+}  // namespace webrtc
+
+#undef FRAME_KERNELS_TARGET_AVX2
+
+#endif  // defined(WEBRTC_ARCH_X86_FAMILY)
+
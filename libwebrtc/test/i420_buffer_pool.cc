@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "test/i420_buffer_pool.h"
+
+#include <utility>
+
+#include "rtc_base/checks.h"
+
+namespace webrtc {
+namespace test {
+
+I420BufferPool::I420BufferPool(size_t max_number_of_buffers)
+    : max_number_of_buffers_(max_number_of_buffers),
+      use_count_(0),
+      hits_(0),
+      misses_(0) {
+  RTC_DCHECK_GT(max_number_of_buffers, 0);
+}
+
+I420BufferPool::~I420BufferPool() = default;
+
+I420BufferPool* I420BufferPool::Shared() {
+  // Intentionally leaked: buffers handed out by the pool may outlive static
+  // destruction when tracks are torn down late.
+  static I420BufferPool* const pool =
+      new I420BufferPool(kDefaultMaxNumberOfBuffers);
+  return pool;
+}
+
+rtc::scoped_refptr<I420Buffer> I420BufferPool::CreateI420Buffer(int width,
+                                                                 int height) {
+  RTC_DCHECK_GT(width, 0);
+  RTC_DCHECK_GT(height, 0);
+  MutexLock lock(&mutex_);
+
+  // A buffer referenced only by the pool cannot be referenced by anyone else
+  // until we hand it out again, so checking HasOneRef() under the lock is
+  // enough to reuse it safely.
+  Entry* least_recently_used = nullptr;
+  for (Entry& entry : buffers_) {
+    if (!entry.buffer->HasOneRef())
+      continue;
+    if (entry.buffer->width() == width && entry.buffer->height() == height) {
+      ++hits_;
+      entry.last_used = ++use_count_;
+      return entry.buffer;
+    }
+    if (!least_recently_used ||
+        entry.last_used < least_recently_used->last_used) {
+      least_recently_used = &entry;
+    }
+  }
+
+  ++misses_;
+  PooledBuffer buffer(new rtc::RefCountedObject<I420Buffer>(width, height));
+  // Generators and simulcast layers of other sizes keep their idle buffers
+  // until the pool is full; only then does the stalest one make room.
+  if (buffers_.size() < max_number_of_buffers_)
+    buffers_.push_back({buffer, ++use_count_});
+  else if (least_recently_used)
+    *least_recently_used = {buffer, ++use_count_};
+  return buffer;
+}
+
+I420BufferPool::Stats I420BufferPool::GetStats() const {
+  MutexLock lock(&mutex_);
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.pooled_buffers = buffers_.size();
+  for (const Entry& entry : buffers_)
+    stats.pooled_bytes += BufferBytes(*entry.buffer);
+  return stats;
+}
+
+void I420BufferPool::ResetStats() {
+  MutexLock lock(&mutex_);
+  hits_ = 0;
+  misses_ = 0;
+}
+
+void I420BufferPool::Release() {
+  MutexLock lock(&mutex_);
+  std::vector<Entry> in_use;
+  for (Entry& entry : buffers_) {
+    if (!entry.buffer->HasOneRef())
+      in_use.push_back(std::move(entry));
+  }
+  buffers_ = std::move(in_use);
+}
+
+size_t I420BufferPool::BufferBytes(const I420Buffer& buffer) {
+  return static_cast<size_t>(buffer.StrideY()) * buffer.height() +
+         static_cast<size_t>(buffer.StrideU()) * buffer.ChromaHeight() +
+         static_cast<size_t>(buffer.StrideV()) * buffer.ChromaHeight();
+}
+
+}  // namespace test
+}  // namespace webrtc
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef TEST_I420_BUFFER_POOL_H_
+#define TEST_I420_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "api/video/i420_buffer.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+namespace webrtc {
+namespace test {
+
+// I420BufferPool hands out I420 buffers and recycles them once every external
+// reference has been released, so that synthetic sources producing a frame
+// per tick do not hit the allocator in steady state. Unlike
+// VideoFrameBufferPool it may be used from any thread, which lets all frame
+// generators and capturers of the process share a single instance.
+//
+// Recycled buffers are returned with their previous content; callers are
+// expected to overwrite every pixel they care about.
+class I420BufferPool {
+ public:
+  struct Stats {
+    // Buffers served from the pool.
+    uint64_t hits = 0;
+    // Buffers that had to be allocated.
+    uint64_t misses = 0;
+    // Buffers currently owned by the pool, in use or free.
+    size_t pooled_buffers = 0;
+    size_t pooled_bytes = 0;
+  };
+
+  static constexpr size_t kDefaultMaxNumberOfBuffers = 256;
+
+  explicit I420BufferPool(size_t max_number_of_buffers);
+  ~I420BufferPool();
+
+  I420BufferPool(const I420BufferPool&) = delete;
+  I420BufferPool& operator=(const I420BufferPool&) = delete;
+
+  // Returns the process-wide pool used by the frame generators.
+  static I420BufferPool* Shared();
+
+  // Returns a buffer of the given size. The buffer goes back to the pool when
+  // the last reference to it is dropped. Buffers of several sizes are kept
+  // side by side; once the pool is full, a new buffer replaces the least
+  // recently used idle one. If every pooled buffer is in use an unpooled
+  // buffer is returned instead.
+  rtc::scoped_refptr<I420Buffer> CreateI420Buffer(int width, int height);
+
+  Stats GetStats() const;
+  void ResetStats();
+
+  // Frees all buffers that are not currently in use.
+  void Release();
+
+ private:
+  using PooledBuffer = rtc::scoped_refptr<rtc::RefCountedObject<I420Buffer>>;
+
+  struct Entry {
+    PooledBuffer buffer;
+    // Value of use_count_ when the buffer was last handed out.
+    uint64_t last_used;
+  };
+
+  static size_t BufferBytes(const I420Buffer& buffer);
+
+  const size_t max_number_of_buffers_;
+
+  mutable Mutex mutex_;
+  std::vector<Entry> buffers_ RTC_GUARDED_BY(mutex_);
+  uint64_t use_count_ RTC_GUARDED_BY(mutex_);
+  uint64_t hits_ RTC_GUARDED_BY(mutex_);
+  uint64_t misses_ RTC_GUARDED_BY(mutex_);
+};
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_I420_BUFFER_POOL_H_
@@ -0,0 +1,236 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "test/passthrough_audio_encoder_factory.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "api/audio_codecs/audio_encoder.h"
+#include "api/units/time_delta.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_counted_object.h"
+#include "test/testsupport/memory_mapped_file.h"
+
+namespace webrtc {
+namespace test {
+namespace {
+
+constexpr int kOpusSampleRateHz = 48000;
+constexpr size_t kPacketSizeFieldBytes = 2;
+
+// Returns the duration of an Opus packet in units of 2.5 ms, or 0 if the
+// packet is malformed (RFC 6716, section 3.1).
+size_t OpusPacketDurationIn2_5Ms(const uint8_t* packet, size_t size) {
+  if (size == 0)
+    return 0;
+  const int config = packet[0] >> 3;
+  size_t frame_duration;
+  if (config < 12) {
+    // SILK: 10, 20, 40 or 60 ms.
+    static const size_t kSilk[] = {4, 8, 16, 24};
+    frame_duration = kSilk[config % 4];
+  } else if (config < 16) {
+    // Hybrid: 10 or 20 ms.
+    frame_duration = config % 2 == 0 ? 4 : 8;
+  } else {
+    // CELT: 2.5, 5, 10 or 20 ms.
+    static const size_t kCelt[] = {1, 2, 4, 8};
+    frame_duration = kCelt[config % 4];
+  }
+  size_t frame_count;
+  switch (packet[0] & 0x03) {
+    case 0:
+      frame_count = 1;
+      break;
+    case 1:
+    case 2:
+      frame_count = 2;
+      break;
+    default:
+      if (size < 2)
+        return 0;
+      frame_count = packet[1] & 0x3F;
+      break;
+  }
+  return frame_duration * frame_count;
+}
+
+class PassthroughOpusEncoder : public AudioEncoder {
+ public:
+  PassthroughOpusEncoder(int payload_type,
+                         size_t num_channels,
+                         std::shared_ptr<const OpusPacketClip> clip)
+      : payload_type_(payload_type),
+        num_channels_(num_channels),
+        clip_(std::move(clip)) {}
+
+  int SampleRateHz() const override { return kOpusSampleRateHz; }
+  size_t NumChannels() const override { return num_channels_; }
+  size_t Num10MsFramesInNextPacket() const override {
+    return clip_->packets()[position_].num_10ms_frames;
+  }
+  size_t Max10MsFramesInAPacket() const override {
+    return clip_->max_10ms_frames();
+  }
+  int GetTargetBitrate() const override {
+    return clip_->average_bitrate_bps();
+  }
+  absl::optional<std::pair<TimeDelta, TimeDelta>> GetFrameLengthRange()
+      const override {
+    return {{TimeDelta::Millis(10 * clip_->min_10ms_frames()),
+             TimeDelta::Millis(10 * clip_->max_10ms_frames())}};
+  }
+  void Reset() override { buffered_10ms_frames_ = 0; }
+
+ protected:
+  EncodedInfo EncodeImpl(uint32_t rtp_timestamp,
+                         rtc::ArrayView<const int16_t> audio,
+                         rtc::Buffer* encoded) override {
+    if (buffered_10ms_frames_ == 0)
+      first_timestamp_in_packet_ = rtp_timestamp;
+    EncodedInfo info;
+    const OpusPacketClip::Packet& packet = clip_->packets()[position_];
+    if (++buffered_10ms_frames_ < packet.num_10ms_frames)
+      return info;
+
+    buffered_10ms_frames_ = 0;
+    position_ = (position_ + 1) % clip_->packets().size();
+    encoded->AppendData(packet.data);
+    info.encoded_bytes = packet.data.size();
+    info.encoded_timestamp = first_timestamp_in_packet_;
+    info.payload_type = payload_type_;
+    info.speech = true;
+    info.encoder_type = CodecType::kOpus;
+    return info;
+  }
+
+ private:
+  const int payload_type_;
+  const size_t num_channels_;
+  const std::shared_ptr<const OpusPacketClip> clip_;
+  size_t position_ = 0;
+  size_t buffered_10ms_frames_ = 0;
+  uint32_t first_timestamp_in_packet_ = 0;
+};
+
+class PassthroughAudioEncoderFactory : public AudioEncoderFactory {
+ public:
+  PassthroughAudioEncoderFactory(
+      std::shared_ptr<const OpusPacketClip> clip,
+      rtc::scoped_refptr<AudioEncoderFactory> fallback)
+      : clip_(std::move(clip)), fallback_(std::move(fallback)) {}
+
+  std::vector<AudioCodecSpec> GetSupportedEncoders() override {
+    return fallback_->GetSupportedEncoders();
+  }
+
+  absl::optional<AudioCodecInfo> QueryAudioEncoder(
+      const SdpAudioFormat& format) override {
+    if (!IsOpus(format))
+      return fallback_->QueryAudioEncoder(format);
+    AudioCodecInfo info(kOpusSampleRateHz, NumChannels(format),
+                        clip_->average_bitrate_bps());
+    info.allow_comfort_noise = false;
+    info.supports_network_adaption = false;
+    return info;
+  }
+
+  std::unique_ptr<AudioEncoder> MakeAudioEncoder(
+      int payload_type,
+      const SdpAudioFormat& format,
+      absl::optional<AudioCodecPairId> codec_pair_id) override {
+    if (!IsOpus(format)) {
+      return fallback_->MakeAudioEncoder(payload_type, format,
+                                         codec_pair_id);
+    }
+    return std::make_unique<PassthroughOpusEncoder>(
+        payload_type, NumChannels(format), clip_);
+  }
+
+ private:
+  static bool IsOpus(const SdpAudioFormat& format) {
+    return absl::EqualsIgnoreCase(format.name, "opus");
+  }
+
+  static size_t NumChannels(const SdpAudioFormat& format) {
+    // Opus is always negotiated with two channels; "stereo" tells whether
+    // the receiver wants them.
+    auto it = format.parameters.find("stereo");
+    return it != format.parameters.end() && it->second == "1" ? 2 : 1;
+  }
+
+  const std::shared_ptr<const OpusPacketClip> clip_;
+  const rtc::scoped_refptr<AudioEncoderFactory> fallback_;
+};
+
+}  // namespace
+
+std::unique_ptr<OpusPacketClip> OpusPacketClip::Load(const std::string& path) {
+  rtc::scoped_refptr<MemoryMappedFile> file = MemoryMappedFile::Open(path);
+  if (!file)
+    return nullptr;
+
+  std::unique_ptr<OpusPacketClip> clip(new OpusPacketClip());
+  size_t total_bytes = 0;
+  size_t total_10ms_frames = 0;
+  size_t offset = 0;
+  while (offset + kPacketSizeFieldBytes <= file->size()) {
+    const uint8_t* field = file->data() + offset;
+    const size_t packet_size = field[0] | (field[1] << 8);
+    offset += kPacketSizeFieldBytes;
+    if (packet_size == 0 || offset + packet_size > file->size())
+      break;
+    const uint8_t* data = file->data() + offset;
+    offset += packet_size;
+
+    const size_t duration = OpusPacketDurationIn2_5Ms(data, packet_size);
+    if (duration == 0 || duration % 4 != 0) {
+      RTC_LOG(LS_ERROR) << path << ": packet " << clip->packets_.size()
+                        << " is not a multiple of 10 ms";
+      return nullptr;
+    }
+    Packet packet;
+    packet.data.SetData(data, packet_size);
+    packet.num_10ms_frames = duration / 4;
+    total_bytes += packet_size;
+    total_10ms_frames += packet.num_10ms_frames;
+    clip->packets_.push_back(std::move(packet));
+  }
+  if (clip->packets_.empty()) {
+    RTC_LOG(LS_ERROR) << path << " holds no Opus packet";
+    return nullptr;
+  }
+
+  clip->min_10ms_frames_ = clip->max_10ms_frames_ =
+      clip->packets_.front().num_10ms_frames;
+  for (const Packet& packet : clip->packets_) {
+    clip->min_10ms_frames_ =
+        std::min(clip->min_10ms_frames_, packet.num_10ms_frames);
+    clip->max_10ms_frames_ =
+        std::max(clip->max_10ms_frames_, packet.num_10ms_frames);
+  }
+  clip->average_bitrate_bps_ =
+      static_cast<int>(total_bytes * 8 * 100 / total_10ms_frames);
+  return clip;
+}
+
+rtc::scoped_refptr<AudioEncoderFactory> CreatePassthroughAudioEncoderFactory(
+    const std::string& opus_file,
+    rtc::scoped_refptr<AudioEncoderFactory> fallback) {
+  std::shared_ptr<const OpusPacketClip> clip = OpusPacketClip::Load(opus_file);
+  RTC_CHECK(clip) << "Failed to load Opus packets: '" << opus_file << "'";
+  return rtc::make_ref_counted<PassthroughAudioEncoderFactory>(
+      std::move(clip), std::move(fallback));
+}
+
+}  // namespace test
+}  // namespace webrtc
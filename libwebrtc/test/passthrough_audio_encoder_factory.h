@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef TEST_PASSTHROUGH_AUDIO_ENCODER_FACTORY_H_
+#define TEST_PASSTHROUGH_AUDIO_ENCODER_FACTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "api/audio_codecs/audio_encoder_factory.h"
+#include "api/scoped_refptr.h"
+#include "rtc_base/buffer.h"
+
+namespace webrtc {
+namespace test {
+
+// Opus packets loaded from a raw file in which every packet is preceded by
+// its size as a 16-bit little endian integer. Packet durations are taken from
+// the TOC byte and must be multiples of 10 ms.
+class OpusPacketClip {
+ public:
+  struct Packet {
+    rtc::Buffer data;
+    // Duration in units of 10 ms.
+    size_t num_10ms_frames = 0;
+  };
+
+  // Returns nullptr if the file cannot be read or holds no usable packet.
+  static std::unique_ptr<OpusPacketClip> Load(const std::string& path);
+
+  const std::vector<Packet>& packets() const { return packets_; }
+  size_t min_10ms_frames() const { return min_10ms_frames_; }
+  size_t max_10ms_frames() const { return max_10ms_frames_; }
+  int average_bitrate_bps() const { return average_bitrate_bps_; }
+
+ private:
+  OpusPacketClip() = default;
+
+  std::vector<Packet> packets_;
+  size_t min_10ms_frames_ = 0;
+  size_t max_10ms_frames_ = 0;
+  int average_bitrate_bps_ = 0;
+};
+
+// AudioEncoderFactory that answers Opus with an encoder replaying an
+// OpusPacketClip in a loop, and forwards every other codec to `fallback`.
+// The captured audio is only used to pace the packets and stamp them with
+// RTP timestamps.
+rtc::scoped_refptr<AudioEncoderFactory> CreatePassthroughAudioEncoderFactory(
+    const std::string& opus_file,
+    rtc::scoped_refptr<AudioEncoderFactory> fallback);
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_PASSTHROUGH_AUDIO_ENCODER_FACTORY_H_
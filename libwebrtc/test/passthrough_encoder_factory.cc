@@ -0,0 +1,306 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "test/passthrough_encoder_factory.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "api/video/video_frame.h"
+#include "media/base/media_constants.h"
+#include "modules/video_coding/codecs/h264/include/h264.h"
+#include "modules/video_coding/include/video_codec_interface.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "test/testsupport/memory_mapped_file.h"
+
+namespace webrtc {
+namespace test {
+namespace {
+
+constexpr size_t kIvfFileHeaderSize = 32;
+constexpr size_t kIvfFrameHeaderSize = 12;
+constexpr int kDefaultFramerate = 30;
+
+uint16_t ReadLittleEndian16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t ReadLittleEndian32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+bool IsVp8Keyframe(const uint8_t* data, size_t size) {
+  // Bit 0 of the uncompressed data chunk is the inverse key frame flag.
+  return size > 0 && (data[0] & 0x01) == 0;
+}
+
+bool IsH264Keyframe(const uint8_t* data, size_t size) {
+  // Look for an IDR slice among the Annex B NAL units of the access unit.
+  constexpr uint8_t kIdrNaluType = 5;
+  for (size_t i = 0; i + 3 < size; ++i) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      if ((data[i + 3] & 0x1F) == kIdrNaluType)
+        return true;
+      i += 2;
+    }
+  }
+  return false;
+}
+
+class PassthroughEncoder : public VideoEncoder {
+ public:
+  explicit PassthroughEncoder(
+      std::vector<std::shared_ptr<const EncodedVideoClip>> clips)
+      : clips_(std::move(clips)) {}
+
+  int InitEncode(const VideoCodec* codec_settings,
+                 const Settings& settings) override {
+    RTC_DCHECK(codec_settings);
+    if (codec_settings->codecType != clips_.front()->codec_type())
+      return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+
+    MutexLock lock(&mutex_);
+    const size_t num_layers =
+        std::max<size_t>(1, codec_settings->numberOfSimulcastStreams);
+    layers_.assign(num_layers, Layer());
+    for (size_t i = 0; i < num_layers; ++i) {
+      layers_[i].clip = clips_[std::min(i, clips_.size() - 1)].get();
+      layers_[i].active = num_layers == 1 ||
+                          codec_settings->simulcastStream[i].active;
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterEncodeCompleteCallback(
+      EncodedImageCallback* callback) override {
+    MutexLock lock(&mutex_);
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override {
+    MutexLock lock(&mutex_);
+    layers_.clear();
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Encode(const VideoFrame& frame,
+                 const std::vector<VideoFrameType>* frame_types) override {
+    MutexLock lock(&mutex_);
+    if (!callback_ || layers_.empty())
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+
+    for (size_t i = 0; i < layers_.size(); ++i) {
+      Layer& layer = layers_[i];
+      if (!layer.active)
+        continue;
+      const bool keyframe_requested =
+          frame_types && i < frame_types->size() &&
+          (*frame_types)[i] == VideoFrameType::kVideoFrameKey;
+      if (keyframe_requested)
+        layer.position = layer.clip->KeyframeAtOrBefore(layer.position);
+
+      const EncodedVideoClip::Frame& clip_frame =
+          layer.clip->frames()[layer.position];
+      layer.position = (layer.position + 1) % layer.clip->frames().size();
+
+      EncodedImage image;
+      image.SetEncodedData(clip_frame.data);
+      image.SetTimestamp(frame.timestamp());
+      image.ntp_time_ms_ = frame.ntp_time_ms();
+      image.capture_time_ms_ = frame.render_time_ms();
+      image.rotation_ = frame.rotation();
+      image._encodedWidth = layer.clip->width();
+      image._encodedHeight = layer.clip->height();
+      image._frameType = clip_frame.is_keyframe
+                             ? VideoFrameType::kVideoFrameKey
+                             : VideoFrameType::kVideoFrameDelta;
+      if (layers_.size() > 1)
+        image.SetSpatialIndex(static_cast<int>(i));
+
+      CodecSpecificInfo info;
+      info.codecType = layer.clip->codec_type();
+      info.end_of_picture = true;
+      if (info.codecType == kVideoCodecVP8) {
+        info.codecSpecific.VP8.nonReference = false;
+        info.codecSpecific.VP8.temporalIdx = kNoTemporalIdx;
+        info.codecSpecific.VP8.layerSync = false;
+        info.codecSpecific.VP8.keyIdx = kNoKeyIdx;
+      } else {
+        info.codecSpecific.H264.packetization_mode =
+            H264PacketizationMode::NonInterleaved;
+        info.codecSpecific.H264.temporal_idx = kNoTemporalIdx;
+        info.codecSpecific.H264.base_layer_sync = false;
+        info.codecSpecific.H264.idr_frame = clip_frame.is_keyframe;
+      }
+      callback_->OnEncodedImage(image, &info);
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  void SetRates(const RateControlParameters& parameters) override {
+    MutexLock lock(&mutex_);
+    // Bitrates cannot be honoured, but layers the allocator switched off are
+    // not sent.
+    for (size_t i = 0; i < layers_.size(); ++i)
+      layers_[i].active = parameters.bitrate.GetSpatialLayerSum(i) > 0;
+  }
+
+  EncoderInfo GetEncoderInfo() const override {
+    EncoderInfo info;
+    info.implementation_name = "PassthroughEncoder";
+    info.supports_native_handle = true;
+    info.supports_simulcast = true;
+    // The output resolution is fixed by the clips.
+    info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+    return info;
+  }
+
+ private:
+  struct Layer {
+    const EncodedVideoClip* clip = nullptr;
+    size_t position = 0;
+    bool active = true;
+  };
+
+  const std::vector<std::shared_ptr<const EncodedVideoClip>> clips_;
+
+  Mutex mutex_;
+  EncodedImageCallback* callback_ RTC_GUARDED_BY(mutex_) = nullptr;
+  std::vector<Layer> layers_ RTC_GUARDED_BY(mutex_);
+};
+
+}  // namespace
+
+std::unique_ptr<EncodedVideoClip> EncodedVideoClip::Load(
+    const std::string& path) {
+  rtc::scoped_refptr<MemoryMappedFile> file = MemoryMappedFile::Open(path);
+  if (!file || file->size() < kIvfFileHeaderSize ||
+      memcmp(file->data(), "DKIF", 4) != 0) {
+    RTC_LOG(LS_ERROR) << path << " is not an IVF file";
+    return nullptr;
+  }
+  const uint8_t* header = file->data();
+  std::unique_ptr<EncodedVideoClip> clip(new EncodedVideoClip());
+  if (memcmp(header + 8, "VP80", 4) == 0) {
+    clip->codec_type_ = kVideoCodecVP8;
+  } else if (memcmp(header + 8, "H264", 4) == 0) {
+    clip->codec_type_ = kVideoCodecH264;
+  } else {
+    RTC_LOG(LS_ERROR) << path << " is neither VP8 nor H.264";
+    return nullptr;
+  }
+  clip->width_ = ReadLittleEndian16(header + 12);
+  clip->height_ = ReadLittleEndian16(header + 14);
+  const uint32_t rate = ReadLittleEndian32(header + 16);
+  const uint32_t scale = ReadLittleEndian32(header + 20);
+  clip->framerate_ = rate > 0 && scale > 0 && rate / scale > 0
+                         ? static_cast<int>(rate / scale)
+                         : kDefaultFramerate;
+
+  size_t offset = ReadLittleEndian16(header + 6);
+  while (offset + kIvfFrameHeaderSize <= file->size()) {
+    const size_t frame_size = ReadLittleEndian32(file->data() + offset);
+    offset += kIvfFrameHeaderSize;
+    if (frame_size == 0 || offset + frame_size > file->size())
+      break;
+    const uint8_t* data = file->data() + offset;
+    Frame frame;
+    frame.data = EncodedImageBuffer::Create(data, frame_size);
+    frame.is_keyframe = clip->codec_type_ == kVideoCodecVP8
+                            ? IsVp8Keyframe(data, frame_size)
+                            : IsH264Keyframe(data, frame_size);
+    clip->frames_.push_back(std::move(frame));
+    offset += frame_size;
+  }
+  if (clip->frames_.empty() || !clip->frames_.front().is_keyframe) {
+    RTC_LOG(LS_ERROR) << path << " does not start with a key frame";
+    return nullptr;
+  }
+  return clip;
+}
+
+size_t EncodedVideoClip::KeyframeAtOrBefore(size_t index) const {
+  RTC_DCHECK_LT(index, frames_.size());
+  while (index > 0 && !frames_[index].is_keyframe)
+    --index;
+  return index;
+}
+
+PassthroughEncoderFactory::PassthroughEncoderFactory(
+    const std::vector<std::string>& files) {
+  RTC_CHECK(!files.empty());
+  for (const std::string& file : files) {
+    std::unique_ptr<EncodedVideoClip> clip = EncodedVideoClip::Load(file);
+    RTC_CHECK(clip) << "Failed to load encoded clip: '" << file << "'";
+    RTC_CHECK(clips_.empty() ||
+              clips_.front()->codec_type() == clip->codec_type())
+        << "All clips must use the same codec";
+    clips_.push_back(std::move(clip));
+  }
+}
+
+PassthroughEncoderFactory::PassthroughEncoderFactory(
+    std::vector<std::shared_ptr<const EncodedVideoClip>> clips)
+    : clips_(std::move(clips)) {}
+
+PassthroughEncoderFactory::~PassthroughEncoderFactory() = default;
+
+std::unique_ptr<PassthroughEncoderFactory> PassthroughEncoderFactory::Clone()
+    const {
+  return std::unique_ptr<PassthroughEncoderFactory>(
+      new PassthroughEncoderFactory(clips_));
+}
+
+std::vector<SdpVideoFormat> PassthroughEncoderFactory::GetSupportedFormats()
+    const {
+  if (clips_.front()->codec_type() == kVideoCodecVP8)
+    return {SdpVideoFormat(cricket::kVp8CodecName)};
+  // The profile only matters for negotiation; the clip is sent as is.
+  return {CreateH264Format(H264::kProfileConstrainedBaseline, H264::kLevel3_1,
+                           "1"),
+          CreateH264Format(H264::kProfileConstrainedBaseline, H264::kLevel3_1,
+                           "0")};
+}
+
+std::unique_ptr<VideoEncoder> PassthroughEncoderFactory::CreateVideoEncoder(
+    const SdpVideoFormat& format) {
+  const char* codec_name = clips_.front()->codec_type() == kVideoCodecVP8
+                               ? cricket::kVp8CodecName
+                               : cricket::kH264CodecName;
+  if (!absl::EqualsIgnoreCase(format.name, codec_name)) {
+    RTC_LOG(LS_ERROR) << "Passthrough clips cannot be sent as " << format.name;
+    return nullptr;
+  }
+  return std::make_unique<PassthroughEncoder>(clips_);
+}
+
+int PassthroughEncoderFactory::width() const {
+  return clips_.back()->width();
+}
+
+int PassthroughEncoderFactory::height() const {
+  return clips_.back()->height();
+}
+
+int PassthroughEncoderFactory::framerate() const {
+  return clips_.back()->framerate();
+}
+
+}  // namespace test
+}  // namespace webrtc
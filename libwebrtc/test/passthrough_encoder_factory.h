@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef TEST_PASSTHROUGH_ENCODER_FACTORY_H_
+#define TEST_PASSTHROUGH_ENCODER_FACTORY_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "api/video/encoded_image.h"
+#include "api/video/video_codec_type.h"
+#include "api/video_codecs/sdp_video_format.h"
+#include "api/video_codecs/video_encoder.h"
+#include "api/video_codecs/video_encoder_factory.h"
+
+namespace webrtc {
+namespace test {
+
+// A VP8 or H.264 IVF file loaded into memory, with its key frames marked.
+class EncodedVideoClip {
+ public:
+  struct Frame {
+    rtc::scoped_refptr<EncodedImageBuffer> data;
+    bool is_keyframe = false;
+  };
+
+  // Returns nullptr if the file is not a readable VP8/H.264 IVF file or does
+  // not start with a key frame.
+  static std::unique_ptr<EncodedVideoClip> Load(const std::string& path);
+
+  VideoCodecType codec_type() const { return codec_type_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int framerate() const { return framerate_; }
+  const std::vector<Frame>& frames() const { return frames_; }
+
+  // Index of the last key frame at or before `index`.
+  size_t KeyframeAtOrBefore(size_t index) const;
+
+ private:
+  EncodedVideoClip() = default;
+
+  VideoCodecType codec_type_ = kVideoCodecGeneric;
+  int width_ = 0;
+  int height_ = 0;
+  int framerate_ = 0;
+  std::vector<Frame> frames_;
+};
+
+// VideoEncoderFactory whose encoders ignore the frames they are given and emit
+// the frames of pre-encoded clips instead, so that sending a stream costs
+// packetization only. Every simulcast layer replays its own clip, lowest
+// layer first; when fewer clips than layers are given, the last clip is used
+// for the remaining layers. Clips are loaded once and shared by all encoders.
+//
+// RTP timestamps and capture times are taken from the input frames, so the
+// stream is paced by whatever source feeds the track. Key frame requests
+// rewind a layer to its closest preceding key frame.
+class PassthroughEncoderFactory : public VideoEncoderFactory {
+ public:
+  // Crashes if a clip cannot be loaded or the clips use different codecs.
+  explicit PassthroughEncoderFactory(const std::vector<std::string>& files);
+  ~PassthroughEncoderFactory() override;
+
+  // Returns a factory replaying the same clips without loading them again,
+  // for use by another peer connection factory.
+  std::unique_ptr<PassthroughEncoderFactory> Clone() const;
+
+  std::vector<SdpVideoFormat> GetSupportedFormats() const override;
+  std::unique_ptr<VideoEncoder> CreateVideoEncoder(
+      const SdpVideoFormat& format) override;
+
+  // Resolution and frame rate of the top layer clip, which the source
+  // feeding the track should match.
+  int width() const;
+  int height() const;
+  int framerate() const;
+
+ private:
+  explicit PassthroughEncoderFactory(
+      std::vector<std::shared_ptr<const EncodedVideoClip>> clips);
+
+  std::vector<std::shared_ptr<const EncodedVideoClip>> clips_;
+};
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_PASSTHROUGH_ENCODER_FACTORY_H_
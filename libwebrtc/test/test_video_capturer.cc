@@ -16,6 +16,7 @@
 #include "api/video/i420_buffer.h"
 #include "api/video/video_frame_buffer.h"
 #include "api/video/video_rotation.h"
+#include "test/i420_buffer_pool.h"
 
 namespace webrtc {
 namespace test {
@@ -37,11 +38,11 @@ void TestVideoCapturer::OnFrame(const VideoFrame& original_frame) {
   }
 
   if (out_height != frame.height() || out_width != frame.width()) {
-    // Video adapter has requested a down-scale. Allocate a new buffer and
-    // return scaled version.
+    // Video adapter has requested a down-scale. Take a buffer from the pool
+    // and return scaled version.
     // For simplicity, only scale here without cropping.
     rtc::scoped_refptr<I420Buffer> scaled_buffer =
-        I420Buffer::Create(out_width, out_height);
+        I420BufferPool::Shared()->CreateI420Buffer(out_width, out_height);
     scaled_buffer->ScaleFrom(*frame.video_frame_buffer()->ToI420());
     VideoFrame::Builder new_frame_builder =
         VideoFrame::Builder()
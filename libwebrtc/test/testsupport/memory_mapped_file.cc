@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "test/testsupport/memory_mapped_file.h"
+
+#include <algorithm>
+
+#include "rtc_base/logging.h"
+
+#if defined(WEBRTC_WIN)
+#include <windows.h>
+
+#include "rtc_base/string_utils.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace webrtc {
+namespace test {
+namespace {
+
+#if defined(WEBRTC_WIN)
+// Mirrors WIN32_MEMORY_RANGE_ENTRY, which the SDK only declares when
+// targeting Windows 8 or later.
+struct MemoryRangeEntry {
+  void* virtual_address;
+  size_t number_of_bytes;
+};
+
+using PrefetchVirtualMemoryFunction = BOOL(WINAPI*)(HANDLE process,
+                                                   ULONG_PTR number_of_entries,
+                                                   MemoryRangeEntry* entries,
+                                                   ULONG flags);
+
+// PrefetchVirtualMemory() is missing on Windows 7; there the hint is skipped
+// and pages are faulted in on first access.
+PrefetchVirtualMemoryFunction GetPrefetchVirtualMemory() {
+  static const PrefetchVirtualMemoryFunction function =
+      reinterpret_cast<PrefetchVirtualMemoryFunction>(::GetProcAddress(
+          ::GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory"));
+  return function;
+}
+#endif
+
+}  // namespace
+
+rtc::scoped_refptr<MemoryMappedFile> MemoryMappedFile::Open(
+    const std::string& path) {
+#if defined(WEBRTC_WIN)
+  HANDLE file = ::CreateFileW(rtc::ToUtf16(path).c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    RTC_LOG(LS_ERROR) << "Failed to open " << path << ": " << ::GetLastError();
+    return nullptr;
+  }
+  LARGE_INTEGER file_size;
+  if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    RTC_LOG(LS_ERROR) << "Cannot map empty file " << path;
+    ::CloseHandle(file);
+    return nullptr;
+  }
+  HANDLE mapping =
+      ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  ::CloseHandle(file);
+  if (mapping == nullptr) {
+    RTC_LOG(LS_ERROR) << "Failed to map " << path << ": " << ::GetLastError();
+    return nullptr;
+  }
+  // The view keeps the mapping object alive.
+  void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  ::CloseHandle(mapping);
+  if (data == nullptr) {
+    RTC_LOG(LS_ERROR) << "Failed to map " << path << ": " << ::GetLastError();
+    return nullptr;
+  }
+  const size_t size = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    RTC_LOG_ERRNO(LS_ERROR) << "Failed to open " << path;
+    return nullptr;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    RTC_LOG(LS_ERROR) << "Cannot map empty file " << path;
+    ::close(fd);
+    return nullptr;
+  }
+  const size_t size = static_cast<size_t>(file_stat.st_size);
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file referenced.
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    RTC_LOG_ERRNO(LS_ERROR) << "Failed to map " << path;
+    return nullptr;
+  }
+  ::madvise(data, size, MADV_SEQUENTIAL);
+#endif
+  return rtc::scoped_refptr<MemoryMappedFile>(
+      new MemoryMappedFile(static_cast<const uint8_t*>(data), size));
+}
+
+MemoryMappedFile::MemoryMappedFile(const uint8_t* data, size_t size)
+    : data_(data), size_(size) {}
+
+MemoryMappedFile::~MemoryMappedFile() {
+#if defined(WEBRTC_WIN)
+  ::UnmapViewOfFile(data_);
+#else
+  ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+}
+
+void MemoryMappedFile::WillNeed(size_t offset, size_t length) const {
+  if (offset >= size_)
+    return;
+  length = std::min(length, size_ - offset);
+#if defined(WEBRTC_WIN)
+  PrefetchVirtualMemoryFunction prefetch = GetPrefetchVirtualMemory();
+  if (!prefetch)
+    return;
+  MemoryRangeEntry range = {const_cast<uint8_t*>(data_ + offset), length};
+  prefetch(::GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise() wants a page aligned start address.
+  static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  const size_t aligned_offset = offset - offset % page_size;
+  ::madvise(const_cast<uint8_t*>(data_ + aligned_offset),
+            length + (offset - aligned_offset), MADV_WILLNEED);
+#endif
+}
+
+}  // namespace test
+}  // namespace webrtc
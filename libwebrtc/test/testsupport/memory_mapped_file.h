@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TEST_TESTSUPPORT_MEMORY_MAPPED_FILE_H_
+#define TEST_TESTSUPPORT_MEMORY_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "api/ref_counted_base.h"
+#include "api/scoped_refptr.h"
+
+namespace webrtc {
+namespace test {
+
+// Read-only view of a whole file mapped into memory. The mapping is
+// reference counted so that frame buffers wrapping parts of it can keep it
+// alive after the generator that opened it is gone.
+class MemoryMappedFile : public rtc::RefCountedBase {
+ public:
+  // Returns nullptr if the file cannot be opened or is empty.
+  static rtc::scoped_refptr<MemoryMappedFile> Open(const std::string& path);
+
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Asks the OS to start reading `length` bytes at `offset` into the page
+  // cache, so that a later access does not block on disk. Ranges reaching
+  // past the end of the file are clamped.
+  void WillNeed(size_t offset, size_t length) const;
+
+ protected:
+  ~MemoryMappedFile() override;
+
+ private:
+  MemoryMappedFile(const uint8_t* data, size_t size);
+
+  const uint8_t* const data_;
+  const size_t size_;
+};
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_TESTSUPPORT_MEMORY_MAPPED_FILE_H_
@@ -0,0 +1,313 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "test/testsupport/prefetching_ivf_video_frame_generator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "api/video/encoded_image.h"
+#include "api/video/i420_buffer.h"
+#include "api/video_codecs/video_codec.h"
+#include "modules/video_coding/codecs/h264/include/h264.h"
+#include "modules/video_coding/codecs/vp8/include/vp8.h"
+#include "modules/video_coding/codecs/vp9/include/vp9.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/system/file_wrapper.h"
+#include "rtc_base/time_utils.h"
+#include "test/frame_generator_kernels.h"
+#include "test/i420_buffer_pool.h"
+
+namespace webrtc {
+namespace test {
+namespace {
+
+constexpr int kMaxNextFrameWaitTimeoutMs = 1000;
+
+// Generators alive in the process, for GetAllStats().
+Mutex& RegistryMutex() {
+  static Mutex* const mutex = new Mutex();
+  return *mutex;
+}
+
+std::vector<const PrefetchingIvfVideoFrameGenerator*>& Registry() {
+  static auto* const generators =
+      new std::vector<const PrefetchingIvfVideoFrameGenerator*>();
+  return *generators;
+}
+
+std::unique_ptr<VideoDecoder> CreateVideoDecoder(VideoCodecType codec_type) {
+  if (codec_type == VideoCodecType::kVideoCodecVP8) {
+    return VP8Decoder::Create();
+  }
+  if (codec_type == VideoCodecType::kVideoCodecVP9) {
+    return VP9Decoder::Create();
+  }
+  if (codec_type == VideoCodecType::kVideoCodecH264) {
+    return H264Decoder::Create();
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+PrefetchingIvfVideoFrameGenerator::PrefetchingIvfVideoFrameGenerator(
+    const std::string& file_name,
+    size_t queue_size)
+    : file_name_(file_name),
+      queue_size_(queue_size),
+      callback_(this),
+      file_reader_(IvfFileReader::Create(FileWrapper::OpenReadOnly(file_name))),
+      video_decoder_(CreateVideoDecoder(file_reader_->GetVideoCodecType())),
+      stopping_(false),
+      width_(file_reader_->GetFrameWidth()),
+      height_(file_reader_->GetFrameHeight()),
+      frames_decoded_(0),
+      frames_delivered_(0),
+      underruns_(0),
+      total_next_frame_us_(0),
+      max_next_frame_us_(0),
+      last_delivery_us_(-1),
+      last_interval_us_(-1),
+      pacing_jitter_us_(0),
+      frames_copied_(0) {
+  RTC_CHECK_GT(queue_size_, 0);
+  RTC_CHECK(video_decoder_) << "No decoder found for file's video codec type";
+  VideoCodec codec_settings;
+  codec_settings.codecType = file_reader_->GetVideoCodecType();
+  codec_settings.width = file_reader_->GetFrameWidth();
+  codec_settings.height = file_reader_->GetFrameHeight();
+  // Up to queue_size_ decoded frames stay referenced in the queue. The
+  // decoders' buffer pools only reuse buffers once released and hold far more
+  // buffers than the queue, so decoding never stalls on them.
+  RTC_CHECK_EQ(video_decoder_->RegisterDecodeCompleteCallback(&callback_),
+               WEBRTC_VIDEO_CODEC_OK);
+  RTC_CHECK_EQ(
+      video_decoder_->InitDecode(&codec_settings, /*number_of_cores=*/1),
+      WEBRTC_VIDEO_CODEC_OK);
+
+  reader_thread_ = rtc::PlatformThread::SpawnJoinable(
+      [this] { ReadLoop(); }, "ivf_prefetch",
+      rtc::ThreadAttributes().SetPriority(rtc::ThreadPriority::kHigh));
+
+  MutexLock lock(&RegistryMutex());
+  Registry().push_back(this);
+}
+
+PrefetchingIvfVideoFrameGenerator::~PrefetchingIvfVideoFrameGenerator() {
+  {
+    MutexLock lock(&RegistryMutex());
+    auto& generators = Registry();
+    generators.erase(std::remove(generators.begin(), generators.end(), this),
+                     generators.end());
+  }
+  {
+    MutexLock lock(&mutex_);
+    stopping_ = true;
+  }
+  space_available_.Set();
+  reader_thread_.Finalize();
+  // The reader is gone, so the decoder can no longer call back into `this`.
+  video_decoder_.reset();
+  file_reader_->Close();
+  file_reader_.reset();
+}
+
+FrameGeneratorInterface::VideoFrameData
+PrefetchingIvfVideoFrameGenerator::NextFrame() {
+  const int64_t start_us = rtc::TimeMicros();
+  QueuedFrame frame;
+  int width;
+  int height;
+  bool waited = false;
+  while (true) {
+    {
+      MutexLock lock(&mutex_);
+      if (!queue_.empty()) {
+        frame = std::move(queue_.front());
+        queue_.pop_front();
+        width = width_;
+        height = height_;
+        break;
+      }
+    }
+    waited = true;
+    RTC_CHECK(frame_available_.Wait(kMaxNextFrameWaitTimeoutMs))
+        << "Failed to decode next frame in " << kMaxNextFrameWaitTimeoutMs
+        << "ms. Can't continue";
+  }
+  space_available_.Set();
+
+  if (frame.buffer->width() != width || frame.buffer->height() != height) {
+    // Queued before the last ChangeResolution(); the reader already produces
+    // frames of the new size.
+    frame.buffer = ToQueuedBuffer(frame.buffer, width, height);
+  }
+
+  const int64_t end_us = rtc::TimeMicros();
+  MutexLock lock(&mutex_);
+  ++frames_delivered_;
+  if (waited)
+    ++underruns_;
+  total_next_frame_us_ += end_us - start_us;
+  max_next_frame_us_ = std::max(max_next_frame_us_, end_us - start_us);
+  if (last_delivery_us_ >= 0) {
+    const int64_t interval_us = end_us - last_delivery_us_;
+    if (last_interval_us_ >= 0) {
+      const int64_t d = std::abs(interval_us - last_interval_us_);
+      pacing_jitter_us_ += (d - pacing_jitter_us_) / 16.0;
+    }
+    last_interval_us_ = interval_us;
+  }
+  last_delivery_us_ = end_us;
+  return VideoFrameData(frame.buffer, frame.update_rect);
+}
+
+void PrefetchingIvfVideoFrameGenerator::ChangeResolution(size_t width,
+                                                         size_t height) {
+  MutexLock lock(&mutex_);
+  width_ = static_cast<int>(width);
+  height_ = static_cast<int>(height);
+}
+
+PrefetchingIvfVideoFrameGenerator::Stats
+PrefetchingIvfVideoFrameGenerator::GetStats() const {
+  MutexLock lock(&mutex_);
+  Stats stats;
+  stats.file_name = file_name_;
+  stats.frames_decoded = frames_decoded_;
+  stats.frames_delivered = frames_delivered_;
+  stats.underruns = underruns_;
+  stats.queue_size = queue_.size();
+  if (frames_delivered_ > 0) {
+    stats.avg_next_frame_us =
+        total_next_frame_us_ / static_cast<int64_t>(frames_delivered_);
+  }
+  stats.max_next_frame_us = max_next_frame_us_;
+  stats.pacing_jitter_us = static_cast<int64_t>(pacing_jitter_us_);
+  stats.frames_copied = frames_copied_;
+  return stats;
+}
+
+std::vector<PrefetchingIvfVideoFrameGenerator::Stats>
+PrefetchingIvfVideoFrameGenerator::GetAllStats() {
+  MutexLock lock(&RegistryMutex());
+  std::vector<Stats> stats;
+  for (const PrefetchingIvfVideoFrameGenerator* generator : Registry())
+    stats.push_back(generator->GetStats());
+  return stats;
+}
+
+void PrefetchingIvfVideoFrameGenerator::ReadLoop() {
+  while (true) {
+    int width;
+    int height;
+    bool queue_full;
+    {
+      MutexLock lock(&mutex_);
+      if (stopping_)
+        return;
+      queue_full = queue_.size() >= queue_size_;
+      width = width_;
+      height = height_;
+    }
+    if (queue_full) {
+      space_available_.Wait(rtc::Event::kForever);
+      continue;
+    }
+
+    if (!file_reader_->HasMoreFrames()) {
+      file_reader_->Reset();
+    }
+    absl::optional<EncodedImage> image = file_reader_->NextFrame();
+    RTC_CHECK(image);
+    decoded_frame_ = absl::nullopt;
+    // Last parameter is undocumented and there is no usage of it found.
+    RTC_CHECK_EQ(WEBRTC_VIDEO_CODEC_OK,
+                 video_decoder_->Decode(*image, /*missing_frames=*/false,
+                                        /*render_time_ms=*/0));
+    // The software decoders deliver synchronously; a frame the decoder holds
+    // back simply shows up on a later iteration.
+    if (!decoded_frame_)
+      continue;
+
+    QueuedFrame frame;
+    frame.buffer =
+        ToQueuedBuffer(decoded_frame_->video_frame_buffer(), width, height);
+    frame.update_rect = decoded_frame_->update_rect();
+    decoded_frame_ = absl::nullopt;
+    {
+      MutexLock lock(&mutex_);
+      queue_.push_back(std::move(frame));
+      ++frames_decoded_;
+    }
+    frame_available_.Set();
+  }
+}
+
+void PrefetchingIvfVideoFrameGenerator::OnFrameDecoded(
+    const VideoFrame& decoded_frame) {
+  decoded_frame_ = decoded_frame;
+}
+
+rtc::scoped_refptr<VideoFrameBuffer>
+PrefetchingIvfVideoFrameGenerator::ToQueuedBuffer(
+    const rtc::scoped_refptr<VideoFrameBuffer>& buffer,
+    int width,
+    int height) {
+  if (buffer->type() == VideoFrameBuffer::Type::kI420 &&
+      buffer->width() == width && buffer->height() == height) {
+    return buffer;
+  }
+
+  {
+    MutexLock lock(&mutex_);
+    ++frames_copied_;
+  }
+  rtc::scoped_refptr<I420BufferInterface> source = buffer->ToI420();
+  rtc::scoped_refptr<I420Buffer> pooled =
+      I420BufferPool::Shared()->CreateI420Buffer(width, height);
+  if (source->width() != width || source->height() != height) {
+    // Video adapter has requested a down-scale.
+    pooled->ScaleFrom(*source);
+    return pooled;
+  }
+  BlitRect(source->DataY(), source->StrideY(), pooled->MutableDataY(),
+           pooled->StrideY(), width, height);
+  BlitRect(source->DataU(), source->StrideU(), pooled->MutableDataU(),
+           pooled->StrideU(), source->ChromaWidth(), source->ChromaHeight());
+  BlitRect(source->DataV(), source->StrideV(), pooled->MutableDataV(),
+           pooled->StrideV(), source->ChromaWidth(), source->ChromaHeight());
+  return pooled;
+}
+
+int32_t PrefetchingIvfVideoFrameGenerator::DecodedCallback::Decoded(
+    VideoFrame& decoded_image) {
+  Decoded(decoded_image, 0, 0);
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+int32_t PrefetchingIvfVideoFrameGenerator::DecodedCallback::Decoded(
+    VideoFrame& decoded_image,
+    int64_t decode_time_ms) {
+  Decoded(decoded_image, decode_time_ms, 0);
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+void PrefetchingIvfVideoFrameGenerator::DecodedCallback::Decoded(
+    VideoFrame& decoded_image,
+    absl::optional<int32_t> decode_time_ms,
+    absl::optional<uint8_t> qp) {
+  reader_->OnFrameDecoded(decoded_image);
+}
+
+}  // namespace test
+}  // namespace webrtc
@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2022 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TEST_TESTSUPPORT_PREFETCHING_IVF_VIDEO_FRAME_GENERATOR_H_
+#define TEST_TESTSUPPORT_PREFETCHING_IVF_VIDEO_FRAME_GENERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "api/test/frame_generator_interface.h"
+#include "api/video/video_frame.h"
+#include "api/video_codecs/video_decoder.h"
+#include "modules/video_coding/utility/ivf_file_reader.h"
+#include "rtc_base/event.h"
+#include "rtc_base/platform_thread.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+namespace webrtc {
+namespace test {
+
+// Plays an IVF file like IvfVideoFrameGenerator, but reads and decodes on a
+// dedicated thread. Decoded frames are kept in a bounded queue, so
+// NextFrame() normally only dequeues and file I/O or decode time no longer
+// shows up as capture jitter. I420 frames are queued as the decoder returned
+// them; other formats and frames to be scaled are copied into buffers from the
+// shared I420BufferPool.
+class PrefetchingIvfVideoFrameGenerator : public FrameGeneratorInterface {
+ public:
+  struct Stats {
+    std::string file_name;
+    uint64_t frames_decoded = 0;
+    uint64_t frames_delivered = 0;
+    // NextFrame() calls that found the queue empty and had to wait.
+    uint64_t underruns = 0;
+    size_t queue_size = 0;
+    // Time spent inside NextFrame().
+    int64_t avg_next_frame_us = 0;
+    int64_t max_next_frame_us = 0;
+    // Interarrival jitter of NextFrame() returns, smoothed as in RFC 3550.
+    // With a steadily paced caller this is the jitter the generator adds.
+    int64_t pacing_jitter_us = 0;
+    // Frames copied into a pooled buffer to be converted or scaled.
+    uint64_t frames_copied = 0;
+  };
+
+  static constexpr size_t kDefaultQueueSize = 8;
+
+  PrefetchingIvfVideoFrameGenerator(const std::string& file_name,
+                                    size_t queue_size);
+  ~PrefetchingIvfVideoFrameGenerator() override;
+
+  VideoFrameData NextFrame() override;
+  void ChangeResolution(size_t width, size_t height) override;
+
+  Stats GetStats() const;
+
+  // Stats of every generator alive in the process.
+  static std::vector<Stats> GetAllStats();
+
+ private:
+  struct QueuedFrame {
+    rtc::scoped_refptr<VideoFrameBuffer> buffer;
+    absl::optional<VideoFrame::UpdateRect> update_rect;
+  };
+
+  class DecodedCallback : public DecodedImageCallback {
+   public:
+    explicit DecodedCallback(PrefetchingIvfVideoFrameGenerator* reader)
+        : reader_(reader) {}
+
+    int32_t Decoded(VideoFrame& decoded_image) override;
+    int32_t Decoded(VideoFrame& decoded_image, int64_t decode_time_ms) override;
+    void Decoded(VideoFrame& decoded_image,
+                 absl::optional<int32_t> decode_time_ms,
+                 absl::optional<uint8_t> qp) override;
+
+   private:
+    PrefetchingIvfVideoFrameGenerator* const reader_;
+  };
+
+  // Body of the reader thread.
+  void ReadLoop();
+  // Called on the reader thread from inside VideoDecoder::Decode().
+  void OnFrameDecoded(const VideoFrame& decoded_frame);
+  // Returns `buffer` if it is an I420 buffer of the given size, otherwise
+  // copies or scales it into a pooled buffer.
+  rtc::scoped_refptr<VideoFrameBuffer> ToQueuedBuffer(
+      const rtc::scoped_refptr<VideoFrameBuffer>& buffer,
+      int width,
+      int height);
+
+  const std::string file_name_;
+  const size_t queue_size_;
+
+  // Only used on the reader thread once it is started.
+  DecodedCallback callback_;
+  std::unique_ptr<IvfFileReader> file_reader_;
+  std::unique_ptr<VideoDecoder> video_decoder_;
+  absl::optional<VideoFrame> decoded_frame_;
+
+  mutable Mutex mutex_;
+  bool stopping_ RTC_GUARDED_BY(mutex_);
+  int width_ RTC_GUARDED_BY(mutex_);
+  int height_ RTC_GUARDED_BY(mutex_);
+  std::deque<QueuedFrame> queue_ RTC_GUARDED_BY(mutex_);
+  uint64_t frames_decoded_ RTC_GUARDED_BY(mutex_);
+  uint64_t frames_delivered_ RTC_GUARDED_BY(mutex_);
+  uint64_t underruns_ RTC_GUARDED_BY(mutex_);
+  int64_t total_next_frame_us_ RTC_GUARDED_BY(mutex_);
+  int64_t max_next_frame_us_ RTC_GUARDED_BY(mutex_);
+  int64_t last_delivery_us_ RTC_GUARDED_BY(mutex_);
+  int64_t last_interval_us_ RTC_GUARDED_BY(mutex_);
+  double pacing_jitter_us_ RTC_GUARDED_BY(mutex_);
+  uint64_t frames_copied_ RTC_GUARDED_BY(mutex_);
+
+  // Signalled by the reader when a frame was queued.
+  rtc::Event frame_available_;
+  // Signalled by NextFrame() when a slot was freed, and on shutdown.
+  rtc::Event space_available_;
+
+  rtc::PlatformThread reader_thread_;
+};
+
+}  // namespace test
+}  // namespace webrtc
+
+#endif  // TEST_TESTSUPPORT_PREFETCHING_IVF_VIDEO_FRAME_GENERATOR_H_
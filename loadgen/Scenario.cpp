@@ -0,0 +1,137 @@
+#define MSC_CLASS "Scenario"
+
+#include <fstream>
+#include "MediaSoupClientErrors.hpp"
+#include "Scenario.hpp"
+
+static ScenarioGroup parseGroup(const nlohmann::json& json, size_t index)
+{
+	ScenarioGroup group;
+	group.name = json.value("name", "group" + std::to_string(index));
+	group.count = json.value("count", group.count);
+	// Consumer groups send nothing unless asked to.
+	const bool consumes = json.contains("consume");
+	group.session.enableAudio = json.value("audio", !consumes);
+	group.session.enableVideo = json.value("video", false);
+	group.session.useSimulcast = json.value("simulcast", false);
+	group.session.videoCodec = json.value("videoCodec", "");
+	group.session.enableData = json.value("data", false);
+	group.session.dataIntervalMs = json.value("dataIntervalMs", group.session.dataIntervalMs);
+	group.session.dataMessageSize = json.value("dataMessageSize", group.session.dataMessageSize);
+
+	if (json.contains("rampUp"))
+	{
+		const auto& rampUp = json["rampUp"];
+		group.batch = rampUp.value("batch", group.batch);
+		group.intervalMs = rampUp.value("intervalMs", group.intervalMs);
+		group.startMs = rampUp.value("startMs", group.startMs);
+	}
+
+	if (consumes)
+	{
+		const auto& consume = json["consume"];
+		group.consumeFrom = consume.value("from", "");
+		group.consumeCount = consume.value("producers", size_t(1));
+		if (group.consumeFrom.empty() || group.consumeCount == 0)
+			MSC_THROW_TYPE_ERROR("consume needs a group to consume from and a positive number of producers");
+	}
+
+	if (group.count == 0 || group.batch == 0)
+		MSC_THROW_TYPE_ERROR("group count and batch must be positive");
+	if (!group.session.enableAudio && !group.session.enableVideo && !group.session.enableData && !consumes)
+		MSC_THROW_TYPE_ERROR("group sends and consumes nothing");
+
+	return group;
+}
+
+// Phases keep the seed of the initial conditions.
+static NetworkPhase parseNetworkPhase(const nlohmann::json& json, uint32_t seed)
+{
+	NetworkPhase phase;
+	phase.atMs = static_cast<int64_t>(json.value("atSeconds", 0.0) * 1000);
+	phase.conditions = parseNetworkConditions(json);
+	phase.conditions.seed = seed;
+
+	return phase;
+}
+
+Scenario loadScenario(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		MSC_THROW_ERROR("cannot open scenario %s", path.c_str());
+
+	nlohmann::json json = nlohmann::json::parse(file);
+
+	Scenario scenario;
+	scenario.loopback = json.value("loopback", false);
+	scenario.localServer = json.value("localServer", false) || scenario.loopback;
+	scenario.localServerLatencyMs = json.value("localServerLatencyMs", scenario.localServerLatencyMs);
+	scenario.baseUrl = json.value("baseUrl", "");
+	if (json.contains("routerRtpCapabilities"))
+		scenario.routerRtpCapabilities = json["routerRtpCapabilities"];
+	scenario.capabilityCache = json.value("capabilityCache", "");
+	scenario.factories.shardCount = json.value("shards", scenario.factories.shardCount);
+	if (json.contains("simulatedTime"))
+	{
+		scenario.factories.simulatedTime = true;
+		scenario.factories.simulatedTimeSpeed = json["simulatedTime"].value("speed", 0.0);
+	}
+	if (json.contains("network"))
+	{
+		scenario.factories.emulatedNetwork = true;
+		scenario.factories.networkConditions = parseNetworkConditions(json["network"]);
+	}
+	if (json.contains("networkSchedule"))
+	{
+		scenario.factories.emulatedNetwork = true;
+		for (const auto& phase : json["networkSchedule"])
+			scenario.networkSchedule.push_back(parseNetworkPhase(phase, scenario.factories.networkConditions.seed));
+	}
+	scenario.expectRecoveries = json.value("expectRecoveries", false);
+	scenario.signalingConnections = json.value("signalingConnections", scenario.signalingConnections);
+	scenario.startConcurrency = json.value("startConcurrency", scenario.startConcurrency);
+	scenario.durationMs = static_cast<int64_t>(json.value("durationSeconds", 60.0) * 1000);
+	scenario.reportIntervalMs = static_cast<int64_t>(json.value("reportIntervalSeconds", 5.0) * 1000);
+
+	if (json.contains("groups"))
+	{
+		for (const auto& group : json["groups"])
+			scenario.groups.push_back(parseGroup(group, scenario.groups.size()));
+	}
+
+	if (scenario.baseUrl.empty() && !scenario.localServer)
+		MSC_THROW_TYPE_ERROR("baseUrl missing");
+	if (scenario.groups.empty())
+		MSC_THROW_TYPE_ERROR("scenario without groups");
+	if (scenario.reportIntervalMs <= 0)
+		MSC_THROW_TYPE_ERROR("reportIntervalSeconds must be positive");
+	if (scenario.factories.simulatedTimeSpeed < 0)
+		MSC_THROW_TYPE_ERROR("simulatedTime speed must not be negative");
+	// The stand-in server without a router connects no transport.
+	if (scenario.expectRecoveries && scenario.localServer && !scenario.loopback)
+		MSC_THROW_TYPE_ERROR("expectRecoveries needs a mediasoup server or loopback");
+	for (size_t i = 0; i < scenario.groups.size(); ++i)
+	{
+		const std::string& from = scenario.groups[i].consumeFrom;
+		if (from.empty())
+			continue;
+
+		// The stand-in server without a router has nothing to consume.
+		if (scenario.localServer && !scenario.loopback)
+			MSC_THROW_TYPE_ERROR("consumer groups need a mediasoup server or loopback");
+
+		bool found = false;
+		for (size_t j = 0; j < i; ++j)
+			found = found || scenario.groups[j].name == from;
+		if (!found)
+			MSC_THROW_TYPE_ERROR("consume from %s, which is not an earlier group", from.c_str());
+	}
+	for (size_t i = 1; i < scenario.networkSchedule.size(); ++i)
+	{
+		if (scenario.networkSchedule[i].atMs < scenario.networkSchedule[i - 1].atMs)
+			MSC_THROW_TYPE_ERROR("networkSchedule must be in time order");
+	}
+
+	return scenario;
+}
@@ -0,0 +1,70 @@
+#ifndef MSC_TEST_LOADGEN_SCENARIO_HPP
+#define MSC_TEST_LOADGEN_SCENARIO_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Broadcaster.hpp"
+#include "MediaStreamTrackFactory.hpp"
+#include "json.hpp"
+
+/* Sessions sharing the same settings, started in batches. */
+struct ScenarioGroup
+{
+	std::string name;
+	size_t count = 1;
+	Broadcaster::StartOptions session;
+	// Each session consumes consumeCount producers of the running sessions of
+	// the earlier group named consumeFrom, unless empty.
+	std::string consumeFrom;
+	size_t consumeCount = 0;
+	// Ramp-up: batch sessions every intervalMs, the first batch startMs after
+	// the run started.
+	size_t batch = 10;
+	int64_t intervalMs = 1000;
+	int64_t startMs = 0;
+};
+
+/* Network conditions from atMs after the run started. */
+struct NetworkPhase
+{
+	int64_t atMs = 0;
+	NetworkConditions conditions;
+};
+
+struct Scenario
+{
+	// Room URL of the mediasoup demo server, e.g. "http://127.0.0.1:4443/rooms/load".
+	std::string baseUrl;
+	// Fetched from baseUrl when null, unless cached.
+	nlohmann::json routerRtpCapabilities;
+	// CapabilityCache file kept across runs, none if empty.
+	std::string capabilityCache;
+	// Runs against the in-process stand-in server instead of baseUrl. Nothing
+	// is sent, but signaling and session setup are exercised.
+	bool localServer = false;
+	int64_t localServerLatencyMs = 0;
+	// The local server with a loopback router: transports connect on
+	// 127.0.0.1 and media and data reach the router.
+	bool loopback = false;
+	// Shards, and simulated time ("simulatedTime": { "speed": 20 }), which
+	// the schedule then follows too.
+	// Also the emulated network ("network": { "delayMs": 40, "lossPercent": 1 }),
+	// see parseNetworkConditions().
+	FactoryConfig factories;
+	// Later changes of the emulated network, in time order.
+	std::vector<NetworkPhase> networkSchedule;
+	// The run fails unless sessions lost connectivity and all recovered it,
+	// e.g. after a blackout in networkSchedule.
+	bool expectRecoveries = false;
+	size_t signalingConnections = 4;
+	size_t startConcurrency = 16;
+	int64_t durationMs = 60000;
+	int64_t reportIntervalMs = 5000;
+	std::vector<ScenarioGroup> groups;
+};
+
+// Throws on unreadable files and invalid scenarios.
+Scenario loadScenario(const std::string& path);
+
+#endif
\ No newline at end of file
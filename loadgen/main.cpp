@@ -0,0 +1,455 @@
+/* Headless load generator: runs the publishers and consumers of a scenario
+ * file against a mediasoup demo server and reports setup latency, throughput
+ * and resource use. See scenario.example.json.
+ *
+ *   mediasoup-loadgen <scenario.json> [--report <file>] [--trace <file>] [--verbose]
+ *
+ * --trace writes the spans of the run in the Chrome trace event format.
+ */
+#define MSC_CLASS "loadgen"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BroadcasterHost.hpp"
+#include "CapabilityCache.hpp"
+#include "LocalSignalingServer.hpp"
+#include "LoopbackRouter.hpp"
+#include "NetworkEmulation.hpp"
+#include "Scenario.hpp"
+#include "SignalingClient.hpp"
+#include "SimulatedTime.hpp"
+#include "Tracing.hpp"
+#include "mediasoupclient.hpp"
+#include "DebugCpp.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool verbose = false;
+
+static void printLog(const char* message, int color, int /*size*/)
+{
+	// Only errors, which are logged in red, unless verbose.
+	if (verbose || color == static_cast<int>(Color::Red))
+		std::fprintf(stderr, "%s\n", message);
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+	if (values.empty())
+		return 0;
+
+	std::sort(values.begin(), values.end());
+	const size_t rank = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+
+	return values[std::min(rank, values.size() - 1)];
+}
+
+static double processCpuSeconds()
+{
+	rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* Time of the scenario schedule: virtual when the media runs on simulated
+ * time, so that ramp-ups, the duration and the rates follow the media.
+ */
+static Clock::time_point scenarioNow()
+{
+	if (!isSimulatedTime())
+		return Clock::now();
+
+	return Clock::time_point(std::chrono::milliseconds(getSimulatedTimeStats().virtualMs));
+}
+
+// Returns true if stop() became true before scenarioNow() reached due.
+static bool waitUntil(
+	std::unique_lock<std::mutex>& lock,
+	std::condition_variable& changed,
+	Clock::time_point due,
+	const std::function<bool()>& stop)
+{
+	if (!isSimulatedTime())
+		return changed.wait_until(lock, due, stop);
+
+	// Virtual time does not wake the condition variable.
+	while (scenarioNow() < due)
+	{
+		if (changed.wait_for(lock, std::chrono::milliseconds(1), stop))
+			return true;
+	}
+
+	return stop();
+}
+
+struct GroupRun
+{
+	ScenarioGroup group;
+	std::unique_ptr<BroadcasterHost> host;
+	std::thread rampUp;
+};
+
+int main(int argc, char* argv[])
+{
+	std::string scenarioPath;
+	std::string reportPath;
+	std::string tracePath;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+			reportPath = argv[++i];
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--verbose") == 0)
+			verbose = true;
+		else
+			scenarioPath = argv[i];
+	}
+	if (scenarioPath.empty())
+	{
+		std::fprintf(stderr, "usage: %s <scenario.json> [--report <file>] [--trace <file>] [--verbose]\n", argv[0]);
+		return 2;
+	}
+
+	RegisterDebugCallback(printLog);
+	enableTracing(!tracePath.empty());
+	setTraceThreadName("main");
+
+	try
+	{
+		Scenario scenario = loadScenario(scenarioPath);
+
+		mediasoupclient::Initialize();
+		initializeFactories(scenario.factories);
+
+		std::unique_ptr<LocalSignalingServer> localServer;
+		if (scenario.localServer)
+		{
+			localServer.reset(new LocalSignalingServer(
+				0, std::chrono::milliseconds(scenario.localServerLatencyMs), scenario.loopback));
+			scenario.baseUrl = localServer->BaseUrl();
+		}
+
+		setCapabilityCachePath(scenario.capabilityCache);
+		CapabilityCache::Entry cached;
+		if (scenario.routerRtpCapabilities.is_null() && getCapabilityCache() &&
+		    getCapabilityCache()->Find(scenario.baseUrl, cached))
+		{
+			scenario.routerRtpCapabilities = cached.routerRtpCapabilities;
+		}
+		if (scenario.routerRtpCapabilities.is_null())
+		{
+			auto response = SignalingClient(scenario.baseUrl).Request("GET", "").get();
+			if (response.status != 200)
+			{
+				std::fprintf(stderr, "cannot get router capabilities from %s: %d\n", scenario.baseUrl.c_str(), response.status);
+				return 1;
+			}
+			scenario.routerRtpCapabilities = response.body;
+		}
+
+		std::vector<std::unique_ptr<GroupRun>> runs;
+		for (const auto& group : scenario.groups)
+		{
+			std::unique_ptr<GroupRun> run(new GroupRun());
+			run->group = group;
+
+			BroadcasterHost::Options options;
+			options.baseUrl = scenario.baseUrl;
+			options.routerRtpCapabilities = scenario.routerRtpCapabilities;
+			options.session = group.session;
+			options.signalingConnections = scenario.signalingConnections;
+			options.startConcurrency = scenario.startConcurrency;
+			// Validated to be an earlier group.
+			for (const auto& source : runs)
+			{
+				if (source->group.name == group.consumeFrom)
+					options.consumeFrom = source->host.get();
+			}
+			options.consumeCount = group.consumeCount;
+			run->host.reset(new BroadcasterHost(options));
+
+			runs.push_back(std::move(run));
+		}
+
+		const auto start = scenarioNow();
+		const auto end = start + std::chrono::milliseconds(scenario.durationMs);
+		std::mutex stopMutex;
+		std::condition_variable stopped;
+		bool stopping = false;
+
+		for (auto& run : runs)
+		{
+			GroupRun* groupRun = run.get();
+			groupRun->rampUp = std::thread([groupRun, start, &stopMutex, &stopped, &stopping]() {
+				const ScenarioGroup& group = groupRun->group;
+				auto due = start + std::chrono::milliseconds(group.startMs);
+				size_t attempted = 0;
+
+				while (attempted < group.count)
+				{
+					{
+						std::unique_lock<std::mutex> lock(stopMutex);
+						if (waitUntil(lock, stopped, due, [&]() { return stopping; }))
+							break;
+					}
+
+					const size_t batch = std::min(group.batch, group.count - attempted);
+					groupRun->host->AddSessions(batch);
+					attempted += batch;
+					due += std::chrono::milliseconds(group.intervalMs);
+				}
+			});
+		}
+
+		std::thread networkSchedule([&scenario, start, &stopMutex, &stopped, &stopping]() {
+			for (const auto& phase : scenario.networkSchedule)
+			{
+				{
+					std::unique_lock<std::mutex> lock(stopMutex);
+					if (waitUntil(lock, stopped, start + std::chrono::milliseconds(phase.atMs), [&]() { return stopping; }))
+						break;
+				}
+
+				Debug::Log("[INFO] network phase at " + std::to_string(phase.atMs) + " ms");
+				setNetworkConditions(phase.conditions);
+			}
+		});
+
+		std::printf(
+			"%8s %10s %7s %9s %9s %9s %12s %12s %7s %10s %8s\n",
+			"time_s", "sessions", "failed", "setup_p50", "setup_p90", "setup_p99", "tx_mbit_s", "rx_mbit_s", "cpu_%", "rss_mb",
+			"threads");
+
+		const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+		auto lastReport = start;
+		auto lastRealReport = Clock::now();
+		double lastCpu = processCpuSeconds();
+		uint64_t lastBytes = 0;
+		uint64_t lastBytesReceived = 0;
+		nlohmann::json samples = nlohmann::json::array();
+
+		while (scenarioNow() < end)
+		{
+			{
+				const auto due = std::min(end, lastReport + std::chrono::milliseconds(scenario.reportIntervalMs));
+				std::unique_lock<std::mutex> lock(stopMutex);
+				waitUntil(lock, stopped, due, []() { return false; });
+			}
+
+			const auto now = scenarioNow();
+			const auto realNow = Clock::now();
+			const double seconds = std::chrono::duration<double>(now - lastReport).count();
+			// CPU use is against real time, also on simulated time.
+			const double realSeconds = std::chrono::duration<double>(realNow - lastRealReport).count();
+			const double cpu = processCpuSeconds();
+
+			size_t sessions = 0;
+			uint64_t failed = 0;
+			uint64_t bytes = 0;
+			uint64_t bytesReceived = 0;
+			std::vector<double> startupMs;
+			for (auto& run : runs)
+			{
+				const auto stats = run->host->GetStats();
+				sessions += stats.sessions;
+				failed += stats.failed;
+				bytes += run->host->GetBytesSent();
+				bytesReceived += run->host->GetBytesReceived();
+				auto groupStartupMs = run->host->GetStartupMs();
+				startupMs.insert(startupMs.end(), groupStartupMs.begin(), groupStartupMs.end());
+			}
+
+			// Sessions removed or closed make the counter go back.
+			const double txMbps = bytes >= lastBytes ? (bytes - lastBytes) * 8 / seconds / 1e6 : 0;
+			const double rxMbps =
+				bytesReceived >= lastBytesReceived ? (bytesReceived - lastBytesReceived) * 8 / seconds / 1e6 : 0;
+			const double cpuPercent = realSeconds > 0 ? (cpu - lastCpu) / realSeconds * 100 : 0;
+			const uint64_t rss = getProcessMemoryBytes();
+			const int64_t threads = getProcessThreadCount();
+			const double elapsed = std::chrono::duration<double>(now - start).count();
+
+			std::printf(
+				"%8.1f %10zu %7llu %9.1f %9.1f %9.1f %12.2f %12.2f %7.0f %10.1f %8lld\n",
+				elapsed,
+				sessions,
+				static_cast<unsigned long long>(failed),
+				percentile(startupMs, 0.5),
+				percentile(startupMs, 0.9),
+				percentile(startupMs, 0.99),
+				txMbps,
+				rxMbps,
+				cpuPercent,
+				rss / 1e6,
+				static_cast<long long>(threads));
+			std::fflush(stdout);
+
+			/* clang-format off */
+			samples.push_back(
+			{
+				{ "timeS",         elapsed                      },
+				{ "sessions",      sessions                     },
+				{ "failed",        failed                       },
+				{ "setupP50Ms",    percentile(startupMs, 0.5)   },
+				{ "setupP90Ms",    percentile(startupMs, 0.9)   },
+				{ "setupP99Ms",    percentile(startupMs, 0.99)  },
+				{ "txMbps",        txMbps                       },
+				{ "rxMbps",        rxMbps                       },
+				{ "cpuPercent",    cpuPercent                   },
+				{ "cpuPerCore",    cpuPercent / cores           },
+				{ "rssBytes",      rss                          },
+				{ "threads",       threads                      }
+			});
+			/* clang-format on */
+
+			lastReport = now;
+			lastRealReport = realNow;
+			lastCpu = cpu;
+			lastBytes = bytes;
+			lastBytesReceived = bytesReceived;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(stopMutex);
+			stopping = true;
+		}
+		stopped.notify_all();
+		for (auto& run : runs)
+			run->rampUp.join();
+		networkSchedule.join();
+
+		std::vector<ReconnectionManager::Stats> reconnection;
+		uint64_t disconnections = 0;
+		uint64_t recoveries = 0;
+		uint64_t reconnectionFailures = 0;
+		double maxRecoveryMs = 0;
+		for (auto& run : runs)
+		{
+			reconnection.push_back(run->host->GetReconnectionStats());
+			disconnections += reconnection.back().disconnections;
+			recoveries += reconnection.back().recoveries;
+			reconnectionFailures += reconnection.back().failures;
+			maxRecoveryMs = std::max(maxRecoveryMs, reconnection.back().maxRecoveryMs);
+		}
+
+		std::printf(
+			"reconnection: %llu disconnections, %llu recoveries, %llu failures, max recovery %.0f ms\n",
+			static_cast<unsigned long long>(disconnections),
+			static_cast<unsigned long long>(recoveries),
+			static_cast<unsigned long long>(reconnectionFailures),
+			maxRecoveryMs);
+
+		// Sessions still recovering at the end count as not recovered.
+		const bool recoveriesMissing =
+			scenario.expectRecoveries && (disconnections == 0 || recoveries < disconnections || reconnectionFailures > 0);
+
+		if (!reportPath.empty())
+		{
+			nlohmann::json groups = nlohmann::json::array();
+			for (size_t i = 0; i < runs.size(); ++i)
+			{
+				const auto& run = runs[i];
+				const auto stats = run->host->GetStats();
+				const auto startupMs = run->host->GetStartupMs();
+				const auto& groupReconnection = reconnection[i];
+
+				/* clang-format off */
+				groups.push_back(
+				{
+					{ "name",                  run->group.name                },
+					{ "sessions",              stats.sessions                 },
+					{ "failed",                stats.failed                   },
+					{ "setupP50Ms",            percentile(startupMs, 0.5)     },
+					{ "setupP90Ms",            percentile(startupMs, 0.9)     },
+					{ "setupP99Ms",            percentile(startupMs, 0.99)    },
+					{ "memoryPerSessionBytes", stats.memoryPerSessionBytes    },
+					{ "threadsPerSession",     stats.threadsPerSession        },
+					{ "reconnection",
+						{
+							{ "disconnections", groupReconnection.disconnections },
+							{ "selfRecoveries", groupReconnection.selfRecoveries },
+							{ "iceRestarts",    groupReconnection.iceRestarts    },
+							{ "recoveries",     groupReconnection.recoveries     },
+							{ "failures",       groupReconnection.failures       },
+							{ "maxRecoveryMs",  groupReconnection.maxRecoveryMs  },
+							{ "meanRecoveryMs", groupReconnection.meanRecoveryMs }
+						}
+					}
+				});
+				/* clang-format on */
+			}
+
+			nlohmann::json result = { { "cores", cores }, { "groups", groups }, { "samples", samples } };
+			if (localServer && localServer->Router())
+			{
+				const auto router = localServer->Router()->GetStats();
+
+				/* clang-format off */
+				result["loopbackRouter"] =
+				{
+					{ "connectedTransports",   router.connectedTransports   },
+					{ "rtpPacketsReceived",    router.rtpPacketsReceived    },
+					{ "rtpBytesReceived",      router.rtpBytesReceived      },
+					{ "rtpPacketsForwarded",   router.rtpPacketsForwarded   },
+					{ "sctpMessagesReceived",  router.sctpMessagesReceived  },
+					{ "sctpMessagesForwarded", router.sctpMessagesForwarded },
+					{ "packetsDropped",        router.packetsDropped        }
+				};
+				/* clang-format on */
+			}
+
+			if (scenario.factories.emulatedNetwork)
+			{
+				const NetworkEmulationStats network = getNetworkEmulationStats();
+				auto link = [](const LinkStats& linkStats) {
+					/* clang-format off */
+					return nlohmann::json
+					{
+						{ "packets",      linkStats.packets      },
+						{ "bytes",        linkStats.bytes        },
+						{ "lost",         linkStats.lost         },
+						{ "queueDropped", linkStats.queueDropped },
+						{ "reordered",    linkStats.reordered    }
+					};
+					/* clang-format on */
+				};
+
+				result["network"] = { { "up", link(network.up) }, { "down", link(network.down) } };
+			}
+
+			std::ofstream report(reportPath);
+			report << result.dump(2);
+		}
+
+		if (!tracePath.empty() && !writeTrace(tracePath))
+			std::fprintf(stderr, "cannot write trace to %s\n", tracePath.c_str());
+
+		// Sessions stop before the factories and the local server go away.
+		runs.clear();
+
+		if (recoveriesMissing)
+		{
+			std::fprintf(stderr, "loadgen failed: expected every connectivity loss to be recovered\n");
+			return 1;
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::fprintf(stderr, "loadgen failed: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
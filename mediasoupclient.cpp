@@ -6,7 +6,24 @@
 
 #include "mediasoupclient.hpp"
 #include "Broadcaster.hpp"
+#include "BroadcasterHost.hpp"
+#include "CallMetrics.hpp"
+#include "CapabilityCache.hpp"
 #include "UnityLogger.h"
+#include "CertificatePool.hpp"
+#include "LocalSignalingServer.hpp"
+#include "LoopbackRouter.hpp"
+#include "MediaStreamTrackFactory.hpp"
+#include "NetworkEmulation.hpp"
+#include "SimulatedTime.hpp"
+#include "ThreadPolicy.hpp"
+#include "TimerWheel.hpp"
+#include "Tracing.hpp"
+#include "TransportPool.hpp"
+#include "rtc_base/helpers.h"
+#include "test/frame_generator_kernels.h"
+#include "test/i420_buffer_pool.h"
+#include "test/testsupport/prefetching_ivf_video_frame_generator.h"
 using namespace std;
 
 #define DLL_EXPORT __declspec(dllexport)
@@ -16,14 +33,19 @@ using namespace mediasoupclient;
 const string currentDateTime();
 const string currentLogTime();
 void ErrorLogging(exception e, string prefix="");
+FactoryConfig ParseFactoryConfig(const nlohmann::json& json);
+PeerConnection::Options WithCachedCertificate(const PeerConnection::Options* peerConnectionOptions);
 
 UnityLogger unityLogger;
+std::mutex localSignalingServerMutex;
+std::unique_ptr<LocalSignalingServer> localSignalingServer;
 
 extern "C"
 {
 #pragma region mediasoup
 	DLL_EXPORT void Initialize()
 	{
+		MSC_CALL_METRICS();
 		try
 		{
 			Debug::Log("mediasoupclient Initialize");
@@ -37,8 +59,65 @@ extern "C"
 		}
 	}
 
+	// Initialize() that also warms up in the background: creates the factories, loads their
+	// codecs and generates DTLS certificates for the first transports.
+	// config : same as InitializeFactories, plus "certificateCount": 4
+	DLL_EXPORT bool InitializeAsync(char* config, int configLength)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			Debug::Log("mediasoupclient InitializeAsync");
+			Logger::SetHandler(&unityLogger);
+			Logger::SetLogLevel(Logger::LogLevel::LOG_DEBUG);
+			mediasoupclient::Initialize();
+
+			const nlohmann::json json =
+				config == nullptr ? nlohmann::json::object() : nlohmann::json::parse(string(config, configLength));
+			const size_t certificateCount = std::max(json.value("certificateCount", 4), 0);
+			initializeFactoriesAsync(ParseFactoryConfig(json), [certificateCount]() {
+				generateCertificates(certificateCount);
+			});
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[InitializeAsync]");
+			return false;
+		}
+
+		return true;
+	}
+
+	DLL_EXPORT void GetStartupStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			auto stats = getStartupStats();
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "prewarmed",           stats.prewarmed            },
+				{ "prewarmMs",           stats.prewarmMs            },
+				{ "factoryWaitMs",       stats.factoryWaitMs        },
+				{ "timeToFirstFrameMs",  stats.timeToFirstFrameMs   },
+				{ "pooledCertificates",  getPooledCertificateCount() }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetStartupStats]");
+		}
+	}
+
 	DLL_EXPORT void CleanUp()
 	{
+		MSC_CALL_METRICS();
 		Debug::Log("mediasoupclient clean up");
 		mediasoupclient::Cleanup();
 	}
@@ -48,6 +127,7 @@ extern "C"
 	//https://docs.microsoft.com/ko-kr/dotnet/api/system.runtime.interopservices.callingconvention?view=net-6.0
 	DLL_EXPORT void __stdcall Version(char* text, size_t bufferSize)
 	{
+		MSC_CALL_METRICS();
 		if (text == nullptr)
 			return;
 		strcpy_s(text, bufferSize, mediasoupclient::Version().c_str());
@@ -57,12 +137,14 @@ extern "C"
 #pragma region Device
 	DLL_EXPORT mediasoupclient::Device* MakeDevice()
 	{
+		MSC_CALL_METRICS();
 		Debug::Log("Alloc Device ptr");
 		return new mediasoupclient::Device();
 	}
 
 	DLL_EXPORT void DeleteDevice(Device* device)
 	{
+		MSC_CALL_METRICS();
 		Debug::Log("Delete Device ptr");
 		try
 		{
@@ -77,6 +159,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetSctpCapabilities(mediasoupclient::Device* device)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return nullptr;
 
@@ -96,6 +179,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetRtpCapabilities(mediasoupclient::Device* device)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return nullptr;
 		nlohmann::json* rtp = nullptr;
@@ -114,6 +198,7 @@ extern "C"
 
 	DLL_EXPORT void GetSctpCapabilitiesByString(mediasoupclient::Device* device, char* stringContainer, int stringLength)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return;
 		nlohmann::json result;
@@ -133,6 +218,7 @@ extern "C"
 			   														   
 	DLL_EXPORT void GetRtpCapabilitiesByString(mediasoupclient::Device* device , char* stringContainer, int stringLength)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return;
 		nlohmann::json rtp;
@@ -151,6 +237,7 @@ extern "C"
 
 	DLL_EXPORT bool IsLoaded(Device* device)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return false;
 		return device->IsLoaded();
@@ -158,6 +245,8 @@ extern "C"
 
 	DLL_EXPORT void Load(Device* device, const nlohmann::json* rtpCapabilities, const PeerConnection::Options* peerConnectionOptions = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "Device::Load");
 		if (device == nullptr || rtpCapabilities == nullptr)
 			return;
 		try
@@ -172,6 +261,8 @@ extern "C"
 
 	DLL_EXPORT void LoadByGetRtp(Device* device, char* rtpCapabilities, int rtpLength, const PeerConnection::Options* peerConnectionOptions = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "Device::Load");
 		if (device == nullptr || rtpCapabilities == nullptr)
 			return;
 		try
@@ -188,6 +279,7 @@ extern "C"
 
 	DLL_EXPORT bool CanProduce(Device* device, char* type, int typeLength)
 	{
+		MSC_CALL_METRICS();
 		if (device == nullptr)
 			return false;
 
@@ -220,6 +312,8 @@ extern "C"
 		const PeerConnection::Options* peerConnectionOptions = nullptr,
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "Device::CreateSendTransport");
 		if (device == nullptr || listener == nullptr)
 			return nullptr;
 		SendTransport* transport = nullptr;
@@ -236,14 +330,15 @@ extern "C"
 			Debug::Log("[CreateSendTransport]dtlsParameter : " + dtlsParameter.dump());
 			const nlohmann::json data = appData == nullptr ? nlohmann::json::object() : *appData;
 			Debug::Log("[CreateSendTransport]appData : " + data.dump());
+			const PeerConnection::Options options = WithCachedCertificate(peerConnectionOptions);
 			if (sctpParameters != nullptr)
 			{
 				const nlohmann::json sctpParameter = *sctpParameters;
 				Debug::Log("[CreateSendTransport]sctpParams : " + sctpParameter.dump());
-				transport = device->CreateSendTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, sctpParameter, peerConnectionOptions, data);
+				transport = device->CreateSendTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, sctpParameter, &options, data);
 			}
 			else
-				transport = device->CreateSendTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, peerConnectionOptions, data);
+				transport = device->CreateSendTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, &options, data);
 		}
 		catch (exception e)
 		{
@@ -266,6 +361,8 @@ extern "C"
 		const PeerConnection::Options* peerConnectionOptions = nullptr,
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "Device::CreateRecvTransport");
 		if (device == nullptr || listener == nullptr)
 			return nullptr;
 
@@ -277,14 +374,15 @@ extern "C"
 			const nlohmann::json iceCandidate = *iceCandidates;
 			const nlohmann::json dtlsParameter = *dtlsParameters;
 			const nlohmann::json data = appData == nullptr ? nlohmann::json::object() : *appData;
+			const PeerConnection::Options options = WithCachedCertificate(peerConnectionOptions);
 			if (sctpParameters != nullptr)
 			{
 				const nlohmann::json sctpParameter = *sctpParameters;
 				Debug::Log("[CreateSendTransport]sctpParams : " + sctpParameter.dump());
-				transport = device->CreateRecvTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, sctpParameter, peerConnectionOptions, data);
+				transport = device->CreateRecvTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, sctpParameter, &options, data);
 			}
 			else
-				transport = device->CreateRecvTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, peerConnectionOptions, data);
+				transport = device->CreateRecvTransport(listener, Id, iceParameter, iceCandidate, dtlsParameter, &options, data);
 		}
 		catch (exception e)
 		{
@@ -296,11 +394,131 @@ extern "C"
 	}
 #pragma endregion
 
+#pragma region TransportPool
+	// Writes the parameters of a new server side transport for direction ("send" or "recv") into parameters:
+	// { "id", "iceParameters", "iceCandidates", "dtlsParameters", "sctpParameters" }. Returns false on failure.
+	typedef bool (*TransportProvisionerCallback)(const char* direction, char* parameters, int parametersLength);
+	// Optional. Starts ICE/DTLS on a fresh transport, e.g. by producing a data channel.
+	typedef void (*TransportWarmerCallback)(Transport* transport, const char* direction);
+	// Optional. Closes the server side of a transport the pool dropped.
+	typedef void (*TransportReleaserCallback)(const char* transportId, const char* direction);
+
+	constexpr int kTransportParametersSize = 64 * 1024;
+
+	// Spare transports are created on the factory of shard and closed after idleTimeoutMs unused (0 keeps them).
+	DLL_EXPORT TransportPool* MakeTransportPool(
+		Device* device,
+		SendTransport::Listener* sendListener,
+		RecvTransport::Listener* recvListener,
+		TransportProvisionerCallback provisioner,
+		TransportWarmerCallback warmer,
+		TransportReleaserCallback releaser,
+		int64_t idleTimeoutMs,
+		int shard)
+	{
+		MSC_CALL_METRICS();
+		if (device == nullptr || sendListener == nullptr || recvListener == nullptr || provisioner == nullptr)
+			return nullptr;
+		try
+		{
+			PeerConnection::Options peerConnectionOptions;
+			peerConnectionOptions.factory = getFactory(shard).get();
+
+			return new TransportPool(
+				device,
+				sendListener,
+				recvListener,
+				[provisioner](const std::string& direction) {
+					std::vector<char> parameters(kTransportParametersSize);
+					if (!provisioner(direction.c_str(), parameters.data(), kTransportParametersSize))
+						return nlohmann::json();
+					return nlohmann::json::parse(parameters.data());
+				},
+				[warmer](Transport* transport, const std::string& direction) {
+					if (warmer != nullptr)
+						warmer(transport, direction.c_str());
+				},
+				[releaser](const std::string& transportId, const std::string& direction) {
+					if (releaser != nullptr)
+						releaser(transportId.c_str(), direction.c_str());
+				},
+				peerConnectionOptions,
+				std::chrono::milliseconds(idleTimeoutMs));
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[MakeTransportPool]");
+			return (TransportPool*)-1;
+		}
+	}
+
+	DLL_EXPORT void DeleteTransportPool(TransportPool* transportPool)
+	{
+		MSC_CALL_METRICS();
+		delete transportPool;
+	}
+
+	DLL_EXPORT void PrewarmTransports(TransportPool* transportPool, int sendCount, int recvCount)
+	{
+		MSC_CALL_METRICS();
+		if (transportPool == nullptr)
+			return;
+		transportPool->Prewarm(std::max(sendCount, 0), std::max(recvCount, 0));
+	}
+
+	// Returns nullptr when no spare is ready; create the transport as usual then.
+	DLL_EXPORT SendTransport* TakeSendTransport(TransportPool* transportPool)
+	{
+		MSC_CALL_METRICS();
+		if (transportPool == nullptr)
+			return nullptr;
+		return transportPool->TakeSendTransport();
+	}
+
+	DLL_EXPORT RecvTransport* TakeRecvTransport(TransportPool* transportPool)
+	{
+		MSC_CALL_METRICS();
+		if (transportPool == nullptr)
+			return nullptr;
+		return transportPool->TakeRecvTransport();
+	}
+
+	DLL_EXPORT void GetTransportPoolStats(TransportPool* transportPool, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (transportPool == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			auto stats = transportPool->GetStats();
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "idleSend", stats.idleSend },
+				{ "idleRecv", stats.idleRecv },
+				{ "created",  stats.created  },
+				{ "hits",     stats.hits     },
+				{ "misses",   stats.misses   },
+				{ "expired",  stats.expired  },
+				{ "failures", stats.failures }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetTransportPoolStats]");
+		}
+	}
+#pragma endregion
+
 #pragma region Transport
 	//Transport
 	//TODO change string to char for C# stringbuilder
 	DLL_EXPORT const char* GetId(Transport* transport)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return "transport is null";
 		string id;
@@ -320,6 +538,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetConnectionState(Transport* transport)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return "transport is null";
 
@@ -341,6 +560,7 @@ extern "C"
 
 	DLL_EXPORT bool IsClosed(Transport* transport)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return true;
 
@@ -349,6 +569,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetStats(Transport* transport)
 	{
+		MSC_CALL_METRICS();
 		nlohmann::json stat;
 		
 		if (transport == nullptr)
@@ -370,6 +591,7 @@ extern "C"
 	//API comment : This method should be called when the server side transport has been closed (and vice-versa)
 	DLL_EXPORT void Close(Transport* transport)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return;
 
@@ -385,6 +607,7 @@ extern "C"
 
 	DLL_EXPORT void RestartIce(Transport* transport, const nlohmann::json* iceParameters)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return;
 
@@ -401,6 +624,7 @@ extern "C"
 
 	DLL_EXPORT void UpdateIceServers(Transport* transport, const nlohmann::json* iceServers)
 	{
+		MSC_CALL_METRICS();
 		if (transport == nullptr)
 			return;
 		try
@@ -424,6 +648,8 @@ extern "C"
 		const nlohmann::json* codec,
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "SendTransport::Produce");
 		if (sendTransport == nullptr || producerListener == nullptr)
 			return nullptr;
 
@@ -444,6 +670,8 @@ extern "C"
 		int maxPacketLifeTime = 0,
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "SendTransport::ProduceData");
 		DataProducer* dataProducer = nullptr;
 		try
 		{
@@ -472,6 +700,8 @@ extern "C"
 		nlohmann::json* rtpParameters,
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "RecvTransport::Consume");
 		if (recvTransport == nullptr || consumerListener == nullptr)
 			return nullptr;
 		Consumer* consumer = nullptr;
@@ -481,6 +711,7 @@ extern "C"
 				consumer = recvTransport->Consume(consumerListener, id, producerId, kind, rtpParameters);
 			else
 				consumer = recvTransport->Consume(consumerListener, id, producerId, kind, rtpParameters, *appData);
+			watchFirstDecodedFrame(consumer->GetTrack());
 		}
 		catch (exception e)
 		{
@@ -502,6 +733,8 @@ extern "C"
 		const char* protocol = "",
 		const nlohmann::json* appData = nullptr)
 	{
+		MSC_CALL_METRICS();
+		TraceScope trace("api", "RecvTransport::ConsumeData");
 		if (recvTransport == nullptr || listener == nullptr)
 			return nullptr;
 		DataConsumer* dataConsumer = nullptr;
@@ -525,6 +758,7 @@ extern "C"
 #pragma region Producer
 	DLL_EXPORT const char* GetIdProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return "";
 		string id;
@@ -544,6 +778,7 @@ extern "C"
 	
 	DLL_EXPORT const char* GetKind(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return "";
 
@@ -565,6 +800,7 @@ extern "C"
 
 	DLL_EXPORT webrtc::MediaStreamTrackInterface* GetTrack(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return nullptr;
 		webrtc::MediaStreamTrackInterface* trackInterface = nullptr;
@@ -583,6 +819,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetRtpParameters(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return nullptr;
 
@@ -601,6 +838,7 @@ extern "C"
 
 	DLL_EXPORT const uint8_t GetMaxSpatialLayer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return 0;
 
@@ -619,6 +857,7 @@ extern "C"
 
 	DLL_EXPORT nlohmann::json* GetStatsProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return nullptr;
 		nlohmann::json stat;
@@ -636,6 +875,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetAppData(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return nullptr;
 		nlohmann::json appData;
@@ -653,6 +893,7 @@ extern "C"
 
 	DLL_EXPORT bool IsClosedProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return true;
 		return producer->IsClosed();
@@ -660,6 +901,7 @@ extern "C"
 
 	DLL_EXPORT bool IsPausedProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return false;
 		return producer->IsPaused();
@@ -667,6 +909,7 @@ extern "C"
 
 	DLL_EXPORT void CloseProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return;
 
@@ -682,6 +925,7 @@ extern "C"
 
 	DLL_EXPORT void PauseProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return;
 		try
@@ -696,6 +940,7 @@ extern "C"
 
 	DLL_EXPORT void ResumeProducer(Producer* producer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return;
 		try
@@ -710,6 +955,7 @@ extern "C"
 
 	DLL_EXPORT void ReplaceTrack(Producer* producer, webrtc::MediaStreamTrackInterface* track)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr || track == nullptr)
 			return;
 		try
@@ -725,6 +971,7 @@ extern "C"
 
 	DLL_EXPORT void SetMaxSpatialLayer(Producer* producer, uint8_t spatialLayer)
 	{
+		MSC_CALL_METRICS();
 		if (producer == nullptr)
 			return;
 
@@ -742,6 +989,7 @@ extern "C"
 #pragma region Consumer
 	DLL_EXPORT const char* GetIdConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return "";
 
@@ -761,6 +1009,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetProducerIdConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return "";
 
@@ -781,6 +1030,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetKindConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return "";
 		
@@ -800,6 +1050,7 @@ extern "C"
 
 	DLL_EXPORT webrtc::MediaStreamTrackInterface* GetTrackConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return nullptr;
 		
@@ -818,6 +1069,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetRtpParametersConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return nullptr;
 
@@ -836,6 +1088,7 @@ extern "C"
 
 	DLL_EXPORT nlohmann::json* GetStatsConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return nullptr;
 		nlohmann::json stat;
@@ -853,6 +1106,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetAppDataConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return nullptr;
 		nlohmann::json appData;
@@ -870,6 +1124,7 @@ extern "C"
 
 	DLL_EXPORT bool IsClosedConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return true;
 		return consumer->IsClosed();
@@ -877,6 +1132,7 @@ extern "C"
 
 	DLL_EXPORT bool IsPausedConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return false;
 		return consumer->IsPaused();
@@ -884,6 +1140,7 @@ extern "C"
 
 	DLL_EXPORT void CloseConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return;
 		consumer->Close();
@@ -891,6 +1148,7 @@ extern "C"
 
 	DLL_EXPORT void PauseConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return;
 		try
@@ -905,6 +1163,7 @@ extern "C"
 
 	DLL_EXPORT void ResumeConsumer(Consumer* consumer)
 	{
+		MSC_CALL_METRICS();
 		if (consumer == nullptr)
 			return;
 		try
@@ -921,6 +1180,7 @@ extern "C"
 #pragma region DataProducer
 	DLL_EXPORT const char* GetIdDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return "";
 		string id;
@@ -938,6 +1198,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetSctpStreamParametersDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return nullptr;
 		
@@ -956,6 +1217,7 @@ extern "C"
 
 	DLL_EXPORT webrtc::DataChannelInterface::DataState GetReadyStateDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return  webrtc::DataChannelInterface::DataState::kClosed;
 
@@ -974,6 +1236,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetLabelDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return  "";
 
@@ -992,6 +1255,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetProtocolDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return  "";
 
@@ -1012,6 +1276,7 @@ extern "C"
 
 	DLL_EXPORT const uint8_t GetBufferedAmountDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return  0;
 		uint8_t amount = 0;
@@ -1030,6 +1295,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetAppDataDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		auto result = nlohmann::json::object();
 		if (dataProducer == nullptr)
 			return  &result;
@@ -1048,6 +1314,7 @@ extern "C"
 
 	DLL_EXPORT bool IsClosedDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return true;
 		return dataProducer->IsClosed();
@@ -1055,6 +1322,7 @@ extern "C"
 
 	DLL_EXPORT void CloseDataProducer(DataProducer* dataProducer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return;
 		try
@@ -1069,6 +1337,7 @@ extern "C"
 
 	DLL_EXPORT void Send(DataProducer* dataProducer, webrtc::DataBuffer* buffer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return;
 		try
@@ -1085,6 +1354,7 @@ extern "C"
 #pragma region DataConsumer
 	DLL_EXPORT const char* GetIdDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		string id;
 		if (dataConsumer == nullptr)
 			return "";
@@ -1104,6 +1374,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetDataProducerIdDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		string result;
 		if (dataConsumer == nullptr)
 			return "";
@@ -1123,6 +1394,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetSctpStreamParameters(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		auto parameters = nlohmann::json::object();
 		if (dataConsumer == nullptr)
 			return &parameters;
@@ -1141,6 +1413,7 @@ extern "C"
 
 	DLL_EXPORT webrtc::DataChannelInterface::DataState GetReadyStateDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		auto state = webrtc::DataChannelInterface::DataState::kClosed;
 		if (dataConsumer == nullptr)
 			return  state;
@@ -1159,6 +1432,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetLabel(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		string label;
 		if (dataConsumer == nullptr)
 			return "";
@@ -1178,6 +1452,7 @@ extern "C"
 
 	DLL_EXPORT const char* GetProtocol(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		string protocol;
 		if (dataConsumer == nullptr)
 			return  "";
@@ -1197,6 +1472,7 @@ extern "C"
 
 	DLL_EXPORT const nlohmann::json* GetAppDataDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		auto appData = nlohmann::json::object();
 		if (dataConsumer == nullptr)
 			return  &appData;
@@ -1215,6 +1491,7 @@ extern "C"
 
 	DLL_EXPORT bool IsClosedDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		if (dataConsumer == nullptr)
 			return true;
 		return dataConsumer->IsClosed();
@@ -1222,6 +1499,7 @@ extern "C"
 
 	DLL_EXPORT void CloseDataConsumer(DataConsumer* dataConsumer)
 	{
+		MSC_CALL_METRICS();
 		if (dataConsumer == nullptr)
 			return;
 
@@ -1237,6 +1515,7 @@ extern "C"
 
 	DLL_EXPORT void SendDataProducer(DataProducer* dataProducer, webrtc::DataBuffer* buffer)
 	{
+		MSC_CALL_METRICS();
 		if (dataProducer == nullptr)
 			return;
 
@@ -1254,6 +1533,7 @@ extern "C"
 #pragma region Json Util
 	DLL_EXPORT void __cdecl GetJsonString(const nlohmann::json* jsonObject, char* text, int textSize)
 	{
+		MSC_CALL_METRICS();
 		if (jsonObject == nullptr)
 			return;
 
@@ -1270,6 +1550,7 @@ extern "C"
 	
 	DLL_EXPORT nlohmann::json* MakeJsonObject(char* data, size_t dataSize)
 	{
+		MSC_CALL_METRICS();
 		nlohmann::json* jsonDynamic = nullptr;
 		try
 		{
@@ -1290,6 +1571,7 @@ extern "C"
 
 	DLL_EXPORT void DeleteJsonObject(nlohmann::json* data)
 	{
+		MSC_CALL_METRICS();
 		try
 		{
 			Debug::Log("Delete Json Object");
@@ -1304,12 +1586,14 @@ extern "C"
 
 	DLL_EXPORT const char* TestId()
 	{
+		MSC_CALL_METRICS();
 		string* testId = new string("testDongho5309");
 		return testId->c_str();
 	}
 
 	DLL_EXPORT uint8_t TestUint8(int testCase)
 	{
+		MSC_CALL_METRICS();
 		switch (testCase)
 		{
 		case -1:
@@ -1320,6 +1604,7 @@ extern "C"
 
 	DLL_EXPORT int TestEnumInput(webrtc::DataChannelInterface::DataState state)
 	{
+		MSC_CALL_METRICS();
 		try
 		{
 			switch (state)
@@ -1344,6 +1629,7 @@ extern "C"
 
 	DLL_EXPORT void __stdcall TestGetJsonString(char* text, size_t bufferSize)
 	{
+		MSC_CALL_METRICS();
 		const std::string strJson = R"(
     {
       "id" : 123456,
@@ -1381,73 +1667,1181 @@ extern "C"
 	}
 #pragma endregion
 
-#pragma region Broadcaster
-	DLL_EXPORT Broadcaster* MakeBroadcaster()
+#pragma region Media
+	DLL_EXPORT void GetFrameBufferPoolStats(char* stringContainer, int stringLength)
 	{
-		Debug::Log("Make Broadcaster");
-		return new Broadcaster();
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			auto stats = webrtc::test::I420BufferPool::Shared()->GetStats();
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "hits",          stats.hits           },
+				{ "misses",        stats.misses         },
+				{ "pooledBuffers", stats.pooled_buffers },
+				{ "pooledBytes",   stats.pooled_bytes   }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetFrameBufferPoolStats]");
+		}
 	}
 
-	DLL_EXPORT void DeleteBroadcaster(Broadcaster* broadcaster)
+	DLL_EXPORT void ResetFrameBufferPoolStats()
 	{
-		if (broadcaster != nullptr)
+		MSC_CALL_METRICS();
+		webrtc::test::I420BufferPool::Shared()->ResetStats();
+	}
+
+	// [ { "file": "low.ivf", "framesDecoded": 900, "underruns": 0, "pacingJitterUs": 310, ... }, ... ]
+	// One entry per IVF file being played. pacingJitterUs is the jitter of the capture ticks as the
+	// generator returns them, smoothed as in RFC 3550.
+	DLL_EXPORT void GetIvfPrefetchStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
 		{
-			delete broadcaster;
+			nlohmann::json result = nlohmann::json::array();
+			for (const auto& stats : webrtc::test::PrefetchingIvfVideoFrameGenerator::GetAllStats())
+			{
+				/* clang-format off */
+				result.push_back(
+				{
+					{ "file",            stats.file_name         },
+					{ "framesDecoded",   stats.frames_decoded    },
+					{ "framesDelivered", stats.frames_delivered  },
+					{ "framesCopied",    stats.frames_copied     },
+					{ "underruns",       stats.underruns         },
+					{ "queueSize",       stats.queue_size        },
+					{ "avgNextFrameUs",  stats.avg_next_frame_us },
+					{ "maxNextFrameUs",  stats.max_next_frame_us },
+					{ "pacingJitterUs",  stats.pacing_jitter_us  }
+				});
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetIvfPrefetchStats]");
 		}
 	}
-	
-	DLL_EXPORT void SaveSendTransport(Broadcaster* broadcaster, SendTransport* sendTransport)
+
+	DLL_EXPORT void BenchmarkFrameKernels(int width, int height, int iterations, char* stringContainer, int stringLength)
 	{
-		Debug::Log("[SaveSendTransport]");
-		broadcaster->sendTransport = sendTransport;
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		// Checked by BenchmarkFrameKernels() with RTC_CHECK, which would abort the process.
+		if (width < webrtc::test::kBenchmarkSquareSize || height < webrtc::test::kBenchmarkSquareSize || iterations <= 0)
+		{
+			const string error = "width and height must be at least " + to_string(webrtc::test::kBenchmarkSquareSize) +
+			                     " and iterations positive";
+
+			ErrorLogging(invalid_argument(error), "[BenchmarkFrameKernels]");
+			strcpy_s(stringContainer, stringLength, nlohmann::json({ { "error", error } }).dump().c_str());
+
+			return;
+		}
+		try
+		{
+			nlohmann::json results = nlohmann::json::array();
+			for (const auto& result : webrtc::test::BenchmarkFrameKernels(width, height, iterations))
+			{
+				/* clang-format off */
+				results.push_back(
+				{
+					{ "isa",                 result.isa                   },
+					{ "kernel",              result.kernel                },
+					{ "megapixelsPerSecond", result.megapixels_per_second }
+				});
+				/* clang-format on */
+			}
+
+			nlohmann::json report =
+			{
+				{ "activeIsa", webrtc::test::ActiveFrameKernels().name },
+				{ "results",   results                                  }
+			};
+
+			strcpy_s(stringContainer, stringLength, report.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[BenchmarkFrameKernels]");
+		}
 	}
 
-	DLL_EXPORT void SaveRecvTransport(Broadcaster* broadcaster, RecvTransport* recvTransport)
+	// config : { "shardCount": 4, "videoFiles": [ "low.ivf", "high.ivf" ], "opusFile": "audio.opus",
+	//           "simulatedTime": { "speed": 60 }, "network": { "delayMs": 40, "lossPercent": 1 } }
+	// The encoded file mode is used when videoFiles is given. speed 0 runs as fast as possible.
+	// "network" opens the sockets on an emulated network, see SetNetworkConditions.
+	DLL_EXPORT bool InitializeFactories(char* config, int configLength)
 	{
-		Debug::Log("[SaveRecvTransport]");
-		broadcaster->recvTransport = recvTransport;
+		MSC_CALL_METRICS();
+		if (config == nullptr)
+			return false;
+		try
+		{
+			initializeFactories(ParseFactoryConfig(nlohmann::json::parse(string(config, configLength))));
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[InitializeFactories]");
+			return false;
+		}
+
+		return true;
 	}
 
-#pragma endregion
-}
+	DLL_EXPORT int GetFactoryShardCount()
+	{
+		MSC_CALL_METRICS();
+		return static_cast<int>(getFactoryShardCount());
+	}
 
-#pragma region Util
-#include <fstream>
-#include <ctime>
-#include <iomanip>
+	// Round-robin shard for a new session; pass it to MakePeerConnectionOptions and the track creators.
+	DLL_EXPORT int AssignFactoryShard()
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			return static_cast<int>(assignFactoryShard());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[AssignFactoryShard]");
+			return -1;
+		}
+	}
 
-// ð string type returnϴ Լ
-const string currentDateTime()
-{
-	auto t = time(nullptr);
-	tm timeManager;
-	localtime_s(&timeManager, &t);
-	ostringstream oss;
-	oss << put_time(&timeManager, "%Y-%m-%d %H-%M");
+	// options : { "videoFiles": [ "low.ivf", "high.ivf" ], "opusFile": "audio.opus" }
+	DLL_EXPORT bool CreateEncodedFileFactory(char* options, int optionsLength)
+	{
+		MSC_CALL_METRICS();
+		if (options == nullptr)
+			return false;
+		try
+		{
+			const nlohmann::json json = nlohmann::json::parse(string(options, optionsLength));
+			EncodedFileOptions encodedFileOptions;
+			encodedFileOptions.videoFiles = json.at("videoFiles").get<std::vector<std::string>>();
+			encodedFileOptions.opusFile = json.value("opusFile", "");
+			createEncodedFileFactory(encodedFileOptions);
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[CreateEncodedFileFactory]");
+			return false;
+		}
 
-	return oss.str();
-}
+		return true;
+	}
 
-const string currentLogTime()
-{
-	auto t = time(nullptr);
-	tm timeManager;
-	localtime_s(&timeManager, &t);
-	ostringstream oss;
-	oss << put_time(&timeManager, "%Y-%m-%d.%X");
+	// Options making a transport use the factory of the given shard, or of the next one
+	// round-robin if shard is -1. Tracks produced on it must come from the same shard.
+	DLL_EXPORT PeerConnection::Options* MakePeerConnectionOptions(int shard)
+	{
+		MSC_CALL_METRICS();
+		PeerConnection::Options* peerConnectionOptions = nullptr;
+		try
+		{
+			peerConnectionOptions = new PeerConnection::Options();
+			peerConnectionOptions->factory = getFactory(shard).get();
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[MakePeerConnectionOptions]");
+			delete peerConnectionOptions;
+			return (PeerConnection::Options*)-1;
+		}
 
-	return oss.str();
-}
+		return peerConnectionOptions;
+	}
 
-void ErrorLogging(exception e, string prefix)
-{
-	string path = "ErrorLog_" + currentDateTime() + ".log";
-	ofstream fileWriter(path.data(), ios_base::app);
-	if (fileWriter.is_open())
+	DLL_EXPORT void DeletePeerConnectionOptions(PeerConnection::Options* peerConnectionOptions)
 	{
-		fileWriter <<"["  << currentLogTime() << "]" << prefix << e.what() << endl;
+		MSC_CALL_METRICS();
+		delete peerConnectionOptions;
 	}
-	fileWriter.close();
+
+	// How long transports share the cached DTLS certificate, at most a year. With 0 every transport uses its own.
+	DLL_EXPORT void SetCertificateLifetime(int64_t lifetimeMs)
+	{
+		MSC_CALL_METRICS();
+		setCertificateLifetime(lifetimeMs);
+	}
+
+	// Average time to create a transport's peer connection and first offer, with and without the certificate cache.
+	DLL_EXPORT void BenchmarkTransportCreation(int shard, int iterations, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			auto result = benchmarkTransportCreation(getFactory(shard).get(), iterations);
+			/* clang-format off */
+			nlohmann::json report =
+			{
+				{ "iterations",     result.iterations     },
+				{ "withoutCacheMs", result.withoutCacheMs },
+				{ "withCacheMs",    result.withCacheMs    }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, report.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[BenchmarkTransportCreation]");
+		}
+	}
+
+	// The returned track holds a reference that ReleaseTrack() drops.
+	DLL_EXPORT webrtc::MediaStreamTrackInterface* CreateAudioTrack(int shard)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			return createAudioTrack(std::to_string(rtc::CreateRandomId()), shard).release();
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[CreateAudioTrack]");
+			return (webrtc::MediaStreamTrackInterface*)-1;
+		}
+	}
+
+	DLL_EXPORT webrtc::MediaStreamTrackInterface* CreateEncodedFileVideoTrack(int shard)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			return createEncodedFileVideoTrack(std::to_string(rtc::CreateRandomId()), shard).release();
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[CreateEncodedFileVideoTrack]");
+			return (webrtc::MediaStreamTrackInterface*)-1;
+		}
+	}
+
+	DLL_EXPORT void ReleaseTrack(webrtc::MediaStreamTrackInterface* track)
+	{
+		MSC_CALL_METRICS();
+		if (track != nullptr)
+			track->Release();
+	}
+#pragma endregion
+
+#pragma region Threads
+	// policy : { "worker": { "priority": "high", "affinityMask": 12 }, "audioModule": { "priority": "realtime", "realtimePriority": 20 } }
+	// roles     : network, signaling, worker, frameGenerator, audioModule
+	// priorities: unchanged, low, normal, high, highest, realtime (SCHED_FIFO on Linux, time critical on Windows)
+	// An affinityMask of 0 leaves the affinity unchanged. Settings apply to running threads and to those created later.
+	DLL_EXPORT bool SetThreadPolicy(char* policy, int policyLength)
+	{
+		MSC_CALL_METRICS();
+		if (policy == nullptr)
+			return false;
+		try
+		{
+			const nlohmann::json json = nlohmann::json::parse(string(policy, policyLength));
+			for (const auto& item : json.items())
+			{
+				ThreadSettings settings;
+				settings.priority = threadPriorityFromName(item.value().value("priority", "unchanged"));
+				settings.realtimePriority = item.value().value("realtimePriority", settings.realtimePriority);
+				settings.affinityMask = item.value().value("affinityMask", uint64_t{ 0 });
+				setThreadSettings(threadRoleFromName(item.key()), settings);
+			}
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[SetThreadPolicy]");
+			return false;
+		}
+
+		return true;
+	}
+
+	// Settings the OS reports for every WebRTC thread, and why they could not be applied if so.
+	DLL_EXPORT void GetThreadPolicy(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			nlohmann::json threads = nlohmann::json::array();
+			for (const auto& thread : getEffectiveThreadSettings())
+			{
+				/* clang-format off */
+				threads.push_back(
+				{
+					{ "name",         thread.name                          },
+					{ "role",         threadRoleName(thread.role)          },
+					{ "threadId",     thread.threadId                      },
+					{ "priority",     threadPriorityName(thread.priority)  },
+					{ "osPriority",   thread.osPriority                    },
+					{ "affinityMask", thread.affinityMask                  },
+					{ "error",        thread.error                         }
+				});
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, nlohmann::json({ { "threads", threads } }).dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetThreadPolicy]");
+		}
+	}
+
+	// Timers of all Broadcasters run on one shared thread.
+	// { "timers": 200, "fired": 12000, "cancelled": 3, "maxLatenessMs": 2 }
+	DLL_EXPORT void GetTimerWheelStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			const TimerWheel::Stats stats = getTimerWheel().GetStats();
+
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "timers",        stats.timers        },
+				{ "fired",         stats.fired         },
+				{ "cancelled",     stats.cancelled     },
+				{ "maxLatenessMs", stats.maxLatenessMs }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetTimerWheelStats]");
+		}
+	}
+
+	// Enabled by InitializeFactories with "simulatedTime".
+	// { "enabled": true, "virtualMs": 3600000, "realMs": 61000, "tasksRun": 1250000 }
+	DLL_EXPORT void GetSimulatedTimeStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			const SimulatedTimeStats stats = getSimulatedTimeStats();
+
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "enabled",   stats.enabled   },
+				{ "virtualMs", stats.virtualMs },
+				{ "realMs",    stats.realMs    },
+				{ "tasksRun",  stats.tasksRun  }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetSimulatedTimeStats]");
+		}
+	}
+
+	// With a negative "speed", virtual time only moves when this is called.
+	DLL_EXPORT void AdvanceSimulatedTime(int ms)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			advanceSimulatedTime(ms);
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[AdvanceSimulatedTime]");
+		}
+	}
+#pragma endregion
+
+#pragma region Broadcaster
+	DLL_EXPORT Broadcaster* MakeBroadcaster()
+	{
+		MSC_CALL_METRICS();
+		Debug::Log("Make Broadcaster");
+		return new Broadcaster();
+	}
+
+	DLL_EXPORT void DeleteBroadcaster(Broadcaster* broadcaster)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster != nullptr)
+		{
+			delete broadcaster;
+		}
+	}
+	
+	DLL_EXPORT void SaveSendTransport(Broadcaster* broadcaster, SendTransport* sendTransport)
+	{
+		MSC_CALL_METRICS();
+		Debug::Log("[SaveSendTransport]");
+		broadcaster->sendTransport = sendTransport;
+	}
+
+	DLL_EXPORT void SaveRecvTransport(Broadcaster* broadcaster, RecvTransport* recvTransport)
+	{
+		MSC_CALL_METRICS();
+		Debug::Log("[SaveRecvTransport]");
+		broadcaster->recvTransport = recvTransport;
+	}
+
+	// [ { "name": "createSendTransport", "startUs": 1200, "endUs": 48000, "succeeded": true, "error": "" }, ... ]
+	// Times are relative to the start of Broadcaster::Start(); -1 for steps that never ran.
+	DLL_EXPORT void GetBroadcasterStartupTimeline(Broadcaster* broadcaster, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			nlohmann::json timeline = nlohmann::json::array();
+			for (const auto& entry : broadcaster->GetStartupTimeline())
+			{
+				/* clang-format off */
+				timeline.push_back(
+				{
+					{ "name",      entry.name      },
+					{ "startUs",   entry.startUs   },
+					{ "endUs",     entry.endUs     },
+					{ "succeeded", entry.succeeded },
+					{ "error",     entry.error     }
+				});
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, timeline.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetBroadcasterStartupTimeline]");
+		}
+	}
+
+	// Runs Broadcaster::Start() against a mediasoup demo server, or the local one (see StartLocalSignalingServer).
+	// baseUrl : "http://127.0.0.1:4443/rooms/local"
+	DLL_EXPORT bool StartBroadcaster(
+		Broadcaster* broadcaster,
+		char* baseUrl,
+		int baseUrlLength,
+		bool enableAudio,
+		bool useSimulcast,
+		char* routerRtpCapabilities,
+		int routerRtpCapabilitiesLength)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster == nullptr || baseUrl == nullptr || routerRtpCapabilities == nullptr)
+			return false;
+		try
+		{
+			string baseUrlText(baseUrl, baseUrlLength);
+			auto capabilities = nlohmann::json::parse(string(routerRtpCapabilities, routerRtpCapabilitiesLength));
+
+			broadcaster->Start(baseUrlText, enableAudio, useSimulcast, capabilities);
+			return true;
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[StartBroadcaster]");
+		}
+
+		return false;
+	}
+
+	// [ { "id": 1, "method": "POST", "path": "/broadcasters", "status": 200, "rttMs": 1.2 }, ... ]
+	// status is 0 for requests lost with the connection.
+	DLL_EXPORT void GetSignalingRequestStats(Broadcaster* broadcaster, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			nlohmann::json requests = nlohmann::json::array();
+			for (const auto& request : broadcaster->GetSignalingRequestStats())
+			{
+				/* clang-format off */
+				requests.push_back(
+				{
+					{ "id",     request.id     },
+					{ "method", request.method },
+					{ "path",   request.path   },
+					{ "status", request.status },
+					{ "rttMs",  request.rttMs  }
+				});
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, requests.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetSignalingRequestStats]");
+		}
+	}
+
+	// { "disconnections": 2, "selfRecoveries": 1, "iceRestarts": 2, "recoveries": 2, "failures": 0,
+	//   "lastRecoveryMs": 2140.5, "maxRecoveryMs": 2140.5, "meanRecoveryMs": 1320.2 }
+	DLL_EXPORT void GetBroadcasterReconnectionStats(Broadcaster* broadcaster, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			auto stats = broadcaster->GetReconnectionStats();
+
+			/* clang-format off */
+			nlohmann::json json =
+			{
+				{ "disconnections", stats.disconnections },
+				{ "selfRecoveries", stats.selfRecoveries },
+				{ "iceRestarts",    stats.iceRestarts    },
+				{ "recoveries",     stats.recoveries     },
+				{ "failures",       stats.failures       },
+				{ "lastRecoveryMs", stats.lastRecoveryMs },
+				{ "maxRecoveryMs",  stats.maxRecoveryMs  },
+				{ "meanRecoveryMs", stats.meanRecoveryMs }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, json.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetBroadcasterReconnectionStats]");
+		}
+	}
+
+	// [ { "id": "...", "role": "send", "connects": 1, "connectionStateChanges": 3, "produces": 2 }, ... ]
+	DLL_EXPORT void GetBroadcasterTransportStats(Broadcaster* broadcaster, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (broadcaster == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			nlohmann::json transports = nlohmann::json::array();
+			for (const auto& transport : broadcaster->GetTransportStats())
+			{
+				/* clang-format off */
+				transports.push_back(
+				{
+					{ "id",                     transport.id                                                     },
+					{ "role",                   transport.role == TransportRegistry::Role::Send ? "send" : "recv" },
+					{ "connects",               transport.connects                                               },
+					{ "connectionStateChanges", transport.connectionStateChanges                                 },
+					{ "produces",               transport.produces                                               }
+				});
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, transports.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetBroadcasterTransportStats]");
+		}
+	}
+
+#pragma endregion
+
+#pragma region BroadcasterHost
+	// options : {
+	//   "baseUrl": "http://127.0.0.1:4443/rooms/load", "routerRtpCapabilities": { ... },
+	//   "enableAudio": true, "enableVideo": false, "useSimulcast": false, "enableData": false,
+	//   "signalingConnections": 4, "startConcurrency": 16,
+	//   "reconnectGracePeriodMs": 2000, "reconnectRetryIntervalMs": 3000, "reconnectMaxAttempts": 5 }
+	DLL_EXPORT BroadcasterHost* MakeBroadcasterHost(char* options, int optionsLength)
+	{
+		MSC_CALL_METRICS();
+		if (options == nullptr)
+			return nullptr;
+		try
+		{
+			auto optionsJson = nlohmann::json::parse(string(options, optionsLength));
+
+			BroadcasterHost::Options hostOptions;
+			hostOptions.baseUrl = optionsJson.at("baseUrl").get<std::string>();
+			hostOptions.routerRtpCapabilities = optionsJson.at("routerRtpCapabilities");
+			hostOptions.session.enableAudio = optionsJson.value("enableAudio", true);
+			hostOptions.session.enableVideo = optionsJson.value("enableVideo", false);
+			hostOptions.session.useSimulcast = optionsJson.value("useSimulcast", false);
+			hostOptions.session.enableData = optionsJson.value("enableData", false);
+			hostOptions.signalingConnections = optionsJson.value("signalingConnections", hostOptions.signalingConnections);
+			hostOptions.startConcurrency = optionsJson.value("startConcurrency", hostOptions.startConcurrency);
+
+			auto& reconnection = hostOptions.session.reconnection;
+			reconnection.gracePeriod = std::chrono::milliseconds(
+				optionsJson.value("reconnectGracePeriodMs", static_cast<int64_t>(reconnection.gracePeriod.count())));
+			reconnection.retryInterval = std::chrono::milliseconds(
+				optionsJson.value("reconnectRetryIntervalMs", static_cast<int64_t>(reconnection.retryInterval.count())));
+			reconnection.maxAttempts = optionsJson.value("reconnectMaxAttempts", reconnection.maxAttempts);
+
+			return new BroadcasterHost(hostOptions);
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[MakeBroadcasterHost]");
+		}
+
+		return nullptr;
+	}
+
+	DLL_EXPORT void DeleteBroadcasterHost(BroadcasterHost* host)
+	{
+		MSC_CALL_METRICS();
+		if (host != nullptr)
+		{
+			delete host;
+		}
+	}
+
+	// Returns how many sessions started.
+	DLL_EXPORT int AddBroadcasterSessions(BroadcasterHost* host, int count)
+	{
+		MSC_CALL_METRICS();
+		if (host == nullptr || count <= 0)
+			return 0;
+		try
+		{
+			return static_cast<int>(host->AddSessions(static_cast<size_t>(count)));
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[AddBroadcasterSessions]");
+		}
+
+		return 0;
+	}
+
+	DLL_EXPORT void RemoveBroadcasterSessions(BroadcasterHost* host, int count)
+	{
+		MSC_CALL_METRICS();
+		if (host == nullptr || count <= 0)
+			return;
+		try
+		{
+			host->RemoveSessions(static_cast<size_t>(count));
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[RemoveBroadcasterSessions]");
+		}
+	}
+
+	// { "sessions": 1000, "failed": 2, "memoryBytes": ..., "threads": 40,
+	//   "memoryPerSessionBytes": 310000.5, "threadsPerSession": 0.01 }
+	DLL_EXPORT void GetBroadcasterHostStats(BroadcasterHost* host, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (host == nullptr || stringContainer == nullptr)
+			return;
+		try
+		{
+			const BroadcasterHost::Stats stats = host->GetStats();
+
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "sessions",              stats.sessions              },
+				{ "failed",                stats.failed                },
+				{ "memoryBytes",           stats.memoryBytes           },
+				{ "threads",               stats.threads               },
+				{ "memoryPerSessionBytes", stats.memoryPerSessionBytes },
+				{ "threadsPerSession",     stats.threadsPerSession     }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetBroadcasterHostStats]");
+		}
+	}
+#pragma endregion
+
+#pragma region LocalSignalingServer
+	// Stand-in for the mediasoup demo server; transports it creates carry no media.
+	// port : 0 picks a free port. latencyMs : delay of every response.
+	// Returns the bound port, -1 on failure. Its base URL is "http://127.0.0.1:<port>/rooms/local".
+	DLL_EXPORT int StartLocalSignalingServer(int port, int latencyMs)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			std::lock_guard<std::mutex> lock(localSignalingServerMutex);
+
+			localSignalingServer.reset();
+			localSignalingServer.reset(
+				new LocalSignalingServer(static_cast<uint16_t>(port), std::chrono::milliseconds(latencyMs)));
+
+			return localSignalingServer->Port();
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[StartLocalSignalingServer]");
+		}
+
+		return -1;
+	}
+
+	// Same, with transports served by an in-process loopback router: they connect
+	// over 127.0.0.1 and media and data are forwarded to consumers.
+	DLL_EXPORT int StartLoopbackSignalingServer(int port, int latencyMs)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			std::lock_guard<std::mutex> lock(localSignalingServerMutex);
+
+			localSignalingServer.reset();
+			localSignalingServer.reset(new LocalSignalingServer(
+				static_cast<uint16_t>(port), std::chrono::milliseconds(latencyMs), true));
+
+			return localSignalingServer->Port();
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[StartLoopbackSignalingServer]");
+		}
+
+		return -1;
+	}
+
+	// Counters of the loopback router, "{}" without one.
+	DLL_EXPORT void GetLoopbackRouterStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			std::lock_guard<std::mutex> lock(localSignalingServerMutex);
+
+			nlohmann::json json = nlohmann::json::object();
+			if (localSignalingServer && localSignalingServer->Router())
+			{
+				const auto stats = localSignalingServer->Router()->GetStats();
+
+				/* clang-format off */
+				json =
+				{
+					{ "transports",            stats.transports            },
+					{ "connectedTransports",   stats.connectedTransports   },
+					{ "producers",             stats.producers             },
+					{ "consumers",             stats.consumers             },
+					{ "dataProducers",         stats.dataProducers         },
+					{ "dataConsumers",         stats.dataConsumers         },
+					{ "rtpPacketsReceived",    stats.rtpPacketsReceived    },
+					{ "rtpBytesReceived",      stats.rtpBytesReceived      },
+					{ "rtpPacketsForwarded",   stats.rtpPacketsForwarded   },
+					{ "rtcpPacketsReceived",   stats.rtcpPacketsReceived   },
+					{ "keyFrameRequests",      stats.keyFrameRequests      },
+					{ "sctpMessagesReceived",  stats.sctpMessagesReceived  },
+					{ "sctpMessagesForwarded", stats.sctpMessagesForwarded },
+					{ "packetsDropped",        stats.packetsDropped        }
+				};
+				/* clang-format on */
+			}
+
+			strcpy_s(stringContainer, stringLength, json.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetLoopbackRouterStats]");
+		}
+	}
+
+	DLL_EXPORT void StopLocalSignalingServer()
+	{
+		MSC_CALL_METRICS();
+		std::lock_guard<std::mutex> lock(localSignalingServerMutex);
+
+		localSignalingServer.reset();
+	}
+#pragma endregion
+
+#pragma region NetworkEmulation
+	// Enabled by InitializeFactories with "network"; changes apply to open transports right away.
+	// conditions : { "delayMs": 40, "jitterMs": 10, "lossPercent": 2, "burstLength": 3, "reorderPercent": 0,
+	//               "bandwidthKbps": 1500, "queueMs": 500 } for both directions, or { "up": { ... }, "down": { ... } }.
+	// { "lossPercent": 100 } cuts the network off, e.g. to make the transports restart ICE.
+	DLL_EXPORT bool SetNetworkConditions(char* conditions, int conditionsLength)
+	{
+		MSC_CALL_METRICS();
+		if (conditions == nullptr)
+			return false;
+		try
+		{
+			NetworkConditions networkConditions =
+				parseNetworkConditions(nlohmann::json::parse(string(conditions, conditionsLength)));
+			/* Sockets opened later keep drawing from the initial seed. */
+			if (networkConditions.seed == 0)
+				networkConditions.seed = getNetworkConditions().seed;
+			setNetworkConditions(networkConditions);
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[SetNetworkConditions]");
+			return false;
+		}
+
+		return true;
+	}
+
+	// Packets through the emulated links since the start, up for sent and down for received:
+	// { "up": { "packets", "bytes", "lost", "queueDropped", "reordered" }, "down": { ... } }
+	DLL_EXPORT void GetNetworkEmulationStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			const NetworkEmulationStats stats = getNetworkEmulationStats();
+			auto link = [](const LinkStats& linkStats) {
+				/* clang-format off */
+				return nlohmann::json
+				{
+					{ "packets",      linkStats.packets      },
+					{ "bytes",        linkStats.bytes        },
+					{ "lost",         linkStats.lost         },
+					{ "queueDropped", linkStats.queueDropped },
+					{ "reordered",    linkStats.reordered    }
+				};
+				/* clang-format on */
+			};
+
+			nlohmann::json result = { { "up", link(stats.up) }, { "down", link(stats.down) } };
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetNetworkEmulationStats]");
+		}
+	}
+#pragma endregion
+
+#pragma region CallMetrics
+	// Times every export from now on, until disabled; off by default.
+	DLL_EXPORT void EnableCallMetrics(bool enable)
+	{
+		MSC_CALL_METRICS();
+		enableCallMetrics(enable);
+	}
+
+	// Per export, since the last reset; errors are calls which caught an exception:
+	// { "enabled": true, "calls": { "CreateSendTransport": { "calls": 12, "errors": 0, "totalMs": 310.2,
+	//   "meanUs": 25850, "p50Us": 24100, "p99Us": 41800, "p999Us": 41800, "maxUs": 41795 }, ... } }
+	DLL_EXPORT void GetCallMetrics(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			nlohmann::json calls = nlohmann::json::object();
+			for (const auto& call : getCallMetrics())
+			{
+				/* clang-format off */
+				calls[call.name] =
+				{
+					{ "calls",   call.calls   },
+					{ "errors",  call.errors  },
+					{ "totalMs", call.totalMs },
+					{ "meanUs",  call.meanUs  },
+					{ "p50Us",   call.p50Us   },
+					{ "p99Us",   call.p99Us   },
+					{ "p999Us",  call.p999Us  },
+					{ "maxUs",   call.maxUs   }
+				};
+				/* clang-format on */
+			}
+
+			nlohmann::json result = { { "enabled", isCallMetricsEnabled() }, { "calls", calls } };
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetCallMetrics]");
+		}
+	}
+
+	DLL_EXPORT void ResetCallMetrics()
+	{
+		MSC_CALL_METRICS();
+		resetCallMetrics();
+	}
+#pragma endregion
+
+#pragma region Tracing
+	// Records spans of the exports, of the startup steps and signaling, and media and ICE events; off by default.
+	DLL_EXPORT void EnableTracing(bool enable)
+	{
+		MSC_CALL_METRICS();
+		enableTracing(enable);
+	}
+
+	// Writes the events since the last clear as Chrome trace event JSON, to open in Perfetto or chrome://tracing.
+	DLL_EXPORT bool WriteTrace(char* path, int pathLength)
+	{
+		MSC_CALL_METRICS();
+		if (path == nullptr)
+			return false;
+		try
+		{
+			return writeTrace(string(path, pathLength));
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[WriteTrace]");
+		}
+
+		return false;
+	}
+
+	DLL_EXPORT void ClearTrace()
+	{
+		MSC_CALL_METRICS();
+		clearTrace();
+	}
+
+	// { "enabled": true, "events": 5120, "dropped": 0, "threads": 14 }
+	DLL_EXPORT void GetTraceStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			const TraceStats stats = getTraceStats();
+
+			/* clang-format off */
+			nlohmann::json result =
+			{
+				{ "enabled", stats.enabled },
+				{ "events",  stats.events  },
+				{ "dropped", stats.dropped },
+				{ "threads", stats.threads }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, result.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetTraceStats]");
+		}
+	}
+#pragma endregion
+
+#pragma region CapabilityCache
+	// Router and device capabilities kept in the file across process starts; an empty path disables the cache.
+	DLL_EXPORT bool EnableCapabilityCache(char* path, int pathLength)
+	{
+		MSC_CALL_METRICS();
+		try
+		{
+			setCapabilityCachePath(path == nullptr ? "" : string(path, pathLength));
+
+			return true;
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[EnableCapabilityCache]");
+		}
+
+		return false;
+	}
+
+	// Router RTP capabilities cached for the room, so that they need not be downloaded. False if not cached.
+	DLL_EXPORT bool GetCachedRouterRtpCapabilities(char* baseUrl, int baseUrlLength, char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (baseUrl == nullptr || stringContainer == nullptr)
+			return false;
+		try
+		{
+			auto cache = getCapabilityCache();
+			CapabilityCache::Entry entry;
+			if (!cache || !cache->Find(string(baseUrl, baseUrlLength), entry))
+				return false;
+
+			strcpy_s(stringContainer, stringLength, entry.routerRtpCapabilities.dump().c_str());
+
+			return true;
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetCachedRouterRtpCapabilities]");
+		}
+
+		return false;
+	}
+
+	// Saves the capabilities of a device loaded with routerRtpCapabilities for the room.
+	DLL_EXPORT void CacheDeviceCapabilities(
+		Device* device, char* baseUrl, int baseUrlLength, const nlohmann::json* routerRtpCapabilities)
+	{
+		MSC_CALL_METRICS();
+		if (device == nullptr || baseUrl == nullptr || routerRtpCapabilities == nullptr)
+			return;
+		try
+		{
+			if (auto cache = getCapabilityCache())
+				cache->Store(string(baseUrl, baseUrlLength), *routerRtpCapabilities, *device);
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[CacheDeviceCapabilities]");
+		}
+	}
+
+	// { "enabled": true, "entries": 1, "hits": 3, "misses": 1, "stores": 1 }
+	DLL_EXPORT void GetCapabilityCacheStats(char* stringContainer, int stringLength)
+	{
+		MSC_CALL_METRICS();
+		if (stringContainer == nullptr)
+			return;
+		try
+		{
+			auto cache = getCapabilityCache();
+			CapabilityCache::Stats stats = cache ? cache->GetStats() : CapabilityCache::Stats{};
+
+			/* clang-format off */
+			nlohmann::json json =
+			{
+				{ "enabled", cache != nullptr },
+				{ "entries", stats.entries    },
+				{ "hits",    stats.hits       },
+				{ "misses",  stats.misses     },
+				{ "stores",  stats.stores     }
+			};
+			/* clang-format on */
+
+			strcpy_s(stringContainer, stringLength, json.dump().c_str());
+		}
+		catch (exception e)
+		{
+			ErrorLogging(e, "[GetCapabilityCacheStats]");
+		}
+	}
+#pragma endregion
+}
+
+#pragma region Util
+#include <fstream>
+#include <ctime>
+#include <iomanip>
+
+// ð string type returnϴ Լ
+const string currentDateTime()
+{
+	auto t = time(nullptr);
+	tm timeManager;
+	localtime_s(&timeManager, &t);
+	ostringstream oss;
+	oss << put_time(&timeManager, "%Y-%m-%d %H-%M");
+
+	return oss.str();
+}
+
+const string currentLogTime()
+{
+	auto t = time(nullptr);
+	tm timeManager;
+	localtime_s(&timeManager, &t);
+	ostringstream oss;
+	oss << put_time(&timeManager, "%Y-%m-%d.%X");
+
+	return oss.str();
+}
+
+void ErrorLogging(exception e, string prefix)
+{
+	markCallFailed();
+
+	string path = "ErrorLog_" + currentDateTime() + ".log";
+	ofstream fileWriter(path.data(), ios_base::app);
+	if (fileWriter.is_open())
+	{
+		fileWriter <<"["  << currentLogTime() << "]" << prefix << e.what() << endl;
+	}
+	fileWriter.close();
+}
+
+// { "shardCount": 4, "videoFiles": [ "low.ivf", "high.ivf" ], "opusFile": "audio.opus", "simulatedTime": { "speed": 60 },
+//   "network": { "up": { "bandwidthKbps": 2000 }, "down": { "delayMs": 40 } } }
+FactoryConfig ParseFactoryConfig(const nlohmann::json& json)
+{
+	FactoryConfig factoryConfig;
+	factoryConfig.shardCount = std::max(json.value("shardCount", 1), 0);
+	if (json.contains("videoFiles"))
+	{
+		factoryConfig.useEncodedFiles = true;
+		factoryConfig.encodedFiles.videoFiles = json.at("videoFiles").get<std::vector<std::string>>();
+		factoryConfig.encodedFiles.opusFile = json.value("opusFile", "");
+	}
+	if (json.contains("simulatedTime"))
+	{
+		factoryConfig.simulatedTime = true;
+		factoryConfig.simulatedTimeSpeed = json.at("simulatedTime").value("speed", 0.0);
+	}
+	if (json.contains("network"))
+	{
+		factoryConfig.emulatedNetwork = true;
+		factoryConfig.networkConditions = parseNetworkConditions(json.at("network"));
+	}
+
+	return factoryConfig;
+}
+
+// Transports share the cached certificate instead of generating one each, unless the caller gave its own.
+// Without cache they still use the pre-generated ones while the pool lasts.
+PeerConnection::Options WithCachedCertificate(const PeerConnection::Options* peerConnectionOptions)
+{
+	PeerConnection::Options options = peerConnectionOptions == nullptr ? PeerConnection::Options() : *peerConnectionOptions;
+	if (options.config.certificates.empty())
+	{
+		auto certificate = getCachedCertificate();
+		if (!certificate)
+			certificate = takeCertificate();
+		if (certificate)
+			options.config.certificates.push_back(certificate);
+	}
+
+	return options;
 }
 
 